@@ -1,22 +1,7 @@
 
 #version 460 core
 
-#define POINT_LIGHT 0
-#define SPOT_LIGHT 1
-
-struct Light{
-	uint type;
-	vec3 position;
-	vec3 direction;
-	vec4 color;
-	uint intensity;
-	vec3 funcvalues;
-	float maxDistance;
-	//spot light
-	float sl_innerAngle;
-	float sl_outerAngle;
-	float sl_maxRadius;
-};
+#include "include/light.glsl"
 
 restrict readonly layout(binding = 0, std430) buffer dynamicLightBuffer {
 	Light dLights[];
@@ -86,46 +71,46 @@ void main() {
     for (uint i = 0; i < lightCount; ++i) {
         uint lightIndex = o_LightIndexList[startOffset + i];
         Light light = sLights[lightIndex];
-		vec3 L = normalize(-light.direction);
-        switch (light.type) {
+		vec3 L = normalize(-light.direction.xyz);
+        switch (int(light.type.x)) {
 			case POINT_LIGHT:
 			{
 				//result = DoPointLight( light, mat, V, P, N );
 
-				vec3 L = light.position - gl_FragCoord.xyz;
+				vec3 L = light.position.xyz - gl_FragCoord.xyz;
 				float dis = length(L);
 				L = L / dis;
  
-				float attenuation = DoAttenuation(light.funcvalues, dis);
+				float attenuation = DoAttenuation(light.funcvalues.xyz, dis);
  
-				diffuse += DoDiffuse(light.color, L, normal) * attenuation * light.intensity;
-				specular += DoSpecular(light.color, specularPower, V.xyz, L, normal) * attenuation * light.intensity;
+				diffuse += DoDiffuse(light.color, L, normal) * attenuation * light.dis.x;
+				specular += DoSpecular(light.color, specularPower, V.xyz, L, normal) * attenuation * light.dis.x;
 			}
 			break;
 			case SPOT_LIGHT:
 			{
 				//result = DoSpotLight( light, mat, V, P, N );
 
-				vec3 L = light.position - gl_FragCoord.xyz;
+				vec3 L = light.position.xyz - gl_FragCoord.xyz;
 				float dis = length(L);
 				L = L / dis;
  
-				float attenuation = DoAttenuation(light.funcvalues, dis);
+				float attenuation = DoAttenuation(light.funcvalues.xyz, dis);
 				
 				// If the cosine angle of the light's direction 
 				// vector and the vector from the light source to the point being 
 				// shaded is less than minCos, then the spotlight contribution will be 0.
-				float minCos = cos(radians(light.sl_outerAngle));
+				float minCos = cos(radians(light.sl.y));
 				// If the cosine angle of the light's direction vector
 				// and the vector from the light source to the point being shaded
 				// is greater than maxCos, then the spotlight contribution will be 1.
 				float maxCos = mix(minCos, 1.0, 0.5);
-				float cosAngle = dot(light.direction, -L);
+				float cosAngle = dot(light.direction.xyz, -L);
 				// Blend between the minimum and maximum cosine angles.
 				float spotIntensity = smoothstep(minCos, maxCos, cosAngle);
  
-				diffuse += DoDiffuse(light.color, L, normal) * attenuation * spotIntensity * light.intensity;
-				specular += DoSpecular(light.color, specularPower, V.xyz, L, normal) * attenuation * spotIntensity * light.intensity;
+				diffuse += DoDiffuse(light.color, L, normal) * attenuation * spotIntensity * light.dis.x;
+				specular += DoSpecular(light.color, specularPower, V.xyz, L, normal) * attenuation * spotIntensity * light.dis.x;
  	
 			}
 			break;
@@ -0,0 +1,15 @@
+//shared by every shader that reads the light ssbo, mirrors Light in Gdx.hpp
+
+#define POINT_LIGHT 0
+#define SPOT_LIGHT 1
+#define DIRECTIONAL_LIGHT 2
+
+struct Light{
+	vec4 type;
+	vec4 position;
+	vec4 direction;
+	vec4 color;
+	vec4 funcvalues;
+	vec4 dis; //intensity, maxDistance, 0, 0
+	vec4 sl; //sl_innerAngle, sl_outerAngle, sl_maxRadius
+};
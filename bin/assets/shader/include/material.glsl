@@ -0,0 +1,10 @@
+//mirrors Material in G3D.hpp
+
+struct Material{
+	vec4 COLOR_DIFFUSE;
+	vec4 COLOR_SPECULAR;
+	vec4 COLOR_AMBIENT;
+	vec4 COLOR_EMISSIVE;
+	vec4 COLOR_TRANSPARENT;
+	vec4 vals; //OPACITY, SHININESS, SHININESS_STRENGTH
+};
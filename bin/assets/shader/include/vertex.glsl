@@ -0,0 +1,13 @@
+//dequantization of the model vertices, mirrors PackedVertex in G3D.hpp
+
+//a_position arrives as unorm in [0, 1] over the bounds of the mesh
+vec3 decodePosition(in vec3 _packed, in vec3 _min, in vec3 _extent){
+	return _min + _packed * _extent;
+}
+
+//a_normal arrives as snorm octahedral
+vec3 decodeNormal(in vec2 _packed){
+	vec3 n = vec3(_packed, 1.0 - abs(_packed.x) - abs(_packed.y));
+	if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(n);
+}
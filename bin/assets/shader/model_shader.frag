@@ -9,20 +9,8 @@ layout (location = 1) out vec4 o_diff;
 layout (location = 2) out vec4 o_spec;
 layout (location = 3) out vec3 o_norm;
 
-struct Material{
-	vec4 emission;
-	vec4 ambient;
-	vec4 diffuse;
-	vec4 specular;
-	float shininess;
-	float transparency;
-};
-
-struct Light{
-	vec3 dir;
-	vec4 color;
-	uint intensity;
-};
+#include "include/light.glsl"
+#include "include/material.glsl"
 
 restrict readonly layout(binding = 0, std430) buffer matBuffer {
 	Material mat[];
@@ -51,9 +39,9 @@ vec4 DoDiffuse(vec4 _color, vec3 _L, vec3 _N ) {
 
 void main(){
 	o_norm = normal;
-	o_spec = vec4(mat[matIndex].specular.xyz, clamp(log2(mat[matIndex].shininess)/10.5, 0.0, 1.0));
-	o_diff = mat[matIndex].diffuse;
-	o_light = mat[matIndex].ambient + mat[matIndex].diffuse;
+	o_spec = vec4(mat[matIndex].COLOR_SPECULAR.xyz, clamp(log2(mat[matIndex].vals.y)/10.5, 0.0, 1.0));
+	o_diff = mat[matIndex].COLOR_DIFFUSE;
+	o_light = mat[matIndex].COLOR_AMBIENT + mat[matIndex].COLOR_DIFFUSE;
 
 	//eyePos: The position of the camera in view space (which is always (0, 0, 0))
 	//P: The position of the point being shaded in view space
@@ -62,9 +50,9 @@ void main(){
 	vec4 V = normalize(vec4(0.0, 0.0, 0.0, 1.0) - gl_FragCoord);
 
 	for(int i = 0; i < lights.length(); ++i){
-		vec3 L = normalize(-lights[i].dir);
-		vec4 diffuse = DoDiffuse(lights[i].color, L, normal) * lights[i].intensity;
-		vec4 specular = DoSpecular(lights[i].color, mat[matIndex].shininess, V.xyz, L, normal) * lights[i].intensity;
+		vec3 L = normalize(-lights[i].direction.xyz);
+		vec4 diffuse = DoDiffuse(lights[i].color, L, normal) * lights[i].dis.x;
+		vec4 specular = DoSpecular(lights[i].color, mat[matIndex].vals.y, V.xyz, L, normal) * lights[i].dis.x;
 		o_diff += diffuse;
 		o_spec += specular;
 	}	
@@ -1,50 +1,40 @@
 
 #version 460 core
 
-#define POINT_LIGHT 0
-#define SPOT_LIGHT 1
-#define DIRECTIONAL_LIGHT 2
-
-struct Light{
-	vec4 type;
-	vec4 position;
-	vec4 direction;
-	vec4 color;
-	vec4 funcvalues;
-	vec4 dis; //intensity, maxDistance, 0, 0
-	vec4 sl; //sl_innerAngle, sl_outerAngle, sl_maxRadius
-};
-
-struct Material{
-	vec4 COLOR_DIFFUSE;
-	vec4 COLOR_SPECULAR;
-	vec4 COLOR_AMBIENT;
-	vec4 COLOR_EMISSIVE;
-	vec4 COLOR_TRANSPARENT;
-	vec4 vals; //OPACITY, SHININESS, SHININESS_STRENGTH
-};
+#include "../include/light.glsl"
+#include "../include/material.glsl"
 
 out vec4 fragColor;
 
 in vec3 position;
 in vec3 normal;
+#ifdef HAS_TEXTURE
 in vec2 uv;
+#else
+in vec4 color;
+#endif
 in vec4 shadowP;
 
+#ifdef HAS_TEXTURE
 layout (binding = 0) uniform sampler2D tex;
+#endif
 layout (binding = 1) uniform sampler2D shadowMap;
 
 layout(location = 7) uniform vec3 c_pos;
+#ifdef HAS_TEXTURE
 layout(location = 8) uniform uint matIndex;
+#endif
 
 restrict readonly layout(binding = 2, std430) buffer dynamicLightBuffer {
 	vec4 size;
 	Light dLights[];
 };
 
+#ifdef HAS_TEXTURE
 restrict readonly layout(binding = 3, std430) buffer matBuffer {
 	Material materials[];
 };
+#endif
 
 float DoAttenuation(in vec3 _vals, in float _d){
 	return 1.0 / (_vals.x + _vals.y * _d + _vals.z * _d * _d);
@@ -62,14 +52,28 @@ float chebyshevUpperBound(in float _dis, in vec2 _uv) {
 
 void main(){
 	
+#ifdef HAS_TEXTURE
 	Material mat = materials[matIndex];
+	vec3 ambientFactor = vec3(mat.COLOR_AMBIENT);
+	vec3 diffuseFactor = vec3(mat.COLOR_DIFFUSE);
+	vec3 specularFactor = vec3(mat.COLOR_SPECULAR);
+#else
+	//untextured geometry has no material
+	vec3 ambientFactor = vec3(0.1f);
+	vec3 diffuseFactor = vec3(0.1f);
+	vec3 specularFactor = vec3(0.f);
+#endif
 
 	vec4 ambiante = vec4(0.f);
 	vec4 diffuse = vec4(0.f);
 	vec4 specular = vec4(0.f);
 
 	vec3 surfacePos = position;
+#ifdef HAS_TEXTURE
 	vec4 surfaceColor = texture(tex, uv);
+#else
+	vec4 surfaceColor = color;
+#endif
 	vec3 surfaceToCamera = normalize(c_pos - surfacePos);
 
 	vec3 result = vec3(0);
@@ -89,17 +93,17 @@ void main(){
 				vec3 surfaceToLight  = -light.direction.xyz;
 
 				//ambient
-				vec3 amb = vec3(mat.COLOR_AMBIENT) * light.dis.x * surfaceColor.rgb * light.color.rgb;
+				vec3 amb = ambientFactor * light.dis.x * surfaceColor.rgb * light.color.rgb;
 
 				 //diffuse
 				float diffuseCoefficient = max(0.0f, dot(normal, surfaceToLight));
-				vec3 diff = vec3(mat.COLOR_DIFFUSE) * diffuseCoefficient * surfaceColor.rgb * light.color.rgb;
+				vec3 diff = diffuseFactor * diffuseCoefficient * surfaceColor.rgb * light.color.rgb;
     
 				//specular
 				float specularCoefficient = 0.0f;
 				if(diffuseCoefficient > 0.0f)
 					specularCoefficient = pow(max(0.0f, dot(surfaceToCamera, reflect(-surfaceToLight, normal))), 0.3f);
-				vec3 spec = specularCoefficient * vec3(mat.COLOR_SPECULAR) * light.color.rgb;
+				vec3 spec = specularCoefficient * specularFactor * light.color.rgb;
 
 				//linear color (color before gamma correction)
 				result = amb + (diff  + spec) * shadowFactor;
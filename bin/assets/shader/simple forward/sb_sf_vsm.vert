@@ -3,7 +3,11 @@
 
 layout(location = 0) in vec3 a_position;
 layout(location = 1) in vec3 a_normal;
+#ifdef HAS_TEXTURE
 layout(location = 2) in vec2 a_uv;
+#else
+layout(location = 2) in vec4 a_col;
+#endif
 
 layout(location = 3) uniform mat4 m_transform;
 layout(location = 4) uniform mat3 m_transInvTrans;
@@ -13,13 +17,21 @@ layout(location = 6) uniform mat4 c_shadow;
 
 out vec3 position;
 out vec3 normal;
+#ifdef HAS_TEXTURE
 out vec2 uv;
+#else
+out vec4 color;
+#endif
 out vec4 shadowP;
 
 void main(){
 	gl_Position = c_comb * m_transform * vec4(a_position.xyz, 1.f);
 	position = vec3(m_transform * vec4(a_position.xyz, 1.f));
 	normal = normalize(m_transInvTrans * a_normal);
+#ifdef HAS_TEXTURE
 	uv = a_uv;
+#else
+	color = a_col;
+#endif
 	shadowP = c_shadow * m_transform * vec4(a_position.xyz, 1.f);
 };
\ No newline at end of file
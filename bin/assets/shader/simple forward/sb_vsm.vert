@@ -1,13 +1,17 @@
 
 #version 460 core
 
+#include "../include/vertex.glsl"
+
 layout(location = 0) in vec3 a_position;
 
 out vec4 position;
 
 layout(location = 1) uniform mat4 lightSpaceMatrix;
 layout(location = 2) uniform mat4 m_transform;
+layout(location = 3) uniform vec3 m_boundsMin;
+layout(location = 4) uniform vec3 m_boundsExtent;
 
 void main() {	
-	position  = gl_Position = lightSpaceMatrix * m_transform * vec4(a_position, 1.0);
+	position  = gl_Position = lightSpaceMatrix * m_transform * vec4(decodePosition(a_position, m_boundsMin, m_boundsExtent), 1.0);
 };
\ No newline at end of file
@@ -1,28 +1,8 @@
 
 #version 460 core
 
-#define POINT_LIGHT 0
-#define SPOT_LIGHT 1
-#define DIRECTIONAL_LIGHT 2
-
-struct Light{
-	vec4 type;
-	vec4 position;
-	vec4 direction;
-	vec4 color;
-	vec4 funcvalues;
-	vec4 dis; //intensity, maxDistance, 0, 0
-	vec4 sl; //sl_innerAngle, sl_outerAngle, sl_maxRadius
-};
-
-struct Material{
-	vec4 COLOR_DIFFUSE;
-	vec4 COLOR_SPECULAR;
-	vec4 COLOR_AMBIENT;
-	vec4 COLOR_EMISSIVE;
-	vec4 COLOR_TRANSPARENT;
-	vec4 vals; //OPACITY, SHININESS, SHININESS_STRENGTH
-};
+#include "../include/light.glsl"
+#include "../include/material.glsl"
 
 out vec4 fragColor;
 
@@ -32,9 +12,10 @@ in vec2 uv;
 
 layout(location = 6) uniform vec3 c_pos;
 layout(location = 7) uniform uint matIndex;
-layout(location = 8) uniform uint hasTexture;
 
+#ifdef HAS_TEXTURE
 layout (binding = 0) uniform sampler2D tex;
+#endif
 
 restrict readonly layout(binding = 1, std430) buffer dynamicLightBuffer {
 	vec4 size;
@@ -58,7 +39,11 @@ void main(){
 	vec4 specular = vec4(0.f);
 
 	vec3 surfacePos = position;
-	vec4 surfaceColor = hasTexture == 1 ? texture(tex, uv) : vec4(0.f, 0.f, 0.f, 1.f);
+#ifdef HAS_TEXTURE
+	vec4 surfaceColor = texture(tex, uv);
+#else
+	vec4 surfaceColor = vec4(0.f, 0.f, 0.f, 1.f);
+#endif
 	vec3 surfaceToCamera = normalize(c_pos - surfacePos);
 
 	vec3 result = vec3(0);
@@ -1,8 +1,10 @@
 
 #version 460 core
 
+#include "../include/vertex.glsl"
+
 layout(location = 0) in vec3 a_position;
-layout(location = 1) in vec3 a_normal;
+layout(location = 1) in vec2 a_normal;
 layout(location = 2) in vec2 a_uv;
 
 layout(location = 3) uniform mat4 m_transform; //model transform
@@ -10,13 +12,18 @@ layout(location = 4) uniform mat3 m_transInvTrans; //model inv trans
 
 layout(location = 5) uniform mat4 c_comb; //camera combined
 
+//6 & 7 are taken by the fragment stage
+layout(location = 8) uniform vec3 m_boundsMin; //mesh bounds
+layout(location = 9) uniform vec3 m_boundsExtent;
+
 out vec3 position;
 out vec3 normal;
 out vec2 uv;
 
 void main(){
-	gl_Position = c_comb * m_transform * vec4(a_position.xyz, 1.f);
-	position = vec3(m_transform * vec4(a_position.xyz, 1.f));
-	normal = normalize(m_transInvTrans * a_normal);
+	vec4 local = vec4(decodePosition(a_position, m_boundsMin, m_boundsExtent), 1.f);
+	gl_Position = c_comb * m_transform * local;
+	position = vec3(m_transform * local);
+	normal = normalize(m_transInvTrans * decodeNormal(a_normal));
 	uv = a_uv;
 };
\ No newline at end of file
@@ -1,28 +1,8 @@
 
 #version 460 core
 
-#define POINT_LIGHT 0
-#define SPOT_LIGHT 1
-#define DIRECTIONAL_LIGHT 2
-
-struct Light{
-	vec4 type;
-	vec4 position;
-	vec4 direction;
-	vec4 color;
-	vec4 funcvalues;
-	vec4 dis; //intensity, maxDistance, 0, 0
-	vec4 sl; //sl_innerAngle, sl_outerAngle, sl_maxRadius
-};
-
-struct Material{
-	vec4 COLOR_DIFFUSE;
-	vec4 COLOR_SPECULAR;
-	vec4 COLOR_AMBIENT;
-	vec4 COLOR_EMISSIVE;
-	vec4 COLOR_TRANSPARENT;
-	vec4 vals; //OPACITY, SHININESS, SHININESS_STRENGTH
-};
+#include "../include/light.glsl"
+#include "../include/material.glsl"
 
 out vec4 fragColor;
 
@@ -1,6 +1,7 @@
 #include "..\..\Rehmetzel_v2\include\Rehmetzel\GL\Texture.hpp"
 
 #include <fstream>
+#include <filesystem>
 
 #include "Assets.hpp"
 #include "Level.h"
@@ -11,112 +12,720 @@
 #include "G3D.hpp"
 #include "CameraUtils.hpp"
 #include "Math.hpp"
+#include "TextureCompression.hpp"
+#include "MeshOptimizer.hpp"
 
 using namespace Heerbann;
 
-Ressource::Ressource(std::string _id, Type _type) : type(_type), id(_id){
+Ressource::Ressource(std::string _id, Type _type) : type(_type), id(_id), key(StringId::intern(_id)) {
 	M_Asset->loadFromDisk(_id, this);
 }
 
 Ressource::~Ressource() {
+	destroy();
+}
+
+void Ressource::destroy() {
+	if (destroyed) return;
+	destroyed = true;
 	M_Asset->unload(this);
 }
 
+LoadHandle Ressource::getHandle() {
+	return request;
+}
+
+void Ressource::retain() {
+	managed = true;
+	++refs;
+}
+
+void Ressource::release() {
+	assert(refs > 0 && "release without retain");
+	lastUse = M_Asset->getClock();
+	--refs;
+}
+
+uint Ressource::getRefs() {
+	return refs;
+}
+
+void Ressource::touch() {
+	lastUse = M_Asset->getClock();
+}
+
+//---------------------- LoadRequest ----------------------\\
+
+LoadRequest::LoadRequest(Ressource* _res) : res(_res) {}
+
+void LoadRequest::finish(LoadState _state) {
+	LoadState current = state;
+	while (current == LoadState::queued || current == LoadState::loading || current == LoadState::decoding || current == LoadState::uploading) {
+		if (state.compare_exchange_weak(current, _state)) {
+			if (current != LoadState::queued) --M_Asset->inFlight;
+			return;
+		}
+	}
+}
+
+bool LoadRequest::evict() {
+	LoadState expected = LoadState::ready;
+	return state.compare_exchange_strong(expected, LoadState::evicted);
+}
+
+void LoadRequest::fail(const std::string& _error) {
+	if (done()) return;
+	error = _error;
+	LOG("failed to load [" + res->id + "]: " + _error);
+	finish(LoadState::failed);
+}
+
+LoadState LoadRequest::getState() {
+	return state;
+}
+
+bool LoadRequest::done() {
+	LoadState s = state;
+	return s == LoadState::ready || s == LoadState::failed || s == LoadState::cancelled || s == LoadState::evicted;
+}
+
+void LoadRequest::cancel() {
+	cancelRequested = true;
+	//never dispatched, nothing to wait for
+	if (state == LoadState::queued) finish(LoadState::cancelled);
+}
+
+void LoadRequest::setPriority(int _priority) {
+	priority = _priority;
+	if (state == LoadState::queued) M_Asset->enqueue(shared_from_this());
+}
+
+int LoadRequest::getPriority() {
+	return priority;
+}
+
+const std::string& LoadRequest::getError() {
+	return error;
+}
+
+LoadState LoadRequest::wait() {
+	while (!done()) {
+		M_Asset->update();
+		M_Jobs->runGLJobs();
+		if (!M_Jobs->runOne()) std::this_thread::yield();
+	}
+	return state;
+}
+
+//---------------------- AssetManager ----------------------\\
+
 void AssetManager::loadFromDisk(std::string _id, Ressource* _res) {
-	assets[_id] = _res;
-	#pragma omp parallel
+	//called from the Ressource constructor: the derived object isn't complete yet,
+	//so the load is only queued on the next update
+	_res->request = std::make_shared<LoadRequest>(_res);
+	std::lock_guard<std::mutex> guard(scheduleLock);
+	assets[_res->key] = _res;
+	toSchedule.emplace_back(_res);
+}
+
+void AssetManager::unload(Ressource* _res) {
+	//called from Ressource::destroy while the derived object is still whole, nothing may outlive this call
+	{
+		std::lock_guard<std::mutex> guard(scheduleLock);
+		assets.erase(_res->key);
+		toSchedule.erase(std::remove(toSchedule.begin(), toSchedule.end(), _res), toSchedule.end());
+	}
+	LoadRequest* r = _res->request.get();
+	r->cancel();
 	{
-		_res->load();
-		M_Main->addJob(_res->glLoad, _res);
+		//waits for a running stage, the stages after it see the detached request and only finish
+		std::lock_guard<std::mutex> guard(r->stageLock);
+		r->res = nullptr;
+		r->finish(LoadState::cancelled);
 	}
+	_res->unload();
+	if (App::Main::hasGL()) _res->glUnload(nullptr);
 }
 
-void AssetManager::unload(Ressource* _res) {
-	assets.erase(_res->id);
-	#pragma omp parallel
+void AssetManager::enqueue(const LoadHandle& _request) {
+	std::lock_guard<std::mutex> guard(scheduleLock);
+	queue.push({ _request->priority, nextOrder++, _request });
+}
+
+void AssetManager::update() {
+	++clock;
+	enforceBudgets();
+	std::vector<LoadHandle> list;
+	{
+		std::lock_guard<std::mutex> guard(scheduleLock);
+		for (Ressource* res : toSchedule)
+			queue.push({ res->request->priority, nextOrder++, res->request });
+		toSchedule.clear();
+		while (!queue.empty() && inFlight + list.size() < maxInFlight) {
+			Pending p = queue.top();
+			queue.pop();
+			//stale after a priority change, or already dispatched or cancelled
+			if (p.priority != p.request->priority || p.request->state != LoadState::queued) continue;
+			list.emplace_back(p.request);
+		}
+	}
+	for (auto& r : list)
+		dispatch(r);
+}
+
+bool AssetManager::runStage(LoadRequest* _request, const std::function<bool()>& _stage) {
+	try {
+		return _stage();
+	} catch (std::exception* ex) {
+		_request->fail(ex->what());
+		delete ex;
+	} catch (const std::exception& ex) {
+		_request->fail(ex.what());
+	} catch (...) {
+		_request->fail("unknown error");
+	}
+	//like a cancelled load, so nothing a failed stage allocated (upload ring slots) stays pinned
+	if (_request->res != nullptr) _request->res->unload();
+	return true;
+}
+
+void AssetManager::dispatch(const LoadHandle& _request) {
+	LoadState expected = LoadState::queued;
+	if (!_request->state.compare_exchange_strong(expected, LoadState::loading)) return;
+	++inFlight;
+
+	//io & decode on a worker, every stage boundary is a cancellation point.
+	//the stages only hold the request, the ressource is reached through it under stageLock
+	JobHandle cpu = M_Jobs->submit([_request]()->bool {
+		LoadRequest* r = _request.get();
+		std::lock_guard<std::mutex> guard(r->stageLock);
+		return runStage(r, [r]()->bool {
+			if (r->res == nullptr || r->cancelRequested) {
+				r->finish(LoadState::cancelled);
+				return true;
+			}
+			r->res->load();
+			if (r->cancelRequested) {
+				r->res->unload();
+				r->finish(LoadState::cancelled);
+				return true;
+			}
+			r->state = LoadState::decoding;
+			r->res->decode();
+			return true;
+		});
+	});
+
+	//gl finalization on the main thread, budgeted by JobScheduler::runGLJobs
+	auto upload = [_request]()->bool {
+		LoadRequest* r = _request.get();
+		if (r->done()) return true;
+		std::lock_guard<std::mutex> guard(r->stageLock);
+		if (r->res == nullptr) {
+			r->finish(LoadState::cancelled);
+			return true;
+		}
+		return runStage(r, [r]()->bool {
+			if (r->cancelRequested) {
+				r->res->unload();
+				r->finish(LoadState::cancelled);
+				return true;
+			}
+			r->state = LoadState::uploading;
+			//glLoad usually drops what glCost is computed from
+			unsigned long long bytes = App::Main::hasGL() ? r->res->glCost().bytes : 0;
+			if (!(App::Main::hasGL() ? r->res->glLoad(nullptr) : r->res->headlessLoad())) return false;
+			r->res->gpuBytes = bytes;
+			r->res->lastUse = M_Asset->getClock();
+			r->finish(LoadState::ready);
+			return true;
+		});
+	};
+
+	if (!App::Main::hasGL()) {
+		M_Jobs->then(cpu, upload);
+		return;
+	}
+	M_Jobs->submitGL(upload, [_request]()->GLCost {
+		std::lock_guard<std::mutex> guard(_request->stageLock);
+		return _request->done() || _request->res == nullptr ? GLCost() : _request->res->glCost();
+	}, { cpu });
+}
+
+void AssetManager::finish() {
+	while (true) {
+		update();
+		{
+			std::lock_guard<std::mutex> guard(scheduleLock);
+			if (toSchedule.empty() && queue.empty() && inFlight == 0 && !M_Jobs->busy()) return;
+		}
+		//loads may register new ressources, so no JobScheduler::pump here
+		M_Jobs->runGLJobs();
+		if (!M_Jobs->runOne()) std::this_thread::yield();
+	}
+}
+
+void AssetManager::setMaxInFlight(uint _max) {
+	maxInFlight = std::max(1u, _max);
+}
+
+uint AssetManager::queued() {
+	std::lock_guard<std::mutex> guard(scheduleLock);
+	return static_cast<uint>(toSchedule.size() + queue.size());
+}
+
+uint AssetManager::loading() {
+	return inFlight;
+}
+
+bool AssetManager::mount(const std::string& _path) {
+	PackArchive* archive = new PackArchive();
+	if (!archive->open(_path)) {
+		delete archive;
+		return false;
+	}
+	std::lock_guard<std::mutex> guard(archiveLock);
+	archives.emplace_back(archive);
+	return true;
+}
+
+void AssetManager::unmount(const std::string& _path) {
+	std::lock_guard<std::mutex> guard(archiveLock);
+	for (auto it = archives.begin(); it != archives.end(); ++it) {
+		if ((*it)->getPath() != _path) continue;
+		PackArchive* archive = *it;
+		archives.erase(it);
+		if (archive->users == 0) delete archive;
+		else archive->unmounted = true;
+		return;
+	}
+}
+
+bool AssetManager::find(const std::string& _id, PackArchive*& _archive, const PackEntry*& _entry) {
+	std::lock_guard<std::mutex> guard(archiveLock);
+	for (auto it = archives.rbegin(); it != archives.rend(); ++it) {
+		const PackEntry* e = (*it)->find(_id);
+		if (e == nullptr) continue;
+		_archive = *it;
+		_entry = e;
+		++_archive->users;
+		return true;
+	}
+	return false;
+}
+
+void AssetManager::release(PackArchive* _archive) {
+	std::lock_guard<std::mutex> guard(archiveLock);
+	assert(_archive->users > 0 && "release without find");
+	if (--_archive->users == 0 && _archive->unmounted) delete _archive;
+}
+
+ShaderCache* AssetManager::getShaderCache() {
+	return &shaderCache;
+}
+
+void AssetManager::enforceBudgets() {
+	std::vector<LoadHandle> victims;
 	{
-		_res->unload();
-		M_Main->addJob(_res->glUnload, _res);
+		std::lock_guard<std::mutex> guard(scheduleLock);
+		if (budgets.empty()) return;
+		struct Entry {
+			Ressource* res;
+			unsigned long long cpu, gpu;
+		};
+		std::unordered_map<Type, std::vector<Entry>> resident;
+		for (auto& it : assets) {
+			Ressource* res = it.second;
+			if (budgets.count(res->type) == 0 || res->request->getState() != LoadState::ready) continue;
+			resident[res->type].push_back({ res, res->cpuSize(), res->gpuBytes });
+		}
+		for (auto& it : resident) {
+			const AssetBudget& budget = budgets[it.first];
+			unsigned long long cpu = 0, gpu = 0;
+			for (const Entry& e : it.second) {
+				cpu += e.cpu;
+				gpu += e.gpu;
+			}
+			auto cpuOver = [&]() { return budget.cpu != 0 && cpu > budget.cpu; };
+			auto gpuOver = [&]() { return budget.gpu != 0 && gpu > budget.gpu; };
+			if (!cpuOver() && !gpuOver()) continue;
+
+			std::vector<Entry>& list = it.second;
+			list.erase(std::remove_if(list.begin(), list.end(), [](const Entry& _e) {
+				return !_e.res->managed || _e.res->refs > 0 || !_e.res->reloadable();
+			}), list.end());
+			std::sort(list.begin(), list.end(), [](const Entry& _a, const Entry& _b) {
+				return _a.res->lastUse < _b.res->lastUse;
+			});
+			for (const Entry& e : list) {
+				if (!cpuOver() && !gpuOver()) break;
+				//only evict what brings the exceeded side down
+				if (!(cpuOver() && e.cpu > 0) && !(gpuOver() && e.gpu > 0)) continue;
+				//an acquire after this sees evicted and queues a reload, which isn't dispatched before this update is done
+				if (!e.res->request->evict()) continue;
+				victims.emplace_back(e.res->request);
+				++evictions[e.res->type];
+				cpu -= e.cpu;
+				gpu -= e.gpu;
+			}
+			if (cpuOver() || gpuOver())
+				LOG("asset budget of type " + std::to_string(it.first) + " exceeded, everything left is referenced or not reloadable");
+		}
+	}
+	for (auto& v : victims)
+		evict(v);
+}
+
+void AssetManager::evict(const LoadHandle& _request) {
+	//destroy detaches the ressource under stageLock before it is freed
+	std::lock_guard<std::mutex> guard(_request->stageLock);
+	Ressource* res = _request->res;
+	if (res == nullptr) return;
+	res->isLoaded = false;
+	res->unload();
+	if (App::Main::hasGL()) res->glUnload(nullptr);
+	res->gpuBytes = 0;
+}
+
+void AssetManager::reload(Ressource* _res) {
+	if (_res->request->getState() != LoadState::evicted) return;
+	//a fresh request, whoever waited on the old one saw it finish as evicted
+	_res->request = std::make_shared<LoadRequest>(_res);
+	toSchedule.emplace_back(_res);
+}
+
+void AssetManager::setBudget(Type _type, unsigned long long _cpu, unsigned long long _gpu) {
+	std::lock_guard<std::mutex> guard(scheduleLock);
+	if (_cpu == 0 && _gpu == 0) budgets.erase(_type);
+	else budgets[_type] = { _cpu, _gpu };
+}
+
+AssetBudget AssetManager::getBudget(Type _type) {
+	std::lock_guard<std::mutex> guard(scheduleLock);
+	auto it = budgets.find(_type);
+	return it == budgets.end() ? AssetBudget() : it->second;
+}
+
+Residency AssetManager::getResidency(Type _type) {
+	std::lock_guard<std::mutex> guard(scheduleLock);
+	Residency out;
+	for (auto& it : assets) {
+		Ressource* res = it.second;
+		if (res->type != _type || res->request->getState() != LoadState::ready) continue;
+		++out.count;
+		if (res->refs > 0) ++out.referenced;
+		out.cpu += res->cpuSize();
+		out.gpu += res->gpuBytes;
 	}
+	auto e = evictions.find(_type);
+	if (e != evictions.end()) out.evictions = e->second;
+	return out;
+}
+
+Residency AssetManager::getResidency() {
+	Residency out;
+	for (uint t = Type::byteArray; t <= Type::heightmap; ++t) {
+		Residency r = getResidency(static_cast<Type>(t));
+		out.count += r.count;
+		out.referenced += r.referenced;
+		out.cpu += r.cpu;
+		out.gpu += r.gpu;
+		out.evictions += r.evictions;
+	}
+	return out;
+}
+
+bool AssetManager::isResident(StringId _id) {
+	std::lock_guard<std::mutex> guard(scheduleLock);
+	auto it = assets.find(_id);
+	return it != assets.end() && it->second->request->getState() == LoadState::ready;
+}
+
+unsigned long long AssetManager::getClock() {
+	return clock;
 }
 
-bool AssetManager::exists(std::string _id) {
+bool AssetManager::exists(StringId _id) {
+	std::lock_guard<std::mutex> guard(scheduleLock);
 	return assets.count(_id) > 0;
 }
 
-Image::Image(std::string _id) : Ressource(_id, Type::image) {}
+Image::Image(std::string _id, MipContent _mips) : Ressource(_id, Type::image), mipContent(_mips) {}
+
+Image::~Image() {
+	destroy();
+}
 
 void Image::load() {
-	std::ifstream ifs(id, std::ios::binary);
-	if (!ifs.good()) throw new std::exception((std::string("can't open file [") + id + std::string("]")).data());
-	ifs.seekg(0, std::ios::end);
-	dataSize = (int)ifs.tellg();
-	ifs.seekg(0, std::ios::beg);
-	char* data = new char[dataSize];
-	ifs.read(data, dataSize);
-	ifs.close();
+	if (!file.open(id)) throw new std::exception((std::string("can't open file [") + id + std::string("]")).data());
+	dataSize = static_cast<uint>(file.size());
+	//the decoder reads the whole file, fault it in now instead of page by page
+	file.prefetch();
+}
+
+void Image::decode() {
 	image = new sf::Image();
-	image->loadFromMemory(data, dataSize);
+	bool ok = image->loadFromMemory(file.data(), file.size());
+	file.close();
+	if (!ok) throw new std::exception((std::string("can't decode image [") + id + std::string("]")).data());
+	if (mipContent != MipContent::none)
+		mips.build(image->getPixelsPtr(), image->getSize().x, image->getSize().y, mipContent);
 	isLoaded = true;
 }
 
 void Image::unload() {
+	file.close();
 	delete image;
 	image = nullptr;
+	mips.clear();
 }
 
 sf::Image* Image::get() {
 	return image;
 }
 
+unsigned long long Image::cpuSize() {
+	if (image == nullptr) return mips.size();
+	return static_cast<unsigned long long>(image->getSize().x) * image->getSize().y * 4 + mips.size();
+}
+
+bool Image::reloadable() {
+	return true;
+}
+
+MipChain* Image::getMips() {
+	return mipContent == MipContent::none ? nullptr : &mips;
+}
+
 void Image::finish() {
 	if (isLoaded) return;
 	using namespace std::chrono_literals;
 	auto timestamp = TIMESTAMP;
 	while (!isLoaded) {
 		std::this_thread::sleep_for(0.1ms);
-		unsigned long long elapsedTime = std::chrono::duration_cast<std::chrono::microseconds>(TIMESTAMP.time - timestamp.time).count();
+		unsigned long long elapsedTime = std::chrono::duration_cast<std::chrono::seconds>(TIMESTAMP.time - timestamp.time).count();
 		assert(elapsedTime < 4 && "time out!");
 	}
 }
 
-Image* Image::get(std::string _id) {
+Image* Image::get(StringId _id) {
 	return M_Asset->get<Image*>(_id);
 }
 
-Texture2D::Texture2D(std::string _id, GLuint _target, GLint _level, GLint _internalFormat, GLenum _format, GLenum _type) : 
+//---------------------- ImageBatch ----------------------\\
+
+uint ImageBatch::add(const std::string& _file, unsigned char* _dst, size_t _capacity, Vec2u _size, MipContent _mips) {
+	assert(job == nullptr && "the batch was submitted already");
+	BatchImage image;
+	image.file = _file;
+	image.dst = _dst;
+	image.capacity = _capacity;
+	image.size = _size;
+	image.mips = _mips;
+	images.emplace_back(image);
+	return static_cast<uint>(images.size() - 1);
+}
+
+void ImageBatch::decode(BatchImage& _image) {
+	auto begin = std::chrono::steady_clock::now();
+	AssetFile file;
+	if (!file.open(_image.file)) {
+		_image.error = "can't open file";
+		return;
+	}
+	file.prefetch();
+	auto read = std::chrono::steady_clock::now();
+	_image.readMs = std::chrono::duration<float, std::milli>(read - begin).count();
+
+	//sfml decodes into memory of its own, the texels are copied out while they are still in cache
+	sf::Image image;
+	bool ok = image.loadFromMemory(file.data(), file.size());
+	file.close();
+	if (!ok) {
+		_image.error = "can't decode image";
+		return;
+	}
+	const Vec2u size(image.getSize().x, image.getSize().y);
+	if (_image.size != Vec2u() && size != _image.size) {
+		_image.error = "is " + std::to_string(size.x) + "x" + std::to_string(size.y) + ", expected " 
+			+ std::to_string(_image.size.x) + "x" + std::to_string(_image.size.y);
+		return;
+	}
+	if (bytes(size, _image.mips) > _image.capacity) {
+		_image.error = "doesn't fit into " + std::to_string(_image.capacity) + " bytes";
+		return;
+	}
+	if (_image.mips == MipContent::none)
+		std::memcpy(_image.dst, image.getPixelsPtr(), bytes(size, _image.mips));
+	else {
+		MipChain chain;
+		chain.build(_image.dst, image.getPixelsPtr(), size.x, size.y, _image.mips);
+	}
+	_image.size = size;
+	_image.ok = true;
+	_image.decodeMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - read).count();
+}
+
+JobHandle ImageBatch::submit() {
+	if (job != nullptr) return job;
+	start = std::chrono::steady_clock::now();
+	std::vector<JobHandle> jobs;
+	jobs.reserve(images.size());
+	for (auto& i : images) {
+		BatchImage* image = &i;
+		jobs.emplace_back(M_Jobs->submit([image]()->bool {
+			decode(*image);
+			return true;
+		}));
+	}
+	job = M_Jobs->submit([this]()->bool {
+		wall = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return true;
+	}, jobs);
+	return job;
+}
+
+bool ImageBatch::run() {
+	M_Jobs->wait(submit());
+	return failed() == nullptr;
+}
+
+bool ImageBatch::finished() {
+	return job != nullptr && job->finished();
+}
+
+uint ImageBatch::size() {
+	return static_cast<uint>(images.size());
+}
+
+BatchImage& ImageBatch::get(uint _index) {
+	return images[_index];
+}
+
+BatchImage* ImageBatch::failed() {
+	for (auto& i : images)
+		if (!i.ok) return &i;
+	return nullptr;
+}
+
+float ImageBatch::wallMs() {
+	return wall;
+}
+
+float ImageBatch::decodeMs() {
+	float out = 0.f;
+	for (auto& i : images)
+		out += i.readMs + i.decodeMs;
+	return out;
+}
+
+void ImageBatch::log(const std::string& _name) {
+	LOG("Decoded: [" + _name + "] " + std::to_string(images.size()) + " images in " + std::to_string(wall) + "ms, "
+		+ std::to_string(decodeMs()) + "ms serial on " + std::to_string(M_Jobs->workerCount()) + " workers");
+	for (auto& i : images)
+		LOG("   " + i.file + ": " + (i.ok ? std::to_string(i.readMs) + "ms read, " + std::to_string(i.decodeMs) + "ms decode" : i.error));
+}
+
+size_t ImageBatch::bytes(Vec2u _size, MipContent _mips) {
+	return MipChain::chainSize(_size.x, _size.y, _mips);
+}
+
+bool ImageBatch::peekSize(const char* _data, size_t _size, Vec2u& _out) {
+	//signature, then IHDR is always the first chunk: length, type, width, height big endian
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	if (_size < 24 || std::memcmp(_data, signature, 8) != 0 || std::memcmp(_data + 12, "IHDR", 4) != 0) return false;
+	const unsigned char* p = reinterpret_cast<const unsigned char*>(_data);
+	_out.x = (uint(p[16]) << 24) | (uint(p[17]) << 16) | (uint(p[18]) << 8) | uint(p[19]);
+	_out.y = (uint(p[20]) << 24) | (uint(p[21]) << 16) | (uint(p[22]) << 8) | uint(p[23]);
+	return _out.x > 0 && _out.y > 0;
+}
+
+Texture2D::Texture2D(std::string _id, GLuint _target, GLint _level, GLint _internalFormat, GLenum _format, GLenum _type, MipContent _mips) :
 	Ressource(_id, Type::texture2D), target(_target), level(_level), 
-	internalFormat(_internalFormat), format(_format), type(_type) {}
+	internalFormat(_internalFormat), format(_format), type(_type), mipContent(_mips) {}
+
+Texture2D::~Texture2D() {
+	destroy();
+}
 
 void Texture2D::load() {
-	std::ifstream ifs(id, std::ios::binary);
-	if (ifs.good()) {
-		ifs.seekg(0, std::ios::end);
-		dataSize = (int)ifs.tellg();
-		ifs.seekg(0, std::ios::beg);
-		char* dataC = new char[dataSize];
-		ifs.read(dataC, dataSize);		
-		sf::Image* img = new sf::Image();
-		data = img;
-		img->loadFromMemory(dataC, dataSize);
-		bounds = Vec2u(img->getSize().x, img->getSize().y);
-		delete dataC;
-	}
-	ifs.close();
+	if (!file.open(id)) throw new std::exception((std::string("can't open file [") + id + std::string("]")).data());
+	dataSize = static_cast<uint>(file.size());
+	file.prefetch();
+}
+
+void Texture2D::decode() {
+	sf::Image* img = new sf::Image();
+	data = img;
+	bool ok = img->loadFromMemory(file.data(), file.size());
+	file.close();
+	if (!ok) throw new std::exception((std::string("can't decode image [") + id + std::string("]")).data());
+	bounds = Vec2u(img->getSize().x, img->getSize().y);
+	if (mipContent != MipContent::none) {
+		//the chain keeps its own copy of level 0, the image isn't needed anymore
+		mips.build(img->getPixelsPtr(), bounds.x, bounds.y, mipContent);
+		delete img;
+		data = nullptr;
+	}
+	stage();
+}
+
+void Texture2D::stage() {
+	UploadRing* ring = M_Upload;
+	if (ring == nullptr) return;
+	sf::Image* img = reinterpret_cast<sf::Image*>(data);
+	//the levels of a chain are already back to back
+	const unsigned char* pixels = mips.levels() > 0 ? mips.level(0) : img->getPixelsPtr();
+	const size_t bytes = mips.levels() > 0 ? mips.size() : static_cast<size_t>(bounds.x) * bounds.y * 4;
+	if (!ring->allocate(bytes, staging)) return;
+	std::memcpy(staging.pntr, pixels, bytes);
+	stagedLevels = std::max(1u, mips.levels());
+	mips.clear();
+	delete img;
+	data = nullptr;
+}
+
+void Texture2D::unload() {
+	//only set if the load was cancelled or evicted before the upload
+	file.close();
+	delete reinterpret_cast<sf::Image*>(data);
+	data = nullptr;
+	mips.clear();
+	if (staging.valid()) M_Upload->cancel(staging);
 }
 
 bool Texture2D::glLoad(void*) {
 	sf::Image* img = reinterpret_cast<sf::Image*>(data);
+	const uint levels = staging.valid() ? stagedLevels : mips.levels();
 	glGenTextures(1, &handle);
 	glBindTexture(target, handle);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexImage2D(target, level, internalFormat, img->getSize().x, img->getSize().y, 0, format, type, img->getPixelsPtr());
+	if (staging.valid()) {
+		//the driver copies from the ring asynchronously, the fence behind submit recycles the slot
+		const bool chain = mipContent != MipContent::none;
+		if (chain) glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+		M_Upload->bind();
+		size_t offset = 0;
+		for (uint l = 0, w = bounds.x, h = bounds.y; l < levels; ++l, w = std::max(1u, w / 2), h = std::max(1u, h / 2)) {
+			glTexImage2D(target, level + l, internalFormat, w, h, 0, chain ? GL_RGBA : format, chain ? GL_UNSIGNED_BYTE : type, staging.source(offset));
+			offset += static_cast<size_t>(w) * h * 4;
+		}
+		M_Upload->unbind();
+		M_Upload->submit(staging);
+	} else if (mips.levels() > 0) {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mips.levels() - 1);
+		for (uint l = 0; l < mips.levels(); ++l)
+			glTexImage2D(target, level + l, internalFormat, mips.levelBounds(l).x, mips.levelBounds(l).y, 0, GL_RGBA, GL_UNSIGNED_BYTE, mips.level(l));
+		mips.clear();
+	} else {
+		glTexImage2D(target, level, internalFormat, img->getSize().x, img->getSize().y, 0, format, type, img->getPixelsPtr());
+		delete img;
+		data = nullptr;
+	}
 	glBindTexture(target, 0);
-	delete data;
-	data = nullptr;
 	isLoaded = true;
 	GLError("Texture2D::glLoad");
 	return true;
@@ -127,6 +736,18 @@ bool Texture2D::glUnload(void*) {
 	return true;
 }
 
+bool Texture2D::reloadable() {
+	return true;
+}
+
+GLCost Texture2D::glCost() {
+	GLCost cost;
+	cost.bytes = static_cast<unsigned long long>(bounds.x) * bounds.y * 4;
+	//a full chain adds a third
+	if (mipContent != MipContent::none) cost.bytes += cost.bytes / 3;
+	return cost;
+}
+
 GLuint Texture2D::get() {
 	return handle;
 }
@@ -167,55 +788,156 @@ void Texture2D::setParaf(GLenum _pname, GLfloat _param) {
 	GLError("Texture2D::setParaf");
 }
 
-Texture2D* Texture2D::get(std::string _id) {
+Texture2D* Texture2D::get(StringId _id) {
 	return M_Asset->get<Texture2D*>(_id);
 }
 
 Array2DTexture::Array2DTexture(std::string _id, std::vector<std::string> _files, GLuint _levels, GLuint _target, 
-	GLint _level, GLint _internalFormat, GLenum _format, GLenum _type) :
+	GLint _level, GLint _internalFormat, GLenum _format, GLenum _type, MipContent _mips) :
 	Ressource(_id, Type::texture2DArray), files(_files), levels(_levels), target(_target), level(_level),
-	internalFormat(_internalFormat), format(_format), type(_type){}
+	internalFormat(_internalFormat), format(_format), type(_type), mipContent(_mips) {}
+
+Array2DTexture::~Array2DTexture() {
+	destroy();
+}
 
 void Array2DTexture::load() {
-	dataSize = files.size();
-	Image** imgs = new Image*[dataSize];
-	for (uint i = 0; i < dataSize; ++i) {
-		imgs[i] = new Image(files[i]);
+	dataSize = static_cast<uint>(files.size());
+	compressed = files[0].size() > 5 && files[0].compare(files[0].size() - 5, 5, ".rtex") == 0;
+	if (compressed) {
+		//no decode at all, the blocks go from the mapping straight to the driver
+		cooked = new CookedTexture[dataSize];
+		for (uint i = 0; i < dataSize; ++i) {
+			if (!cooked[i].open(files[i]))
+				throw new std::exception((std::string("can't open file [") + files[i] + std::string("]")).data());
+			if (cooked[i].getFormat() != cooked[0].getFormat() || cooked[i].width() != cooked[0].width() 
+				|| cooked[i].height() != cooked[0].height() || cooked[i].levels() != cooked[0].levels())
+				throw new std::exception((std::string("layer [") + files[i] + std::string("] doesn't match the first layer")).data());
+		}
+		bounds = Vec2u(cooked[0].width(), cooked[0].height());
+		levels = cooked[0].levels();
+		internalFormat = BlockCompressor::glFormat(cooked[0].getFormat());
+		cookedBytes = cooked[0].size() * dataSize;
+		return;
 	}
-	for (uint i = 0; i < dataSize; ++i) {
-		imgs[i]->finish();
+	//the size comes from the header of the first layer, so the destination of the decode is known up front
+	AssetFile header;
+	if (!header.open(files[0]))
+		throw new std::exception((std::string("can't open file [") + files[0] + std::string("]")).data());
+	if (!ImageBatch::peekSize(header.data(), header.size(), bounds))
+		throw new std::exception((std::string("layer [") + files[0] + std::string("] is not a png")).data());
+	header.close();
+	if (mipContent != MipContent::none) levels = MipChain::levelCount(bounds.x, bounds.y);
+}
+
+void Array2DTexture::decode() {
+	UploadRing* ring = M_Upload;
+	if (compressed) {
+		if (ring == nullptr || !ring->allocate(cookedBytes, staging)) return;
+		char* out = reinterpret_cast<char*>(staging.pntr);
+		for (uint i = 0; i < dataSize; ++i)
+			for (GLint l = 0; l < levels; ++l) {
+				std::memcpy(out, cooked[i].level(l), cooked[i].levelSize(l));
+				out += cooked[i].levelSize(l);
+			}
+		return;
+	}
+	//every layer decodes on a worker of its own straight into its slice
+	const size_t bytes = layerBytes();
+	unsigned char* out = nullptr;
+	if (ring != nullptr && ring->allocate(bytes * dataSize, staging))
+		out = reinterpret_cast<unsigned char*>(staging.pntr);
+	else {
+		pixels.resize(bytes * dataSize);
+		out = pixels.data();
+	}
+	ImageBatch batch;
+	for (uint i = 0; i < dataSize; ++i)
+		batch.add(files[i], out + i * bytes, bytes, bounds, mipContent);
+	const bool ok = batch.run();
+	batch.log(id);
+	if (!ok) {
+		BatchImage* failed = batch.failed();
+		throw new std::exception((std::string("layer [") + failed->file + std::string("] ") + failed->error).data());
 	}
 }
 
+size_t Array2DTexture::layerBytes() {
+	if (compressed) return cooked[0].size();
+	return ImageBatch::bytes(bounds, mipContent);
+}
+
+void Array2DTexture::unload() {
+	//whatever a failed, cancelled or evicted load left behind
+	if (staging.valid()) M_Upload->cancel(staging);
+	delete[] cooked;
+	cooked = nullptr;
+	std::vector<unsigned char>().swap(pixels);
+}
+
 bool Array2DTexture::glLoad(void*) {
 	assert(dataSize != 0 && "datasize == 0, no images loaded");
-	assert(data != nullptr && "data is null");
-	glGenTextures(GL_TEXTURE_2D_ARRAY, &handle);
+	if (compressed) {
+		glGenTextures(1, &handle);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, handle);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, internalFormat, bounds.x, bounds.y, dataSize);
+		GLError("Array2DTexture::glLoad::glTexStorage3D");
+		if (staging.valid()) M_Upload->bind();
+		size_t offset = 0;
+		for (uint i = 0; i < dataSize; ++i) {
+			for (GLint l = 0; l < levels; ++l) {
+				Vec2u size = cooked[i].levelBounds(l);
+				glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, l, 0, 0, i, size.x, size.y, 1, internalFormat,
+					static_cast<GLsizei>(cooked[i].levelSize(l)), staging.valid() ? staging.source(offset) : cooked[i].level(l));
+				offset += cooked[i].levelSize(l);
+			}
+			GLError("Array2DTexture::glLoad::glCompressedTexSubImage3D");
+		}
+		if (staging.valid()) {
+			M_Upload->unbind();
+			M_Upload->submit(staging);
+		}
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		delete[] cooked;
+		cooked = nullptr;
+		isLoaded = true;
+		return true;
+	}
+	glGenTextures(1, &handle);
 	glBindTexture(GL_TEXTURE_2D_ARRAY, handle);
 	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
 	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
 	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	GLError("Array2DTexture::glLoad::glGenTextures");
-	
-	Image** imgs = reinterpret_cast<Image**>(data);
-	auto image = imgs[0];
-	Vec2u bounds = Vec2u(image->get()->getSize().x, image->get()->getSize().y);
-	Vec2u size(image->get()->getSize().x, image->get()->getSize().y);
+	if (mipContent != MipContent::none)
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	//reserve storage
-	glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, internalFormat, size.x, size.y, dataSize);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, internalFormat, bounds.x, bounds.y, dataSize);
 	GLError("Array2DTexture::glLoad::glTexStorage3D");
-	//add files
+	//add files, from the ring if they were staged. every layer is its levels back to back
+	const size_t bytes = layerBytes();
+	if (staging.valid()) M_Upload->bind();
 	for (uint i = 0; i < dataSize; ++i) {
-		Image* im = imgs[i];
-		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, size.x, size.y, 1, format, type, image->get()->getPixelsPtr());
+		size_t offset = i * bytes;
+		const GLint decoded = mipContent == MipContent::none ? 1 : levels;
+		for (GLint l = 0, w = bounds.x, h = bounds.y; l < decoded; ++l, w = std::max(1, w / 2), h = std::max(1, h / 2)) {
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, l, 0, 0, i, w, h, 1, mipContent == MipContent::none ? format : GL_RGBA, 
+				mipContent == MipContent::none ? type : GL_UNSIGNED_BYTE, staging.valid() ? staging.source(offset) : pixels.data() + offset);
+			offset += static_cast<size_t>(w) * h * 4;
+		}
 		GLError("Array2DTexture::glLoad::glTexSubImage3D");
 	}
-	//glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
-	//GLError("Array2DTexture::glLoad::glGenerateMipmap");
+	if (staging.valid()) {
+		M_Upload->unbind();
+		M_Upload->submit(staging);
+	}
 	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
-	delete data;
-	data = nullptr;
+	std::vector<unsigned char>().swap(pixels);
 	isLoaded = true;
 	return true;
 }
@@ -226,6 +948,20 @@ bool Array2DTexture::glUnload(void*) {
 	return true;
 }
 
+bool Array2DTexture::reloadable() {
+	return true;
+}
+
+GLCost Array2DTexture::glCost() {
+	GLCost cost;
+	if (compressed) {
+		cost.bytes = cookedBytes;
+		return cost;
+	}
+	cost.bytes = static_cast<unsigned long long>(layerBytes()) * dataSize;
+	return cost;
+}
+
 GLuint Array2DTexture::get() {
 	return handle;
 }
@@ -273,129 +1009,112 @@ sf::Sprite* AtlasRegion::createSprite() {
 }
 
 Vec2 AtlasRegion::getU() {
-	return Vec2();
-	//return Vec2(1.f / (float)parent->tex[texIndex]->getSize().x * (float)x, 1.f / (float)parent->tex[texIndex]->getSize().x * (float)(x + width));
+	return u;
 }
 
 Vec2 AtlasRegion::getV() {
-	return Vec2();
-	//return Vec2(1.f / (float)parent->tex[texIndex]->getSize().y * (float)y, 1.f / (float)parent->tex[texIndex]->getSize().y * (float)(y + height));
+	return v;
 }
 
 TextureAtlas::TextureAtlas(std::string _id) : Ressource(_id, Type::atlas) {}
 
-AtlasRegion* TextureAtlas::getRegion(std::string _id) {
-	if (regions.count(_id) == 0) throw new std::exception((std::string("region does not exist [") + _id + std::string("]")).c_str());
-	return regions[_id];
+TextureAtlas::~TextureAtlas() {
+	destroy();
+	for (auto& r : regions)
+		delete r.second;
 }
 
-TextureAtlas* TextureAtlas::get(std::string _id) {
-	return M_Asset->get<TextureAtlas*>(_id);
+AtlasRegion* TextureAtlas::getRegion(StringId _id) {
+	if (AtlasRegion* existing = regions.get(_id)) return existing;
+	const int index = find(_id);
+	if (index < 0) throw new std::exception((std::string("region does not exist [") + _id.str() + std::string("]")).c_str());
+	AtlasRegion* r = new AtlasRegion();
+	region(static_cast<uint>(index), *r);
+	regions[_id] = r;
+	return r;
 }
 
-void Heerbann::TextureAtlas::load() {
-	std::ifstream file(id + std::string(".atlas"));
-
-	int lineNr = 1;
-	int imgNr = 0;
-
-	bool newImg = false;
-
-	AtlasRegion* cR = nullptr;
-	int regionNr = 1;
-
-	for (std::string line; getline(file, line); ++lineNr) {
+int TextureAtlas::find(StringId _id) {
+	return table.get().find(_id);
+}
 
-		//first 5 lines
-		switch (lineNr) {
-		case 1:
-		{
-			std::string fileId = id.substr(0, id.find_last_of("/") + 1) + line;
-			textures[fileId] = new Texture2D(fileId, GL_TEXTURE_2D, 0, GL_RGBA16F, GL_RGBA, GL_FLOAT);
-			continue;
-		}
-		break;
-		case 2: continue;
-		case 3: continue;
-		case 4: continue;
-		case 5: continue;
-		}
+int TextureAtlas::find(StringId _id, int _frame) {
+	return table.get().find(_id, _frame);
+}
 
-		//new img
-		if (line.empty()) {
-			++imgNr;
-			lineNr = 0;
-			continue;
-		}
+uint TextureAtlas::regionCount() {
+	return table.get().regions;
+}
 
-		//atlasregion
-		switch (regionNr) {
-		case 1: //name
-		{
-			++regionNr;
-			cR = new AtlasRegion();
-			cR->parent = this;
-			cR->texIndex = imgNr;
-			regions[line] = cR;
-			//atlas->regionList.emplace_back(cR);
-			continue;
-		}
-		break;
-		case 2:
-			++regionNr;
-			continue;
-		case 3: //xy
-		{
-			++regionNr;
-			int pos1 = static_cast<int>(line.find_first_of(":") + 2);
-			int pos2 = static_cast<uint>(line.find_first_of(","));
-			int pos3 = static_cast<uint>(line.length() - (pos2 + 1));
+void TextureAtlas::region(uint _index, AtlasRegion& _out) {
+	const AtlasTable& t = table.get();
+	assert(_index < t.regions);
+	const uint p = t.page[_index];
+	_out.parent = this;
+	_out.texIndex = static_cast<int>(p);
+	_out.x = t.x[_index];
+	_out.y = t.y[_index];
+	_out.width = t.width[_index];
+	_out.height = t.height[_index];
+	_out.texture = p < pages.size() && pages[p] ? pages[p]->get() : 0;
+	const float tw = 1.f / static_cast<float>(t.pageWidth[p]);
+	const float th = 1.f / static_cast<float>(t.pageHeight[p]);
+	_out.u = Vec2(_out.x * tw, (_out.x + _out.width) * tw);
+	_out.v = Vec2(_out.y * th, (_out.y + _out.height) * th);
+}
 
-			auto x = line.substr(pos1, pos2 - pos1);
-			auto y = line.substr(pos2 + 2, pos3 + 1);
+Texture2D* TextureAtlas::page(uint _index) {
+	return pages[_index].get();
+}
 
-			cR->x = std::stoi(x);
-			cR->y = std::stoi(y);
-		}
-		break;
-		case 4: //size
-		{
-			++regionNr;
-			int pos1 = static_cast<uint>(line.find_first_of(":") + 2);
-			int pos2 = static_cast<uint>(line.find_first_of(","));
-			int pos3 = static_cast<uint>(line.length() - (pos2 + 1));
+uint TextureAtlas::pageCount() {
+	return static_cast<uint>(pages.size());
+}
 
-			auto w = line.substr(pos1, pos2 - pos1);
-			auto h = line.substr(pos2 + 2, pos3 + 1);
+TextureAtlas* TextureAtlas::get(StringId _id) {
+	return M_Asset->get<TextureAtlas*>(_id);
+}
 
-			cR->width = std::stoi(w);
-			cR->height = std::stoi(h);
-		}
-		break;
-		case 5:
-			++regionNr;
-			continue;
-		case 6:
-			++regionNr;
-			continue;
-		case 7:
-			regionNr = 1;
-			continue;
-		}
+void TextureAtlas::load() {
+	//the cooked table is mapped as is while it matches the text it was cooked from, an edited .atlas
+	//is parsed again. without the text (shipped cooked only) the cooked table is taken as it is
+	AssetFile text;
+	const bool hasText = text.open(id + std::string(".atlas"));
+	const unsigned long long hash = hasText ? CookedAtlas::hash(text.data(), text.size()) : 0;
+	if (!table.open(id + std::string(".ratlas"), hash)) {
+		if (!hasText) throw new std::exception((std::string("can't open file [") + id + std::string(".atlas]")).data());
+		table.parse(text.data(), text.size(), id + std::string(".atlas"));
+	}
+	text.close();
+	const AtlasTable& t = table.get();
+	const std::string dir = id.substr(0, id.find_last_of("/") + 1);
+	pages.resize(t.pages);
+	for (uint i = 0; i < t.pages; ++i) {
+		const std::string file = dir + std::string(t.pageName(i));
+		pages[i] = M_Asset->acquire<Texture2D>(file);
+		if (!pages[i]) pages[i] = AssetRef<Texture2D>(new Texture2D(file, GL_TEXTURE_2D, 0, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE));
 	}
-
-	//atlas->tex.resize(atlas->files.size());
-	//atlas->img.resize(atlas->files.size());
-	file.close();
 }
 
 bool TextureAtlas::glLoad(void*) {
-	//TODO
+	const AtlasTable& t = table.get();
+	for (uint i = 0; i < t.pages; ++i) {
+		LoadHandle page = pages[i]->getHandle();
+		if (page->getState() == LoadState::failed || page->getState() == LoadState::cancelled)
+			throw new std::exception((std::string("page [") + std::string(t.pageName(i)) + std::string("] failed to load")).data());
+		if (!page->done()) return false;
+	}
+	//regions handed out before the pages were up
+	for (auto& r : regions)
+		r.second->texture = pages[r.second->texIndex]->get();
+	isLoaded = true;
 	return true;
 }
 
 bool TextureAtlas::glUnload(void*) {
-	//TODO
+	//the pages are ressources of their own, only the references go
+	pages.clear();
+	table.close();
 	return true;
 }
 
@@ -405,12 +1124,17 @@ SSBO::SSBO(std::string _id, uint _size, void* _data, GLbitfield _flags) : Ressou
 	flags = _flags;
 }
 
+SSBO::~SSBO() {
+	destroy();
+}
+
 bool SSBO::glLoad(void*) {
 	glGenBuffers(1, &handle);
 	glBindBuffer(GL_SHADER_STORAGE_BUFFER, handle);
 	glBufferStorage(GL_SHADER_STORAGE_BUFFER, dataSize, data, flags);
 	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 	GLError("SSBO::glLoad::" + id);
+	isLoaded = true;
 	return true;
 }
 
@@ -421,6 +1145,12 @@ bool SSBO::glUnload(void*) {
 	return true;
 }
 
+GLCost SSBO::glCost() {
+	GLCost cost;
+	cost.bytes = data == nullptr ? 0 : dataSize;
+	return cost;
+}
+
 void SSBO::bind(uint _binding) {
 	bindAs(GL_SHADER_STORAGE_BUFFER, _binding);
 }
@@ -450,28 +1180,57 @@ void SSBO::unmap() {
 	GLError("SSBO::unmap::" + id);
 }
 
-SSBO* SSBO::get(std::string _id) {
+SSBO* SSBO::get(StringId _id) {
 	return M_Asset->get<SSBO*>(_id);
 }
 
 void Model::load() {
-	Assimp::Importer importer;
-	const aiScene *scene = importer.ReadFile(id, aiProcess_ValidateDataStructure | aiProcess_FixInfacingNormals |
-		aiProcess_FlipUVs);
-
-	//vec3 pos
-	//vec3 normals
-	//vev2 uv
-	//float index
-	std::vector<float> vertexBuffer;
-	std::vector<unsigned int> indexBuffer;
-	//offset, size
+	AssetFile source;
+	if (!source.open(id)) throw new std::exception((std::string("can't open file [") + id + std::string("]")).data());
+	source.prefetch();
+	unsigned long long hash = ModelCache::hash(source.data(), source.size());
 
 	model = new ModelData();
+	bool cached = false;
+	try {
+		cached = ModelCache::read(id + ".cooked", hash, model, cooked);
+	} catch (std::exception* e) {
+		LOG("corrupt cooked model [" + id + "], reimporting: " + e->what());
+		delete e;
+		//the caches point into the mapping, the rest of what was read so far goes with the ModelData
+		model->vertexBufferCache = nullptr;
+		model->indexBufferCache = nullptr;
+		delete model;
+		cooked.close();
+		model = new ModelData();
+	}
 
-	std::vector<Material> materialList;
+	if (!cached) {
+		import(source);
+		if (!ModelCache::write(id + ".cooked", hash, model))
+			LOG("can't write cooked model [" + id + ".cooked]");
+	}
+
+	model->matBuffer = new SSBO(id + "_matBuffer", static_cast<uint>(sizeof(Material) * model->materials.size()), model->materials.data(), 0);
+}
+
+void Model::import(AssetFile& _source) {
+	//triangulated so every mesh goes through MeshOptimizer, identical vertices are merged there after packing
+	const uint flags = aiProcess_ValidateDataStructure | aiProcess_FixInfacingNormals | aiProcess_FlipUVs | aiProcess_Triangulate;
+	Assimp::Importer importer;
+	//loose files go through the path so formats with side files (obj + mtl) still resolve them
+	const aiScene *scene = _source.packed() ?
+		importer.ReadFileFromMemory(_source.data(), _source.size(), flags, id.substr(id.find_last_of('.') + 1).c_str()) :
+		importer.ReadFile(id, flags);
+	if (scene == nullptr) throw new std::exception((std::string("can't import model [") + id + "]: " + importer.GetErrorString()).data());
+
+	//PackedVertex, positions relative to the bounds of their mesh
+	std::vector<PackedVertex> vertexBuffer;
+	std::vector<unsigned int> indexBuffer;
+	//offset, size
 
 	//Material
+	std::vector<Material>& materialList = model->materials;
 	materialList.resize(scene->mNumMaterials);
 	for (uint i = 0; i < scene->mNumMaterials; ++i) {
 		Material material;
@@ -505,7 +1264,6 @@ void Model::load() {
 
 	//Vertex & Index data
 	int meshIndexOffset = 0;
-	int meshVertexOffset = 0;
 	//meshes
 
 	model->meshList.resize(scene->mNumMeshes);
@@ -517,64 +1275,92 @@ void Model::load() {
 		aiMesh* mesh = scene->mMeshes[i];
 		Mesh* meshOut = new Mesh();
 		model->meshList[i] = meshOut;
-		model->meshMap[std::string(mesh->mName.C_Str())] = meshOut;
+		meshOut->id = mesh->mName.C_Str();
+		model->meshMap[StringId::intern(meshOut->id)] = meshOut;
 
-		meshOut->vertexCount = mesh->mNumVertices;
 		meshOut->vertexOffset = static_cast<uint>(vertexBuffer.size());
 		meshOut->matIndex = mesh->mMaterialIndex;
+		meshOut->root = nullptr;
+		//indices are absolute, they are rebased onto the first vertex of this mesh
+		const uint baseVertex = static_cast<uint>(vertexBuffer.size());
+
+		//bounds, y & z are swapped
+		Vec3 min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max());
+		for (unsigned int k = 0; k < mesh->mNumVertices; ++k) {
+			auto pos = mesh->mVertices[k];
+			min = glm::min(min, Vec3(pos.x, pos.z, pos.y));
+			max = glm::max(max, Vec3(pos.x, pos.z, pos.y));
+		}
+		if (mesh->mNumVertices > 0) {
+			meshOut->boundsMin = min;
+			meshOut->boundsExtent = max - min;
+		}
 
 		//vertex
+		std::vector<PackedVertex> vertices;
+		vertices.reserve(mesh->mNumVertices);
+		auto uv = mesh->mTextureCoords[0];
 		for (unsigned int k = 0; k < mesh->mNumVertices; ++k) {
 			auto pos = mesh->mVertices[k];
-			auto norm = mesh->mNormals[k];
-			auto uv = mesh->mTextureCoords[0];
-
-			//pos
-			vertexBuffer.emplace_back(pos.x);
-			vertexBuffer.emplace_back(pos.z);
-			vertexBuffer.emplace_back(pos.y);
-			//norm
-			vertexBuffer.emplace_back(norm.x);
-			vertexBuffer.emplace_back(norm.z);
-			vertexBuffer.emplace_back(norm.y);
-			//uv
-			vertexBuffer.emplace_back(uv == NULL ? 0.f : uv[k].x);
-			vertexBuffer.emplace_back(uv == NULL ? 0.f : uv[k].y);
-
-			meshVertexOffset += mesh->mNumVertices;
+			Vec3 normal = mesh->mNormals == NULL ? Vec3(0.f, 1.f, 0.f) : Vec3(mesh->mNormals[k].x, mesh->mNormals[k].z, mesh->mNormals[k].y);
+			vertices.emplace_back(PackedVertex::pack(Vec3(pos.x, pos.z, pos.y), meshOut->boundsMin, meshOut->boundsExtent, 
+				normal, uv == NULL ? Vec2(0.f) : Vec2(uv[k].x, uv[k].y)));
 		}
 
 		//index
-		int iCount = 0;
+		std::vector<uint> indices;
 		for (unsigned int k = 0; k < mesh->mNumFaces; ++k) {
 			auto& face = mesh->mFaces[k];
-			for (unsigned int j = 0; j < face.mNumIndices; ++j) {
-				indexBuffer.emplace_back(meshIndexOffset + face.mIndices[j]);
-				++iCount;
-			}
+			for (unsigned int j = 0; j < face.mNumIndices; ++j)
+				indices.emplace_back(face.mIndices[j]);
 		}
 
-		meshOut->indexCount = iCount;
+		//old vertex -> new vertex, empty if the mesh kept its order (points & lines)
+		std::vector<uint> remap;
+		if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE) {
+			MeshStats before, after;
+			MeshOptimizer::optimize(vertices, indices, meshOut->boundsMin, meshOut->boundsExtent, remap, before, after);
+			LOG("Optimized: [" + std::string(mesh->mName.C_Str()) + "] " + std::to_string(before.vertices) + " -> " + std::to_string(after.vertices)
+				+ " vertices, acmr " + std::to_string(before.acmr) + " -> " + std::to_string(after.acmr)
+				+ ", atvr " + std::to_string(before.atvr) + " -> " + std::to_string(after.atvr));
+		}
+
+		meshOut->vertexCount = static_cast<uint>(vertices.size());
+		vertexBuffer.insert(vertexBuffer.end(), vertices.begin(), vertices.end());
+		for (uint index : indices)
+			indexBuffer.emplace_back(baseVertex + index);
+
+		meshOut->indexCount = static_cast<uint>(indices.size());
 		meshOut->indexOffset = meshIndexOffset;
 
-		meshIndexOffset += iCount;
+		meshIndexOffset += static_cast<int>(indices.size());
 
-		model->boneCache[i].resize(mesh->mNumBones);
+		model->boneCache[i].reserve(mesh->mNumBones);
 		for (uint k = 0; k < mesh->mNumBones; ++k) {
-			auto bone = mesh->mBones[i];
+			auto bone = mesh->mBones[k];
 			Bone* out = new Bone();
+			out->parent = nullptr;
 			model->boneCache[i].emplace_back(out);
 			out->id = bone->mName.C_Str();
-			meshOut->boneMap[out->id] = out;
-			out->numWeights = bone->mNumWeights;
+			meshOut->boneMap[StringId::intern(out->id)] = out;
 			out->offset = Mat4(
 				bone->mOffsetMatrix.a1, bone->mOffsetMatrix.b1, bone->mOffsetMatrix.c1, bone->mOffsetMatrix.d1,
 				bone->mOffsetMatrix.a2, bone->mOffsetMatrix.b2, bone->mOffsetMatrix.c2, bone->mOffsetMatrix.d2,
 				bone->mOffsetMatrix.a3, bone->mOffsetMatrix.b3, bone->mOffsetMatrix.c3, bone->mOffsetMatrix.d3,
 				bone->mOffsetMatrix.a4, bone->mOffsetMatrix.b4, bone->mOffsetMatrix.c4, bone->mOffsetMatrix.d4);
-			out->weights.resize(bone->mNumWeights);
-			for (uint j = 0; j < bone->mNumWeights; ++j)
-				out->weights[j] = std::make_tuple(bone->mWeights[j].mVertexId, bone->mWeights[j].mWeight);
+			//onto the optimized vertices, merged vertices keep a single weight
+			out->weights.reserve(bone->mNumWeights);
+			for (uint j = 0; j < bone->mNumWeights; ++j) {
+				const uint vertex = remap.empty() ? bone->mWeights[j].mVertexId : remap[bone->mWeights[j].mVertexId];
+				if (vertex != MeshOptimizer::INVALID) out->weights.emplace_back(std::make_tuple(vertex, bone->mWeights[j].mWeight));
+			}
+			std::stable_sort(out->weights.begin(), out->weights.end(), [](const std::tuple<uint, float>& _a, const std::tuple<uint, float>& _b)->bool {
+				return std::get<0>(_a) < std::get<0>(_b);
+			});
+			out->weights.erase(std::unique(out->weights.begin(), out->weights.end(), [](const std::tuple<uint, float>& _a, const std::tuple<uint, float>& _b)->bool {
+				return std::get<0>(_a) == std::get<0>(_b);
+			}), out->weights.end());
+			out->numWeights = static_cast<uint>(out->weights.size());
 		}
 
 	}
@@ -583,20 +1369,20 @@ void Model::load() {
 	std::function<mNode*(mNode*, aiNode*)> sort = [&](mNode* _parent, aiNode* _self)->mNode* {
 
 		mNode* out = new mNode();
-		if (_parent != nullptr) {
-			out->parent = _parent;
+		out->parent = _parent;
+		if (_parent != nullptr)
 			_parent->children.emplace_back(out);
-		}
 		out->id = _self->mName.C_Str();
 		out->meshes.resize(_self->mNumMeshes);
-		std::memcpy(&out->meshes[0], _self->mMeshes, _self->mNumMeshes * sizeof(uint));
+		if (_self->mNumMeshes > 0)
+			std::memcpy(&out->meshes[0], _self->mMeshes, _self->mNumMeshes * sizeof(uint));
 		out->transform = Mat4(
 			_self->mTransformation.a1, _self->mTransformation.b1, _self->mTransformation.c1, _self->mTransformation.d1,
 			_self->mTransformation.a2, _self->mTransformation.b2, _self->mTransformation.c2, _self->mTransformation.d2,
 			_self->mTransformation.a3, _self->mTransformation.b3, _self->mTransformation.c3, _self->mTransformation.d3,
 			_self->mTransformation.a4, _self->mTransformation.b4, _self->mTransformation.c4, _self->mTransformation.d4);
 
-		model->nodeMap[out->id] = out;
+		model->nodeMap[StringId::intern(out->id)] = out;
 		model->nodeCache.emplace_back(out);
 		if (_self->mNumChildren == 0) return out;
 		for (uint i = 0; i < _self->mNumChildren; ++i)
@@ -604,19 +1390,24 @@ void Model::load() {
 		return out;
 	};
 
-	//modelOut->root = sort(nullptr, scene->mRootNode);
+	model->root = sort(nullptr, scene->mRootNode);
 
 	//animations
 	for (uint i = 0; i < scene->mNumAnimations; ++i) {
 		auto an = scene->mAnimations[i];
 		Animation* out = new Animation();
+		model->animations.emplace_back(out);
+		out->id = an->mName.C_Str();
 		out->duration = FLOAT(an->mDuration);
 		out->ticksPerSecond = FLOAT(an->mTicksPerSecond);
 
 		for (uint j = 0; j < an->mNumChannels; ++j) {
 			auto chan = an->mChannels[j];
 			NodeAnimation* na = new NodeAnimation();
+			out->nodeChannels.emplace_back(na);
 			na->affectedNode = chan->mNodeName.C_Str();
+			na->preState = static_cast<AnimBehaviour>(chan->mPreState);
+			na->postState = static_cast<AnimBehaviour>(chan->mPostState);
 
 			na->positionKeys.resize(chan->mNumPositionKeys);
 			for (uint k = 0; k < chan->mNumPositionKeys; ++k) {
@@ -632,7 +1423,7 @@ void Model::load() {
 
 			na->scalingKeys.resize(chan->mNumScalingKeys);
 			for (uint k = 0; k < chan->mNumScalingKeys; ++k) {
-				auto vec = chan->mPositionKeys[k];
+				auto vec = chan->mScalingKeys[k];
 				na->scalingKeys[k] = VectorKey{ FLOAT(vec.mTime), Vec3(vec.mValue.x, vec.mValue.y, vec.mValue.z) };
 			}
 		}
@@ -640,6 +1431,7 @@ void Model::load() {
 		for (uint j = 0; j < an->mNumMeshChannels; ++j) {
 			auto chan = an->mMeshChannels[j];
 			MeshAnimation* ma = new MeshAnimation();
+			out->meshChannels.emplace_back(ma);
 			ma->affectedMesh = chan->mName.C_Str();
 			ma->keys.resize(chan->mNumKeys);
 			for (uint k = 0; k < chan->mNumKeys; ++k) {
@@ -650,49 +1442,35 @@ void Model::load() {
 	}
 
 	model->vertexBufferCacheSize = static_cast<uint>(vertexBuffer.size());
-	model->vertexBufferCache = new float[vertexBuffer.size()];
-	std::memcpy(model->vertexBufferCache, vertexBuffer.data(), vertexBuffer.size() * sizeof(float));
+	model->vertexBufferCache = new PackedVertex[vertexBuffer.size()];
+	std::memcpy(model->vertexBufferCache, vertexBuffer.data(), vertexBuffer.size() * sizeof(PackedVertex));
 
 	model->indexBufferCacheSize = static_cast<uint>(indexBuffer.size());
 	model->indexBufferCache = new unsigned int[indexBuffer.size()];
 	std::memcpy(model->indexBufferCache, indexBuffer.data(), indexBuffer.size() * sizeof(unsigned int));
-
-	model->matBuffer = new SSBO(id + "_matBuffer", sizeof(Material) * materialList.size(), materialList.data(), 0);
-
 }
 
 bool Model::glLoad(void*) {
 
 	if (!modelDataLoaded) {
 		modelDataLoaded = true;
-		model = reinterpret_cast<ModelData*>(data);
 		LOG("Loading: [Model] " + id);
-		GLuint vbo;
-		GLuint index;
-
 		//create buffer
 		glGenVertexArrays(1, &model->vao);
-		glGenBuffers(1, &vbo);
-		glGenBuffers(1, &index);
+		glGenBuffers(1, &model->vbo);
+		glGenBuffers(1, &model->indexBuffer);
 
 		glBindVertexArray(model->vao);
 
 		//vbo
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(float) * model->vertexBufferCacheSize, model->vertexBufferCache, GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, model->vbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(PackedVertex) * model->vertexBufferCacheSize, model->vertexBufferCache, GL_STATIC_DRAW);
 
 		//index
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model->indexBuffer);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint) * model->indexBufferCacheSize, model->indexBufferCache, GL_STATIC_DRAW);
 
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+		PackedVertex::setupAttributes();
 
 		glBindVertexArray(0);
 
@@ -700,9 +1478,10 @@ bool Model::glLoad(void*) {
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 
-		if (model->vertexBufferCache != nullptr) delete model->vertexBufferCache;
-		if (model->indexBufferCache != nullptr) delete model->indexBufferCache;
-		if (model->animationCache != nullptr) delete model->animationCache;
+		//the caches are on the gpu now
+		unload();
+		delete[] model->animationCache;
+		model->animationCache = nullptr;
 
 		GLError("Model::glLoad");
 	}
@@ -711,13 +1490,55 @@ bool Model::glLoad(void*) {
 	return true;
 }
 
+void Model::unload() {
+	if (model == nullptr) return;
+	//cooked caches are views into the mapping, imported ones are owned
+	if (cooked.isOpen()) cooked.close();
+	else {
+		delete[] model->vertexBufferCache;
+		delete[] model->indexBufferCache;
+	}
+	model->vertexBufferCache = nullptr;
+	model->indexBufferCache = nullptr;
+}
+
 bool Heerbann::Model::glUnload(void *) {
-	//TODO
+	if (model == nullptr || !modelDataLoaded) return true;
+	glDeleteVertexArrays(1, &model->vao);
+	glDeleteBuffers(1, &model->vbo);
+	glDeleteBuffers(1, &model->indexBuffer);
+	modelDataLoaded = false;
+	isLoaded = false;
+	GLError("Model::glUnload");
 	return true;
 }
 
+GLCost Model::glCost() {
+	GLCost cost;
+	if (model == nullptr || modelDataLoaded) return cost;
+	cost.bytes = sizeof(PackedVertex) * model->vertexBufferCacheSize + sizeof(uint) * model->indexBufferCacheSize;
+	return cost;
+}
+
 Model::Model(std::string _id) : Ressource(_id, Type::model) {}
 
+Model::~Model() {
+	destroy();
+	if (model != nullptr) delete model->matBuffer;
+	delete model;
+}
+
+DrawCall Model::getDrawCall(uint _mesh) {
+	Mesh* mesh = model->meshList[_mesh];
+	DrawCall out;
+	out.vao = model->vao;
+	out.count = mesh->indexCount;
+	out.offset = mesh->indexOffset;
+	out.boundsMin = mesh->boundsMin;
+	out.boundsExtent = mesh->boundsExtent;
+	return out;
+}
+
 ModelData * Heerbann::Model::getData() {
 	return model;
 }
@@ -732,10 +1553,251 @@ void Model::bindinvTransform(uint _location) {
 	GLError("Model::bindinvTransform");
 }
 
-Model* Model::get(std::string _id) {
+Model* Model::get(StringId _id) {
 	return M_Asset->get<Model*>(_id);
 }
 
+//---------------------- ShaderPreprocessor ----------------------\\
+
+uint ShaderPreprocessor::fileIndex(const std::string& _path) {
+	auto it = std::find(files.begin(), files.end(), _path);
+	if (it != files.end()) return static_cast<uint>(it - files.begin());
+	files.emplace_back(_path);
+	return static_cast<uint>(files.size() - 1);
+}
+
+void ShaderPreprocessor::expand(const std::string& _path, const char* _data, size_t _size, uint _index, uint _line, std::string& _out) {
+	const std::filesystem::path directory = std::filesystem::path(_path).parent_path();
+	for (size_t pos = 0; pos < _size; ++_line) {
+		size_t end = pos;
+		while (end < _size && _data[end] != '\n') ++end;
+		std::string text(_data + pos, end - pos);
+		pos = end + 1;
+		if (!text.empty() && text.back() == '\r') text.pop_back();
+
+		size_t first = text.find_first_not_of(" \t");
+		if (first == std::string::npos || text.compare(first, 8, "#include") != 0) {
+			_out += text;
+			_out += '\n';
+			continue;
+		}
+		size_t open = text.find('"', first + 8);
+		size_t close = open == std::string::npos ? std::string::npos : text.find('"', open + 1);
+		if (close == std::string::npos)
+			throw new std::exception(("malformed #include in [" + _path + "] line " + std::to_string(_line)).c_str());
+		std::string name = (directory / text.substr(open + 1, close - open - 1)).lexically_normal().generic_string();
+		uint index = fileIndex(name);
+		//already part of this stage, the empty line keeps the numbering
+		if (std::find(included.begin(), included.end(), index) != included.end()) {
+			_out += '\n';
+			continue;
+		}
+		included.emplace_back(index);
+		AssetFile file;
+		if (!file.open(name))
+			throw new std::exception(("missing shader include [" + name + "] in [" + _path + "] line " + std::to_string(_line)).c_str());
+		_out += "#line 1 " + std::to_string(index) + "\n";
+		expand(name, file.data(), file.size(), index, 1, _out);
+		_out += "#line " + std::to_string(_line + 1) + " " + std::to_string(_index) + "\n";
+	}
+}
+
+void ShaderPreprocessor::process(const std::string& _path, const std::string& _source, const std::vector<std::string>& _defines, std::string& _out) {
+	_out.clear();
+	included.clear();
+	const uint index = fileIndex(_path);
+	included.emplace_back(index);
+
+	//everything up to and including #version stays in front of the defines
+	size_t body = 0;
+	uint line = 1;
+	for (size_t pos = 0, current = 1; pos < _source.size(); ++current) {
+		size_t end = std::min(_source.find('\n', pos), _source.size());
+		size_t first = _source.find_first_not_of(" \t", pos);
+		if (first < end && _source.compare(first, 8, "#version") == 0) {
+			body = std::min(end + 1, _source.size());
+			line = static_cast<uint>(current + 1);
+			break;
+		}
+		pos = end + 1;
+	}
+	_out.append(_source, 0, body);
+	if (!_out.empty() && _out.back() != '\n') _out += '\n';
+	for (const std::string& define : _defines) {
+		size_t split = define.find('=');
+		_out += "#define " + (split == std::string::npos ? define : define.substr(0, split) + " " + define.substr(split + 1)) + "\n";
+	}
+	_out += "#line " + std::to_string(line) + " " + std::to_string(index) + "\n";
+	expand(_path, _source.data() + body, _source.size() - body, index, line, _out);
+}
+
+std::string ShaderPreprocessor::translate(const std::string& _log) const {
+	static const std::regex reference("(\\d+)([(:])(\\d+)([):])");
+	std::stringstream in(_log);
+	std::string out, text;
+	std::smatch match;
+	while (std::getline(in, text)) {
+		if (std::regex_search(text, match, reference) && match[1].length() < 6) {
+			size_t index = std::stoul(match[1].str());
+			if (index < files.size())
+				text = match.prefix().str() + files[index] + "(" + match[3].str() + ")" + (match[4].str() == ":" ? ":" : "") + match.suffix().str();
+		}
+		out += text + "\n";
+	}
+	return out;
+}
+
+const std::vector<std::string>& ShaderPreprocessor::getFiles() const {
+	return files;
+}
+
+//---------------------- ShaderCache ----------------------\\
+
+void ShaderCache::initialize(const std::string& _directory) {
+	enabled = false;
+	directory = _directory;
+	if (directory.empty()) return;
+	if (directory.back() != '/' && directory.back() != '\\') directory += '/';
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	if (formats == 0) {
+		LOG("shader cache disabled, the driver has no program binary formats");
+		return;
+	}
+	std::string driver = std::string(reinterpret_cast<const char*>(glGetString(GL_VENDOR))) + "|"
+		+ reinterpret_cast<const char*>(glGetString(GL_RENDERER)) + "|" + reinterpret_cast<const char*>(glGetString(GL_VERSION));
+	driverHash = hash({ &driver });
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	enabled = !error;
+	if (error) LOG("shader cache disabled, can't create [" + directory + "]");
+}
+
+bool ShaderCache::isEnabled() {
+	return enabled;
+}
+
+std::string ShaderCache::path(unsigned long long _hash) {
+	std::stringstream out;
+	out << directory << std::hex << _hash << ".bin";
+	return out.str();
+}
+
+unsigned long long ShaderCache::hash(std::initializer_list<const std::string*> _parts) {
+	//fnv-1a, every part is terminated by its length so moving code between stages changes the hash
+	unsigned long long out = 0xcbf29ce484222325ull ^ SHADER_CACHE_VERSION;
+	auto mix = [&](const char* _data, size_t _size) {
+		for (size_t i = 0; i < _size; ++i) {
+			out ^= static_cast<unsigned char>(_data[i]);
+			out *= 0x100000001b3ull;
+		}
+	};
+	for (const std::string* p : _parts) {
+		mix(p->data(), p->size());
+		unsigned long long length = p->size();
+		mix(reinterpret_cast<const char*>(&length), sizeof(length));
+	}
+	return out;
+}
+
+bool ShaderCache::read(unsigned long long _hash, GLenum& _format, std::vector<char>& _binary) {
+	if (!enabled) return false;
+	MappedFile file;
+	if (!file.open(path(_hash))) return false;
+	if (file.size() < sizeof(ShaderBinaryHeader)) return false;
+	const ShaderBinaryHeader* head = reinterpret_cast<const ShaderBinaryHeader*>(file.data());
+	if (std::memcmp(head->magic, "RSPB", 4) != 0 || head->version != SHADER_CACHE_VERSION || head->sourceHash != _hash
+		|| head->driverHash != driverHash || sizeof(ShaderBinaryHeader) + head->size > file.size()) return false;
+	_format = head->format;
+	_binary.assign(file.data() + sizeof(ShaderBinaryHeader), file.data() + sizeof(ShaderBinaryHeader) + head->size);
+	return true;
+}
+
+GLuint ShaderCache::restore(unsigned long long _hash, GLenum _format, const std::vector<char>& _binary) {
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, _format, _binary.data(), static_cast<GLsizei>(_binary.size()));
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked == GL_TRUE) {
+		++hits;
+		return program;
+	}
+	//rejected binaries raise an error by design, don't let it show up in the next GLError
+	while (glGetError() != GL_NO_ERROR);
+	glDeleteProgram(program);
+	std::remove(path(_hash).c_str());
+	return 0;
+}
+
+void ShaderCache::store(unsigned long long _hash, GLuint _program) {
+	if (!enabled) return;
+	GLint length = 0;
+	glGetProgramiv(_program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+	auto binary = std::make_shared<std::vector<char>>(length);
+	GLenum format = 0;
+	glGetProgramBinary(_program, length, nullptr, &format, binary->data());
+	GLError("ShaderCache::store");
+
+	ShaderBinaryHeader head = {};
+	std::memcpy(head.magic, "RSPB", 4);
+	head.version = SHADER_CACHE_VERSION;
+	head.sourceHash = _hash;
+	head.driverHash = driverHash;
+	head.format = format;
+	head.size = static_cast<uint>(length);
+	std::string file = path(_hash);
+	M_Jobs->submit([head, binary, file]()->bool {
+		std::string tmp = file + ".tmp";
+		{
+			std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+			if (!ofs.good()) return true;
+			ofs.write(reinterpret_cast<const char*>(&head), sizeof(ShaderBinaryHeader));
+			ofs.write(binary->data(), binary->size());
+			if (!ofs.good()) return true;
+		}
+		std::remove(file.c_str());
+		std::rename(tmp.c_str(), file.c_str());
+		return true;
+	});
+}
+
+void ShaderCache::miss() {
+	++misses;
+}
+
+uint ShaderCache::getHits() {
+	return hits;
+}
+
+uint ShaderCache::getMisses() {
+	return misses;
+}
+
+//---------------------- ShaderProgram ----------------------\\
+
+std::vector<std::string> ShaderProgram::normalize(std::vector<std::string> _defines) {
+	std::sort(_defines.begin(), _defines.end());
+	_defines.erase(std::unique(_defines.begin(), _defines.end()), _defines.end());
+	return _defines;
+}
+
+std::string ShaderProgram::variantId(const std::string& _path, const std::vector<std::string>& _defines) {
+	if (_defines.empty()) return _path;
+	std::string set;
+	for (const std::string& define : _defines)
+		set += define + "\n";
+	std::stringstream out;
+	out << _path << "#" << std::hex << ShaderCache::hash({ &set });
+	return out.str();
+}
+
+std::string compileLog(const ShaderPreprocessor* _lines, const std::vector<GLchar>& _log) {
+	std::string out(_log.begin(), _log.end());
+	out.erase(std::find(out.begin(), out.end(), '\0'), out.end());
+	return _lines == nullptr ? out : _lines->translate(out);
+}
+
 void ShaderProgram::print(std::string _id, ShaderProgram::Status _compComp, ShaderProgram::Status _compVert,
 	ShaderProgram::Status _compGeom, ShaderProgram::Status _compFrag, ShaderProgram::Status _link, std::string _errorLog) {
 	if (!printDebug) return;
@@ -758,7 +1820,7 @@ void ShaderProgram::print(std::string _id, ShaderProgram::Status _compComp, Shad
 	std::cout << std::endl;
 }
 
-bool ShaderProgram::compile(const std::string& _id, const char* _compute, const char* _vertex, const char* _geom, const char* _frag) {
+bool ShaderProgram::compile(const std::string& _id, const char* _compute, const char* _vertex, const char* _geom, const char* _frag, const ShaderPreprocessor* _lines) {
 	Status compStatus = Status::missing;
 	Status vertStatus = Status::missing;
 	Status geomStatus = Status::missing;
@@ -782,7 +1844,7 @@ bool ShaderProgram::compile(const std::string& _id, const char* _compute, const
 		frag = -1;
 	}
 	if (program != -1) {
-		glDeleteShader(program);
+		glDeleteProgram(program);
 		program = -1;
 	}
 
@@ -800,7 +1862,7 @@ bool ShaderProgram::compile(const std::string& _id, const char* _compute, const
 			glGetShaderInfoLog(compute, maxLength, &maxLength, &errorLog[0]);
 			glDeleteShader(compute);
 			compStatus = Status::failed;
-			print(_id, compStatus, vertStatus, geomStatus, fragStatus, linkStatus, std::string(errorLog.begin(), errorLog.end()));
+			print(_id, compStatus, vertStatus, geomStatus, fragStatus, linkStatus, compileLog(_lines, errorLog));
 			return false;
 		} else compStatus = Status::success;
 	}
@@ -819,7 +1881,7 @@ bool ShaderProgram::compile(const std::string& _id, const char* _compute, const
 			glGetShaderInfoLog(vertex, maxLength, &maxLength, &errorLog[0]);
 			glDeleteShader(vertex);
 			vertStatus = Status::failed;
-			print(_id, compStatus, vertStatus, geomStatus, fragStatus, linkStatus, std::string(errorLog.begin(), errorLog.end()));
+			print(_id, compStatus, vertStatus, geomStatus, fragStatus, linkStatus, compileLog(_lines, errorLog));
 			return false;
 		} else vertStatus = Status::success;
 	}
@@ -838,7 +1900,7 @@ bool ShaderProgram::compile(const std::string& _id, const char* _compute, const
 			glGetShaderInfoLog(geom, maxLength, &maxLength, &errorLog[0]);
 			glDeleteShader(geom);
 			geomStatus = Status::failed;
-			print(_id, compStatus, vertStatus, geomStatus, fragStatus, linkStatus, std::string(errorLog.begin(), errorLog.end()));
+			print(_id, compStatus, vertStatus, geomStatus, fragStatus, linkStatus, compileLog(_lines, errorLog));
 			return false;
 		} else geomStatus = Status::success;
 	}
@@ -857,13 +1919,14 @@ bool ShaderProgram::compile(const std::string& _id, const char* _compute, const
 			glGetShaderInfoLog(frag, maxLength, &maxLength, &errorLog[0]);
 			glDeleteShader(frag);
 			fragStatus = Status::failed;
-			print(_id, compStatus, vertStatus, geomStatus, fragStatus, linkStatus, std::string(errorLog.begin(), errorLog.end()));
+			print(_id, compStatus, vertStatus, geomStatus, fragStatus, linkStatus, compileLog(_lines, errorLog));
 			return false;
 		} else fragStatus = Status::success;
 	}
 
 	//Link
 	program = glCreateProgram();
+	glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	if (_compute != nullptr) glAttachShader(program, compute);
 	if (_vertex != nullptr) glAttachShader(program, vertex);
 	if (_geom != nullptr) glAttachShader(program, geom);
@@ -884,7 +1947,7 @@ bool ShaderProgram::compile(const std::string& _id, const char* _compute, const
 		if (frag != -1)glDeleteShader(frag);
 		if (program != -1) glDeleteProgram(program);
 		linkStatus = Status::failed;
-		print(_id, compStatus, vertStatus, geomStatus, fragStatus, linkStatus, std::string(errorLog.begin(), errorLog.end()));
+		print(_id, compStatus, vertStatus, geomStatus, fragStatus, linkStatus, compileLog(_lines, errorLog));
 		return false;
 	} else linkStatus = Status::success;
 
@@ -903,51 +1966,64 @@ GLuint ShaderProgram::getHandle() {
 }
 
 bool ShaderProgram::loadFromMemory(const std::string& _id, const std::string& _compute, const std::string& _vertex, const std::string& _geom, const std::string& _frag) {
-	return compile(_id, _compute.empty() ? nullptr : _compute.c_str(), _vertex.empty() ? nullptr : _vertex.c_str(), _geom.empty() ? nullptr : _geom.c_str(), _frag.empty() ? nullptr : _frag.c_str());
+	Sources src;
+	if (!_compute.empty()) src.lines.process(_id + ".comp", _compute, defines, src.comp);
+	if (!_vertex.empty()) src.lines.process(_id + ".vert", _vertex, defines, src.vert);
+	if (!_geom.empty()) src.lines.process(_id + ".geom", _geom, defines, src.geom);
+	if (!_frag.empty()) src.lines.process(_id + ".frag", _frag, defines, src.frag);
+	src.hash = ShaderCache::hash({ &src.comp, &src.vert, &src.geom, &src.frag });
+	M_Asset->getShaderCache()->read(src.hash, src.binaryFormat, src.binary);
+	return build(_id, src);
+}
+
+bool ShaderProgram::build(const std::string& _id, Sources& _src) {
+	ShaderCache* cache = M_Asset->getShaderCache();
+	if (!_src.binary.empty()) {
+		GLuint restored = cache->restore(_src.hash, _src.binaryFormat, _src.binary);
+		if (restored != 0) {
+			if (program != -1) glDeleteProgram(program);
+			program = restored;
+			if (printDebug) LOG("   Shader: " + _id + " (binary cache)\n");
+			return true;
+		}
+	}
+	cache->miss();
+	if (!compile(_id, _src.comp.empty() ? nullptr : _src.comp.c_str(), _src.vert.empty() ? nullptr : _src.vert.c_str(),
+		_src.geom.empty() ? nullptr : _src.geom.c_str(), _src.frag.empty() ? nullptr : _src.frag.c_str(), &_src.lines)) return false;
+	cache->store(_src.hash, program);
+	return true;
 }
 
 void ShaderProgram::load() {
-
-	bool cExists = true;
-	bool vExists = true;
-	bool gExists = true;
-	bool fExists = true;
-
-	std::ifstream comp(id + ".comp");
-	cExists = comp.good();
-
-	std::ifstream vert(id + ".vert");
-	vExists = vert.good();
-
-	std::ifstream geom(id + ".geom");
-	gExists = geom.good();
-
-	std::ifstream frag(id + ".frag");
-	fExists = frag.good();
-
-	data = new std::tuple<std::string, std::string, std::string, std::string>(
-		(cExists ? std::string{ std::istreambuf_iterator<char>(comp), std::istreambuf_iterator<char>() } : ""),
-		(vExists ? std::string{ std::istreambuf_iterator<char>(vert), std::istreambuf_iterator<char>() } : ""),
-		(gExists ? std::string{ std::istreambuf_iterator<char>(geom), std::istreambuf_iterator<char>() } : ""),
-		(fExists ? std::string{ std::istreambuf_iterator<char>(frag), std::istreambuf_iterator<char>() } : ""));
-
-	comp.close();
-	vert.close();
-	geom.close();
-	frag.close();
+	Sources* src = new Sources();
+	//the defines end up in the sources, so the hash below keys the binary by the define set too
+	auto stage = [&](const std::string& _extension, std::string& _out) {
+		AssetFile file;
+		if (!file.open(path + _extension)) return;
+		src->lines.process(path + _extension, std::string(file.data(), file.size()), defines, _out);
+	};
+	try {
+		stage(".comp", src->comp);
+		stage(".vert", src->vert);
+		stage(".geom", src->geom);
+		stage(".frag", src->frag);
+	} catch (...) {
+		delete src;
+		throw;
+	}
+	//the binary is read here on the worker, glLoad only has to hand it to the driver
+	src->hash = ShaderCache::hash({ &src->comp, &src->vert, &src->geom, &src->frag });
+	M_Asset->getShaderCache()->read(src->hash, src->binaryFormat, src->binary);
+	data = src;
 }
 
 bool ShaderProgram::glLoad(void *) {
-	std::tuple<std::string, std::string, std::string, std::string>* tuple = reinterpret_cast<std::tuple<std::string, std::string, std::string, std::string>*>(data);
-
-	std::string comp = std::get<0>(*tuple);
-	std::string vert = std::get<1>(*tuple);
-	std::string geom = std::get<2>(*tuple);
-	std::string frag = std::get<3>(*tuple);
-
-	loadFromMemory(id, comp, vert, geom, frag);
-
-	delete tuple;
+	Sources* src = reinterpret_cast<Sources*>(data);
+	bool ok = build(id, *src);
+	delete src;
+	data = nullptr;
+	//fails the load, see AssetManager::runStage
+	if (!ok) throw new std::exception((std::string("can't build shader [") + id + std::string("]")).data());
 	isLoaded = true;
 	return true;
 }
@@ -957,7 +2033,18 @@ bool ShaderProgram::glUnload(void*) {
 	return true;
 }
 
-ShaderProgram::ShaderProgram(std::string _id) : Ressource(_id, Type::shader) {}
+GLCost ShaderProgram::glCost() {
+	GLCost cost;
+	cost.programs = 1;
+	return cost;
+}
+
+ShaderProgram::ShaderProgram(std::string _path, std::vector<std::string> _defines) :
+	Ressource(variantId(_path, normalize(_defines)), Type::shader), path(_path), defines(normalize(_defines)) {}
+
+ShaderProgram::~ShaderProgram() {
+	destroy();
+}
 
 void ShaderProgram::bind() {
 	glUseProgram(getHandle());
@@ -969,13 +2056,33 @@ void ShaderProgram::unbind() {
 	GLError("ShaderProgram::unbind");
 }
 
-ShaderProgram* ShaderProgram::get(std::string _id) {
+const std::string& ShaderProgram::getPath() {
+	return path;
+}
+
+const std::vector<std::string>& ShaderProgram::getDefines() {
+	return defines;
+}
+
+ShaderProgram* ShaderProgram::get(StringId _id) {
 	return M_Asset->get<ShaderProgram*>(_id);
 }
 
+ShaderProgram* ShaderProgram::variant(const std::string& _path, std::vector<std::string> _defines) {
+	static std::mutex lock;
+	std::lock_guard<std::mutex> guard(lock);
+	_defines = normalize(std::move(_defines));
+	ShaderProgram* out = get(variantId(_path, _defines));
+	return out != nullptr ? out : new ShaderProgram(_path, _defines);
+}
+
 ShadowMap::ShadowMap(std::string _id, Framebuffer* _fb, std::string _colorId, std::string _depthId) :
 	Ressource(_id, Type::shadowMap), fb(_fb), colorId(_colorId), depthId(_depthId) {}
 
+ShadowMap::~ShadowMap() {
+	destroy();
+}
+
 bool ShadowMap::glUnload(void*) {
 	delete fb;
 	return true;
@@ -989,7 +2096,7 @@ Texture2D* ShadowMap::getDepth() {
 	return fb->getTex(depthId);
 }
 
-ShadowMap* ShadowMap::get(std::string _id) {
+ShadowMap* ShadowMap::get(StringId _id) {
 	return M_Asset->get<ShadowMap*>(_id);
 }
 
@@ -1028,14 +2135,24 @@ bool Framebuffer::glLoad(void*) {
 }
 
 bool Framebuffer::glUnload(void*) {
-	for (auto& it : textures)
+	for (auto& it : textures) {
+		it.second->release();
 		delete it.second;
+	}
 	glDeleteFramebuffers(1, &handle);
 	GLError("Framebuffer::glUnload");
+	return true;
 }
 
 Framebuffer::Framebuffer(std::string _id, std::unordered_map<std::string, Texture2D*> _textures) :
 	Ressource(_id, Type::framebuffer), textures(_textures) {
+	//attachments are never evicted
+	for (auto& it : textures)
+		it.second->retain();
+}
+
+Framebuffer::~Framebuffer() {
+	destroy();
 }
 
 void Framebuffer::bind() {	
@@ -1056,38 +2173,60 @@ Texture2D* Framebuffer::getTex(std::string _index) {
 	return textures[_index];
 }
 
-Framebuffer* Framebuffer::get(std::string _id) {
+Framebuffer* Framebuffer::get(StringId _id) {
 	return M_Asset->get<Framebuffer*>(_id);
 }
 
-bool Font::glLoad(void *) {
-	std::ifstream ifs(id);
-	if (!ifs.good()) throw new std::exception((std::string("can't open file [") + id + std::string("]")).data());
-	ifs.seekg(0, std::ios::end);
-	dataSize = static_cast<uint>(ifs.tellg());
-	ifs.seekg(0, std::ios::beg);
-	char* data = new char[dataSize];
-	ifs.read(data, dataSize);
-	ifs.close();
+void Font::load() {
+	//glyphs are rasterized on demand, so only touch the pages freetype asks for
+	if (!file.open(id, MappedFile::Access::random)) throw new std::exception((std::string("can't open file [") + id + std::string("]")).data());
+	dataSize = static_cast<uint>(file.size());
+}
+
+void Font::decode() {
 	font = new sf::Font();
-	font->loadFromMemory(data, dataSize);
-	isLoaded  = true;
+	if (!font->loadFromMemory(file.data(), file.size()))
+		throw new std::exception((std::string("can't decode font [") + id + std::string("]")).data());
+}
+
+void Font::unload() {
+	delete font;
+	font = nullptr;
+	file.close();
+}
+
+bool Font::glLoad(void *) {
+	//sf::Font only touches gl once glyphs are rendered
+	isLoaded = true;
 	return true;
 }
 
 bool Font::glUnload(void *) {
-	delete font;
+	return true;
+}
+
+unsigned long long Font::cpuSize() {
+	//the face stays mapped (or inflated) for the font's lifetime
+	return file.isOpen() ? file.size() : 0;
+}
+
+bool Font::reloadable() {
 	return true;
 }
 
 Font::Font(std::string _id) : Ressource(_id, Type::font){}
 
-Font* Font::get(std::string _id) {
+Font::~Font() {
+	destroy();
+}
+
+Font* Font::get(StringId _id) {
 	return M_Asset->get<Font*>(_id);
 }
 
 FlipFlopSSBO::FlipFlopSSBO(std::string _id, bool _autoflip, uint _bufferCount, uint _size, GLbitfield _bufferFlags, GLbitfield _mapFlags) : 
 	Ressource(_id, Type::ssbo), size(_size), flags(_mapFlags){
+	dataSize = _size;
 	buffers.resize(_bufferCount);
 	pointers.resize(_bufferCount);
 	for (uint i = 0; i < _bufferCount; ++i)
@@ -1099,8 +2238,12 @@ FlipFlopSSBO::FlipFlopSSBO(std::string _id, bool _autoflip, uint _bufferCount, u
 	}, nullptr);
 }
 
+FlipFlopSSBO::~FlipFlopSSBO() {
+	destroy();
+}
+
 void FlipFlopSSBO::flip() {
-	index = (index++) % size;
+	index = (index + 1) % static_cast<uint>(buffers.size());
 }
 
 bool FlipFlopSSBO::glLoad(void*) {
@@ -1137,49 +2280,208 @@ void FlipFlopSSBO::unbind() {
 	buffers[index]->unbind();
 }
 
+uint FlipFlopSSBO::getIndex() {
+	return index;
+}
+
+uint FlipFlopSSBO::getCount() {
+	return static_cast<uint>(buffers.size());
+}
+
 HeightMap::HeightMap(std::string _id, uint _width, uint _height) : Ressource(_id, Type::heightmap),
 	width(_width), height(_height){
-	dataSize = _width * _height * sizeof(ushort);	
+	dataSize = _width * _height * sizeof(ushort);
+	tilesX = (_width + TILE - 1) / TILE;
+	tilesY = (_height + TILE - 1) / TILE;
+	rowWords = (tilesX + 63) / 64;
+	heights.resize(static_cast<size_t>(_width) * _height, 0);
+	for (auto& d : dirty)
+		d.resize(static_cast<size_t>(rowWords) * tilesY, 0);
+	//both buffers start out uninitialized
+	markDirty(0, 0, _width, _height);
+}
+
+HeightMap::~HeightMap() {
+	destroy();
 }
 
 void HeightMap::load() {
-	buffer = new FlipFlopSSBO(id + "_buffer", false, 2, dataSize, 
-		GL_MAP_PERSISTENT_BIT | GL_MAP_WRITE_BIT,
-		GL_MAP_PERSISTENT_BIT | GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	//coherent, the job writes plain memory and nothing flushes
+	buffer = new FlipFlopSSBO(id + "_buffer", false, 2, dataSize,
+		GL_MAP_PERSISTENT_BIT | GL_MAP_WRITE_BIT | GL_MAP_COHERENT_BIT,
+		GL_MAP_PERSISTENT_BIT | GL_MAP_WRITE_BIT | GL_MAP_COHERENT_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
 }
 
 bool HeightMap::glLoad(void*) {
 	if (!buffer->loaded()) return false;
 	M_Main->addJob([&](void*)->bool {
-		ushort* data = buffer->getPtr<ushort*>();
-		for (auto it = changeList.begin(), bit = changeList.before_begin(); it != changeList.end(); ++it, ++bit) {
-			auto el = *it;
-			data[std::get<1>(*el)] = std::get<2>(*el);
-			if (std::get<0>(*el)) {
-				changeList.erase_after(bit);
-				delete el;
-			} else std::get<0>(*el) = true;
+		//unloaded
+		if (buffer == nullptr) return true;
+		const uint next = (buffer->getIndex() + 1) % buffer->getCount();
+		if (fences[next] != nullptr) {
+			//still read by the gpu, the draws keep the current buffer for another frame
+			if (glClientWaitSync(fences[next], 0, 0) == GL_TIMEOUT_EXPIRED) return false;
+			glDeleteSync(fences[next]);
+			fences[next] = nullptr;
 		}
 		buffer->flip();
+		upload(next, buffer->getPtr<ushort*>());
 		return false;
 	}, nullptr);
 	return true;
 }
 
 bool HeightMap::glUnload(void*) {
+	for (auto& f : fences) {
+		if (f != nullptr) glDeleteSync(f);
+		f = nullptr;
+	}
 	delete buffer;
+	buffer = nullptr;
 	return true;
 }
 
+void HeightMap::markDirty(uint _x0, uint _y0, uint _x1, uint _y1) {
+	const uint tx0 = _x0 / TILE, tx1 = (_x1 - 1) / TILE;
+	const uint ty0 = _y0 / TILE, ty1 = (_y1 - 1) / TILE;
+	for (uint b = 0; b < 2; ++b) {
+		for (uint ty = ty0; ty <= ty1; ++ty) {
+			unsigned long long* words = dirty[b].data() + static_cast<size_t>(ty) * rowWords;
+			for (uint tx = tx0; tx <= tx1; ++tx) {
+				const unsigned long long bit = 1ull << (tx % 64);
+				if (words[tx / 64] & bit) continue;
+				words[tx / 64] |= bit;
+				++pending[b];
+			}
+		}
+	}
+}
+
+void HeightMap::upload(uint _buffer, ushort* _dst) {
+	if (pending[_buffer] == 0) return;
+	for (uint ty = 0; ty < tilesY; ++ty) {
+		unsigned long long* words = dirty[_buffer].data() + static_cast<size_t>(ty) * rowWords;
+		const uint y0 = ty * TILE, y1 = std::min(height, y0 + TILE);
+		uint tx = 0;
+		while (tx < tilesX) {
+			//skip clean words whole
+			if ((words[tx / 64] >> (tx % 64)) == 0) {
+				tx = (tx / 64 + 1) * 64;
+				continue;
+			}
+			if (!(words[tx / 64] & (1ull << (tx % 64)))) {
+				++tx;
+				continue;
+			}
+			//run of dirty tiles, uploaded as one span per texel row
+			uint end = tx;
+			while (end < tilesX && (words[end / 64] & (1ull << (end % 64)))) {
+				words[end / 64] &= ~(1ull << (end % 64));
+				--pending[_buffer];
+				++end;
+			}
+			const size_t x0 = static_cast<size_t>(tx) * TILE, x1 = std::min<size_t>(width, static_cast<size_t>(end) * TILE);
+			if (x0 == 0 && x1 == width)
+				//full rows are contiguous
+				std::memcpy(_dst + y0 * x1, heights.data() + y0 * x1, (y1 - y0) * x1 * sizeof(ushort));
+			else for (size_t y = y0; y < y1; ++y)
+				std::memcpy(_dst + y * width + x0, heights.data() + y * width + x0, (x1 - x0) * sizeof(ushort));
+			tx = end;
+		}
+		if (pending[_buffer] == 0) return;
+	}
+}
+
 void HeightMap::bind(uint _binding) {
 	buffer->bind(_binding);
 }
 
 void HeightMap::unbind() {
+	GLsync& fence = fences[buffer->getIndex()];
+	if (fence != nullptr) glDeleteSync(fence);
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 	buffer->unbind();
 }
 
+ushort HeightMap::get(uint _posX, uint _posY) {
+	assert(_posX < width && _posY < height);
+	return heights[static_cast<size_t>(_posY) * width + _posX];
+}
+
 void HeightMap::changeEntry(uint _posX, uint _posY, ushort _val) {
-	std::tuple<bool, uint, ushort>* tuple = new std::tuple<bool, uint, ushort>(false, _posY * width + _posX, _val);
-	changeList.push_front(tuple);
+	if (_posX >= width || _posY >= height) return;
+	heights[static_cast<size_t>(_posY) * width + _posX] = _val;
+	markDirty(_posX, _posY, _posX + 1, _posY + 1);
+}
+
+void HeightMap::setRegion(uint _x, uint _y, uint _width, uint _height, const ushort* _src) {
+	if (_x >= width || _y >= height) return;
+	const uint w = std::min(width - _x, _width), h = std::min(height - _y, _height);
+	if (w == 0 || h == 0) return;
+	for (uint y = 0; y < h; ++y)
+		std::memcpy(heights.data() + static_cast<size_t>(_y + y) * width + _x, _src + static_cast<size_t>(y) * _width, w * sizeof(ushort));
+	markDirty(_x, _y, _x + w, _y + h);
+}
+
+void HeightMap::fill(uint _x, uint _y, uint _width, uint _height, ushort _val) {
+	apply(_x, _y, _width, _height, [_val](uint, uint, ushort)->ushort {
+		return _val;
+	});
+}
+
+void HeightMap::brush(const Vec2& _centre, const HeightBrush& _brush) {
+	if (_brush.radius <= 0.f) return;
+	const int x0 = std::max(0, static_cast<int>(std::floor(_centre.x - _brush.radius)));
+	const int y0 = std::max(0, static_cast<int>(std::floor(_centre.y - _brush.radius)));
+	const int x1 = std::min(static_cast<int>(width), static_cast<int>(std::ceil(_centre.x + _brush.radius)) + 1);
+	const int y1 = std::min(static_cast<int>(height), static_cast<int>(std::ceil(_centre.y + _brush.radius)) + 1);
+	if (x0 >= x1 || y0 >= y1) return;
+
+	//smooth reads the neighbours before this brush touched them
+	std::vector<ushort> before;
+	const int bx0 = std::max(0, x0 - 1), by0 = std::max(0, y0 - 1);
+	const int bx1 = std::min(static_cast<int>(width), x1 + 1), by1 = std::min(static_cast<int>(height), y1 + 1);
+	if (_brush.mode == BrushMode::smooth) {
+		before.resize(static_cast<size_t>(bx1 - bx0) * (by1 - by0));
+		for (int y = by0; y < by1; ++y)
+			std::memcpy(before.data() + static_cast<size_t>(y - by0) * (bx1 - bx0), heights.data() + static_cast<size_t>(y) * width + bx0, (bx1 - bx0) * sizeof(ushort));
+	}
+
+	const float invRadius = 1.f / _brush.radius;
+	apply(x0, y0, x1 - x0, y1 - y0, [&](uint _x, uint _y, ushort _h)->ushort {
+		const float dx = (_x - _centre.x) * invRadius, dy = (_y - _centre.y) * invRadius;
+		const float d2 = dx * dx + dy * dy;
+		if (d2 >= 1.f) return _h;
+		//smooth falloff, 1 at the centre and flat at the rim
+		const float weight = (1.f - d2) * (1.f - d2);
+		float h = _h;
+		switch (_brush.mode) {
+			case BrushMode::raise: h += _brush.strength * weight; break;
+			case BrushMode::lower: h -= _brush.strength * weight; break;
+			case BrushMode::flatten: h += (_brush.target - h) * std::min(1.f, _brush.strength * weight); break;
+			case BrushMode::smooth:
+			{
+				float sum = 0.f;
+				uint count = 0;
+				for (int y = std::max(by0, static_cast<int>(_y) - 1); y <= std::min(by1 - 1, static_cast<int>(_y) + 1); ++y)
+					for (int x = std::max(bx0, static_cast<int>(_x) - 1); x <= std::min(bx1 - 1, static_cast<int>(_x) + 1); ++x, ++count)
+						sum += before[static_cast<size_t>(y - by0) * (bx1 - bx0) + (x - bx0)];
+				h += (sum / count - h) * std::min(1.f, _brush.strength * weight);
+			}
+			break;
+		}
+		return static_cast<ushort>(std::clamp(h + 0.5f, 0.f, 65535.f));
+	});
+}
+
+uint HeightMap::getWidth() {
+	return width;
+}
+
+uint HeightMap::getHeight() {
+	return height;
+}
+
+uint HeightMap::dirtyTiles() {
+	return pending[0] + pending[1];
 }
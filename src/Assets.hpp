@@ -1,6 +1,11 @@
 #pragma once
 
 #include "MainStruct.hpp"
+#include "FileSystem.hpp"
+#include "MipChain.hpp"
+#include "StringId.hpp"
+#include "UploadRing.hpp"
+#include "Atlas.hpp"
 
 namespace Heerbann {
 
@@ -12,6 +17,57 @@ namespace Heerbann {
 		shadowMap, framebuffer, ssbo, heightmap
 	};
 
+	enum LoadState {
+		queued, //waiting for a free slot in the pipeline
+		loading, //disk io on a worker
+		decoding, //cpu side processing on a worker
+		uploading, //glLoad on the main thread
+		ready,
+		failed,
+		cancelled,
+		evicted //unloaded to stay within a budget, AssetManager::acquire loads it again
+	};
+
+	//shared state of one ressource load, handed out to whoever waits on it
+	class LoadRequest : public std::enable_shared_from_this<LoadRequest> {
+
+		friend AssetManager;
+
+		//held while a stage runs. AssetManager::unload takes it to detach the ressource, so every stage
+		//checks res before touching it
+		std::mutex stageLock;
+		//nullptr once the ressource is being destroyed
+		Ressource* res;
+		std::atomic<LoadState> state = LoadState::queued;
+		std::atomic<bool> cancelRequested = false;
+		std::atomic<int> priority = 0;
+		//set before state becomes failed
+		std::string error;
+
+		//moves into a final state, only the first call counts. frees the pipeline slot of a dispatched load
+		void finish(LoadState);
+		//ready -> evicted, false if the load is in any other state
+		bool evict();
+		void fail(const std::string&);
+
+	public:
+		LoadRequest(Ressource*);
+
+		LoadState getState();
+		//ready, failed, cancelled or evicted
+		bool done();
+		//the load stops before its next stage, a running stage completes first
+		void cancel();
+		//higher loads first, only has an effect while queued
+		void setPriority(int);
+		int getPriority();
+		const std::string& getError();
+		//main thread only. helps the pipeline until the load is done
+		LoadState wait();
+	};
+
+	typedef std::shared_ptr<LoadRequest> LoadHandle;
+
 	struct Ressource {
 
 		friend AssetManager;
@@ -19,59 +75,385 @@ namespace Heerbann {
 	protected:
 		std::atomic<bool> isLoaded = false;
 
-		uint dataSize;
-		void* data;
+		uint dataSize = 0;
+		void* data = nullptr;
+
+		LoadHandle request;
 
+		//residency, see AssetManager::setBudget
+		std::atomic<uint> refs = 0;
+		//set by the first retain. only these are evicted, plain pointer holders never ask for a reload
+		std::atomic<bool> managed = false;
+		std::atomic<unsigned long long> lastUse = 0;
+		//glCost of the last upload
+		unsigned long long gpuBytes = 0;
+
+		//io, runs on a worker
 		virtual void load() {};
+		//cpu side processing of what load read, runs on a worker after load
+		virtual void decode() {};
 		virtual void unload() {};
 		virtual bool glLoad(void*) { return true; };
 		virtual bool glUnload(void*) { return true; };
+		//replaces glLoad when there is no gl context (headless), the cpu side data stays resident
+		virtual bool headlessLoad() { isLoaded = true; return true; };
+		//estimated upload cost of glLoad, valid after load
+		virtual GLCost glCost() { return GLCost(); };
+		//bytes kept on the cpu while ready, counted against the cpu budget of the type
+		virtual unsigned long long cpuSize() { return 0; };
+		//true if unload & glUnload leave the ressource in a state it can be loaded again from.
+		//only those are evicted
+		virtual bool reloadable() { return false; };
+
+		bool destroyed = false;
+		//detaches the load and runs unload & glUnload. the virtual calls don't reach the derived class
+		//from ~Ressource anymore, so every final ressource type calls this first in its destructor
+		void destroy();
 
 	public:
 
 		const Type type;
 		const std::string id;
+		//interned id, the key in AssetManager
+		const StringId key;
 
 		Ressource(std::string, Type);
-		~Ressource();
+		virtual ~Ressource();
 
 		bool inline loaded() {
 			return isLoaded;
 		}
+
+		LoadHandle getHandle();
+
+		//reference counting, prefer AssetRef. the last release stamps the ressource for the lru
+		void retain();
+		void release();
+		uint getRefs();
+		//marks the ressource as used this frame, for users that hold plain pointers
+		void touch();
+	};
+
+	//counted reference to a ressource. a referenced ressource is never evicted
+	template<class T>
+	class AssetRef {
+		T* res = nullptr;
+
+	public:
+		AssetRef() = default;
+		explicit AssetRef(T* _res) : res(_res) {
+			if (res != nullptr) res->retain();
+		};
+		AssetRef(const AssetRef& _other) : AssetRef(_other.res) {};
+		AssetRef(AssetRef&& _other) noexcept : res(_other.res) {
+			_other.res = nullptr;
+		};
+		~AssetRef() {
+			reset();
+		};
+
+		AssetRef& operator=(AssetRef _other) {
+			std::swap(res, _other.res);
+			return *this;
+		};
+
+		void reset() {
+			if (res != nullptr) res->release();
+			res = nullptr;
+		};
+
+		inline T* get() const {
+			return res;
+		};
+
+		inline T* operator->() const {
+			return res;
+		};
+
+		inline explicit operator bool() const {
+			return res != nullptr;
+		};
+	};
+
+	//0 is unlimited
+	struct AssetBudget {
+		unsigned long long cpu = 0;
+		unsigned long long gpu = 0;
+	};
+
+	struct Residency {
+		//ready ressources, the ones with references left and their bytes
+		uint count = 0;
+		uint referenced = 0;
+		unsigned long long cpu = 0;
+		unsigned long long gpu = 0;
+		//ressources evicted since the start
+		uint evictions = 0;
+	};
+
+	//---------------------- ShaderPreprocessor ----------------------\\
+
+	/*
+	runs on the sources of every stage before they reach the driver:
+	- #include "file" is resolved relative to the including file, every file is pulled in at most once per stage
+	- the define set is injected right after #version
+	- every file gets a #line source number, translate maps the numbers in a compiler log back to the file names
+	line based, an #include inside a block comment is still resolved
+	*/
+	class ShaderPreprocessor {
+		//source numbers of the #line directives, shared by all stages of a program
+		std::vector<std::string> files;
+		//files of the current stage
+		std::vector<uint> included;
+
+		uint fileIndex(const std::string&);
+		//path, data, size, source number, line of the first byte, out
+		void expand(const std::string&, const char*, size_t, uint, uint, std::string&);
+
+	public:
+		//path of the source (used to resolve includes), source, defines ("NAME" or "NAME=VALUE"), out.
+		//throws if an include can't be opened
+		void process(const std::string&, const std::string&, const std::vector<std::string>&, std::string&);
+		//rewrites "0(12)" (nvidia) and "0:12" (amd, intel) source references to "file(12)"
+		std::string translate(const std::string&) const;
+		const std::vector<std::string>& getFiles() const;
+	};
+
+	//---------------------- ShaderCache ----------------------\\
+
+	#define SHADER_CACHE_VERSION 1
+
+	struct ShaderBinaryHeader {
+		char magic[4];
+		uint version;
+		unsigned long long sourceHash;
+		//renderer & driver version the binary was built by
+		unsigned long long driverHash;
+		uint format;
+		uint size;
+	};
+
+	//persistent cache of linked programs (glGetProgramBinary), keyed by the hash of all stage sources and defines.
+	//a binary the driver rejects (driver update, other gpu) is dropped and the program is compiled from source
+	class ShaderCache {
+		std::string directory;
+		unsigned long long driverHash = 0;
+		bool enabled = false;
+		std::atomic<uint> hits = 0, misses = 0;
+
+		std::string path(unsigned long long);
+
+	public:
+		//main thread, needs the gl context. an empty directory or a driver without binary formats disables the cache
+		void initialize(const std::string&);
+		bool isEnabled();
+
+		//sources in stage order followed by the defines
+		static unsigned long long hash(std::initializer_list<const std::string*>);
+
+		//any thread. false if there is no matching binary
+		bool read(unsigned long long, GLenum&, std::vector<char>&);
+		//main thread. creates a program from the binary, 0 if the driver rejects it
+		GLuint restore(unsigned long long, GLenum, const std::vector<char>&);
+		//main thread. fetches the binary of a linked program, the file is written on a worker
+		void store(unsigned long long, GLuint);
+		//counts a program that had to be compiled from source
+		void miss();
+
+		uint getHits();
+		uint getMisses();
 	};
 
 	class AssetManager {
 
 		friend Ressource;
+		friend LoadRequest;
+
+		FlatMap<StringId, Ressource*> assets;
+
+		struct Pending {
+			int priority;
+			unsigned long long order;
+			LoadHandle request;
+			//highest priority first, fifo within a priority
+			inline bool operator<(const Pending& _other) const {
+				return priority != _other.priority ? priority < _other.priority : order > _other.order;
+			};
+		};
+
+		//ressources constructed since the last update, see loadFromDisk
+		std::mutex scheduleLock;
+		std::vector<Ressource*> toSchedule;
+		//may hold stale entries after a priority change, they are skipped when popped
+		std::priority_queue<Pending> queue;
+		unsigned long long nextOrder = 0;
+
+		std::atomic<uint> inFlight = 0;
+		uint maxInFlight = 8;
 
-		std::unordered_map<std::string, Ressource*> assets;
+		//searched back to front
+		std::mutex archiveLock;
+		std::vector<PackArchive*> archives;
+
+		ShaderCache shaderCache;
+
+		//per type, the lru clock ticks once per update
+		std::unordered_map<Type, AssetBudget> budgets;
+		std::unordered_map<Type, uint> evictions;
+		std::atomic<unsigned long long> clock = 1;
 
 		void loadFromDisk(std::string, Ressource*);
 		void unload(Ressource*);
+		//evicts the least recently used unreferenced ressources of every type over its budget.
+		//main thread, the victims are unloaded after scheduleLock is released
+		void enforceBudgets();
+		//the request was moved to evicted already, unloads the ressource if it still exists
+		void evict(const LoadHandle&);
+		void reload(Ressource*);
+		void enqueue(const LoadHandle&);
+		void dispatch(const LoadHandle&);
+		//runs one stage of a load, an exception fails the request and unloads what the stages got to.
+		//stageLock held
+		static bool runStage(LoadRequest*, const std::function<bool()>&);
 
 	public:
 
+		//enforces the budgets and dispatches queued loads by priority until the pipeline is full
+		void update();
+		//blocks until every queued ressource finished loading. main thread only
+		void finish();
+
+		void setMaxInFlight(uint);
+		uint queued();
+		uint loading();
+
+		//false if the archive is missing or invalid
+		bool mount(const std::string&);
+		//no new lookups reach the archive. it's deleted once the last AssetFile reading from it closed
+		void unmount(const std::string&);
+		//looks the asset up in the mounted archives, see AssetFile for reading it.
+		//the archive stays alive until the reference is given back through release
+		bool find(const std::string&, PackArchive*&, const PackEntry*&);
+		void release(PackArchive*);
+
+		ShaderCache* getShaderCache();
+
+		//cpu and gpu bytes the ready ressources of a type may occupy, checked every update.
+		//going over evicts the least recently used ressources that are reloadable and unreferenced.
+		//ressources never handed out through acquire or an AssetRef are never evicted
+		void setBudget(Type, unsigned long long, unsigned long long);
+		AssetBudget getBudget(Type);
+		Residency getResidency(Type);
+		//all types together
+		Residency getResidency();
+		bool isResident(StringId);
+		unsigned long long getClock();
+
+		//T is the ressource pointer type, nullptr if the id doesn't exist
+		template<class T>
+		T get(StringId);
+
+		//counted reference, T is the ressource class. an evicted ressource is queued again unless _reload is false.
+		//empty if the id doesn't exist
 		template<class T>
-		T get(std::string);
+		AssetRef<T> acquire(StringId, bool = true);
 
-		bool exists(std::string);
+		bool exists(StringId);
 	};
 
 	template<class T>
-	inline T AssetManager::get(std::string _id) {
-		if (!exists(_id)) return nullptr;
-		return reinterpret_cast<T>(assets[_id]);
+	inline T AssetManager::get(StringId _id) {
+		//ressources register from workers too
+		std::lock_guard<std::mutex> guard(scheduleLock);
+		return reinterpret_cast<T>(assets.get(_id));
+	}
+
+	template<class T>
+	inline AssetRef<T> AssetManager::acquire(StringId _id, bool _reload) {
+		//under the lock so the ressource can't be evicted between the lookup and the retain
+		std::lock_guard<std::mutex> guard(scheduleLock);
+		auto it = assets.find(_id);
+		if (it == assets.end()) return AssetRef<T>();
+		if (_reload) reload(it->second);
+		it->second->lastUse = clock;
+		return AssetRef<T>(reinterpret_cast<T*>(it->second));
 	}
 
 	class Image : public Ressource {
-		sf::Image* image;
+		sf::Image* image = nullptr;
+		AssetFile file;
+		MipContent mipContent;
+		MipChain mips;
 	public:
-		Image(std::string);
+		//with a MipContent other than none the chain is built on the decoding worker
+		Image(std::string, MipContent = MipContent::none);
+		~Image();
 		void load() override;
+		void decode() override;
 		void unload() override;
+		unsigned long long cpuSize() override;
+		bool reloadable() override;
 		sf::Image* get();
+		MipChain* getMips();
 		void finish();
-		static Image* get(std::string);
+		static Image* get(StringId);
+	};
+
+	//---------------------- ImageBatch ----------------------\\
+
+	//one image of an ImageBatch. dst receives the rgba8 texels, followed by the mip levels if mips isn't none
+	struct BatchImage {
+		std::string file;
+		unsigned char* dst = nullptr;
+		//bytes behind dst, see ImageBatch::bytes
+		size_t capacity = 0;
+		//expected size, 0 takes any size that fits. the decoded size after the batch ran
+		Vec2u size;
+		MipContent mips = MipContent::none;
+
+		//filled in by the batch
+		bool ok = false;
+		std::string error;
+		//ms spent reading the file & decoding it (mip chain included)
+		float readMs = 0.f;
+		float decodeMs = 0.f;
+	};
+
+	//decodes a list of images in parallel, one job per image spread over the JobScheduler workers, into
+	//memory the caller owns (a slice of an UploadRing slot, a buffer of its own). no ressources are created
+	//and nothing stays resident. the batch & the destinations have to outlive the jobs
+	class ImageBatch {
+		std::vector<BatchImage> images;
+		JobHandle job;
+		std::chrono::steady_clock::time_point start;
+		float wall = 0.f;
+
+		static void decode(BatchImage&);
+
+	public:
+		//file, destination, capacity, expected size, mips. returns the index of the image
+		uint add(const std::string&, unsigned char*, size_t, Vec2u = Vec2u(), MipContent = MipContent::none);
+		//any thread. starts the decodes, the returned job finishes after the last one
+		JobHandle submit();
+		//submits if that didn't happen yet & helps out until every image is done. false if any failed
+		bool run();
+		bool finished();
+
+		uint size();
+		BatchImage& get(uint);
+		//first failed image or nullptr
+		BatchImage* failed();
+		//ms from submit to the last image
+		float wallMs();
+		//read & decode ms summed over all images, over wallMs it's the speedup against decoding one by one
+		float decodeMs();
+		//a summary & one line per image
+		void log(const std::string&);
+
+		//bytes of a decoded image of _size with _mips
+		static size_t bytes(Vec2u, MipContent);
+		//width & height from the header without decoding, false if the data isn't a png
+		static bool peekSize(const char*, size_t, Vec2u&);
 	};
 
 	class Texture2D : public Ressource {
@@ -82,21 +464,34 @@ namespace Heerbann {
 		GLenum target, format, type;
 		GLint level, internalFormat;
 		Vec2u bounds;
+		AssetFile file;
+		MipContent mipContent;
+		MipChain mips;
+		//texels copied into the UploadRing by decode, every level back to back
+		UploadSlot staging;
+		uint stagedLevels = 0;
+		void stage();
 	protected:
 		void load() override;
+		void decode() override;
+		void unload() override;
 		bool glLoad(void*) override;
 		bool glUnload(void*) override;
+		GLCost glCost() override;
+		bool reloadable() override;
 	public:
 		//https://www.khronos.org/opengl/wiki/GLAPI/glTexImage2D
-		//target, level, internalFormat, format, type
-		Texture2D(std::string, GLuint, GLint, GLint, GLenum, GLenum);
+		//target, level, internalFormat, format, type, mips
+		//with a MipContent other than none the full chain is built while decoding and uploaded as rgba8
+		Texture2D(std::string, GLuint, GLint, GLint, GLenum, GLenum, MipContent = MipContent::none);
+		~Texture2D();
 		GLuint get();
 		void bind(GLuint);
 		void setWrap(GLint, GLint);
 		void setFilter(GLint, GLint);
 		void setParai(GLenum, GLint);
 		void setParaf(GLenum, GLfloat);
-		static Texture2D* get(std::string);
+		static Texture2D* get(StringId);
 	};
 
 	class Array2DTexture : public Ressource {
@@ -107,14 +502,33 @@ namespace Heerbann {
 		GLenum target, format, type;
 		GLint levels, level, internalFormat;
 		Vec2u bounds;
+		//.rtex layers are mapped and uploaded block compressed, anything else goes through Image
+		bool compressed = false;
+		CookedTexture* cooked = nullptr;
+		size_t cookedBytes = 0;
+		MipContent mipContent;
+		//every layer & level back to back in the UploadRing. cooked layers are copied in by decode,
+		//png layers are decoded into it by an ImageBatch
+		UploadSlot staging;
+		//the decoded png layers when the ring had no room
+		std::vector<unsigned char> pixels;
+		//bytes of one layer with all its levels
+		size_t layerBytes();
 	protected:
 		void load() override;
+		void decode() override;
+		void unload() override;
 		bool glLoad(void*) override;
 		bool glUnload(void*) override;
+		GLCost glCost() override;
+		bool reloadable() override;
 	public:
 		// https://www.khronos.org/opengl/wiki/GLAPI/glTexStorage3D
 		//id, files, levels, target, level, internalFormat, format, type
-		Array2DTexture(std::string, std::vector<std::string>, GLuint, GLuint, GLint, GLint, GLenum, GLenum);
+		//cooked layers bring their own format & mip chain, levels, internalFormat, format and type are ignored.
+		//png layers with a MipContent other than none get a full chain, built while decoding, levels is ignored too
+		Array2DTexture(std::string, std::vector<std::string>, GLuint, GLuint, GLint, GLint, GLenum, GLenum, MipContent = MipContent::none);
+		~Array2DTexture();
 		GLuint get();
 		void bind(GLuint);
 		void setWrap(GLint, GLint);
@@ -126,10 +540,14 @@ namespace Heerbann {
 	struct AtlasRegion {
 		friend TextureDebugRenderer;
 
-		TextureAtlas* parent;
-		sf::Sprite* sprite;
+		TextureAtlas* parent = nullptr;
+		sf::Sprite* sprite = nullptr;
+		//page of a DynamicAtlas
 		int texIndex = -1;
-		int x, y, width, height;
+		int x = 0, y = 0, width = 0, height = 0;
+		//texture & normalized coordinates, set once the region is packed. 0 until then
+		GLuint texture = 0;
+		Vec2 u, v;
 
 		sf::Sprite* createSprite();
 		Vec2 getU();
@@ -139,16 +557,31 @@ namespace Heerbann {
 	class TextureAtlas : public Ressource {
 		friend TextureDebugRenderer;
 
-		std::unordered_map<std::string, Texture2D*> textures;
-		std::unordered_map<std::string, AtlasRegion*> regions;
+		//_id.ratlas if it was cooked, _id.atlas otherwise
+		CookedAtlas table;
+		//one per page, in page order
+		std::vector<AssetRef<Texture2D>> pages;
+		//regions handed out by getRegion, built on first use
+		FlatMap<StringId, AtlasRegion*> regions;
 	protected:
 		void load() override;
 		bool glLoad(void*) override;
 		bool glUnload(void*) override;
 	public:
 		TextureAtlas(std::string);
-		AtlasRegion* getRegion(std::string);
-		static TextureAtlas* get(std::string);
+		~TextureAtlas();
+		//throws if the region doesn't exist. the region lives as long as the atlas
+		AtlasRegion* getRegion(StringId);
+		//index into the table or -1, no allocation. the first frame if the name has several
+		int find(StringId);
+		//frame _frame (the libgdx index) of an animation, -1 if there is none
+		int find(StringId, int);
+		uint regionCount();
+		//fills _out with region _index of the table, no allocation
+		void region(uint, AtlasRegion&);
+		Texture2D* page(uint);
+		uint pageCount();
+		static TextureAtlas* get(StringId);
 	};
 
 	class SSBO : public Ressource {
@@ -159,6 +592,7 @@ namespace Heerbann {
 	protected:		
 		bool glLoad(void*) override;
 		bool glUnload(void*) override;
+		GLCost glCost() override;
 	public:
 		/*
 		https://www.khronos.org/opengl/wiki/GLAPI/glBufferStorage
@@ -166,6 +600,7 @@ namespace Heerbann {
 		GL_MAP_COHERENT_BIT, GL_CLIENT_STORAGE_BIT
 		*/
 		SSBO(std::string, uint, void*, GLbitfield);
+		~SSBO();
 		void bind(uint);
 		void bindAs(uint, uint);
 		void unbind();
@@ -179,7 +614,7 @@ namespace Heerbann {
 		*/
 		void* map(uint, uint, GLbitfield);
 		void unmap();		
-		static SSBO* get(std::string);
+		static SSBO* get(StringId);
 
 		template<class T>
 		T inline getPtr() {
@@ -198,10 +633,14 @@ namespace Heerbann {
 		bool glUnload(void*) override;
 	public:
 		FlipFlopSSBO(std::string, bool, uint, uint, GLbitfield, GLbitfield);
+		~FlipFlopSSBO();
 		void flip();
 		void bind(uint);
 		void bindAs(uint, uint);
 		void unbind();
+		//the buffer bind & getPtr refer to
+		uint getIndex();
+		uint getCount();
 		template<class T>
 		T inline getPtr() {
 			return reinterpret_cast<T>(pointers[index]);
@@ -209,21 +648,30 @@ namespace Heerbann {
 	};
 
 	class Model : public Ressource {
-		ModelData* model;
+		ModelData* model = nullptr;
 		bool modelDataLoaded = false;
+		//the cooked file the vertex & index caches point into, if it was up to date
+		MappedFile cooked;
+		void import(AssetFile&);
 	protected:
 		void load() override;
+		//drops the vertex & index caches, the ModelData lives as long as the model
+		void unload() override;
 		bool glLoad(void*) override;
 		bool glUnload(void*) override;
+		GLCost glCost() override;
 	public:
 		Model(std::string);
+		~Model();
 		ModelData* getData();
+		//draw of mesh _index with its dequantization bounds
+		DrawCall getDrawCall(uint);
 		Texture2D* texture;
 		Mat4 transform = IDENTITY;
 		Vec3 position;
 		void bindTransform(uint);
 		void bindinvTransform(uint);
-		static Model* get(std::string);
+		static Model* get(StringId);
 	};
 
 	class ShaderProgram : public Ressource {
@@ -231,20 +679,44 @@ namespace Heerbann {
 			success, failed, missing
 		};
 		GLuint program = -1, compute = -1, vertex = -1, geom = -1, frag = -1;
+		//path of the sources without extension, the id carries the define set too
+		const std::string path;
+		//sorted & unique
+		const std::vector<std::string> defines;
+		//handed from load to glLoad
+		struct Sources {
+			std::string comp, vert, geom, frag;
+			ShaderPreprocessor lines;
+			unsigned long long hash = 0;
+			GLenum binaryFormat = 0;
+			std::vector<char> binary;
+		};
+		static std::vector<std::string> normalize(std::vector<std::string>);
+		static std::string variantId(const std::string&, const std::vector<std::string>&);
 		void print(std::string, Status, Status, Status, Status, Status, std::string);
-		bool compile(const std::string&, const char*, const char*, const char*, const char*);
+		bool compile(const std::string&, const char*, const char*, const char*, const char*, const ShaderPreprocessor* = nullptr);
+		//tries the binary cache first, compiles & stores the binary on a miss
+		bool build(const std::string&, Sources&);
 		bool loadFromMemory(const std::string&, const std::string&, const std::string&, const std::string&, const std::string&);
 	protected:
 		void load() override;
 		bool glLoad(void*) override;
 		bool glUnload(void*) override;
+		GLCost glCost() override;
 	public:
-		ShaderProgram(std::string);
+		//path without extension, defines ("NAME" or "NAME=VALUE"). prefer variant, it doesn't create a define set twice
+		ShaderProgram(std::string, std::vector<std::string> = {});
+		~ShaderProgram();
 		bool printDebug = true;
 		GLuint getHandle();		
 		void bind();
 		void unbind();
-		static ShaderProgram* get(std::string);
+		const std::string& getPath();
+		const std::vector<std::string>& getDefines();
+		static ShaderProgram* get(StringId);
+		//permutation registry: the program of _path compiled with the define set, created and queued on the first request.
+		//the order of the defines doesn't matter, every set is compiled once and its binary cached by the hash of the set
+		static ShaderProgram* variant(const std::string&, std::vector<std::string> = {});
 	};
 
 	class Framebuffer : public Ressource {
@@ -256,10 +728,11 @@ namespace Heerbann {
 	public:
 		Vec2u bounds;
 		Framebuffer(std::string, std::unordered_map<std::string, Texture2D*>);
+		~Framebuffer();
 		void bind();
 		void unbind();
 		Texture2D* getTex(std::string);
-		static Framebuffer* get(std::string);
+		static Framebuffer* get(StringId);
 	};
 
 	class ShadowMap : public Ressource {
@@ -269,39 +742,109 @@ namespace Heerbann {
 		bool glUnload(void*) override;
 	public:
 		ShadowMap(std::string, Framebuffer*, std::string, std::string);
+		~ShadowMap();
 		void bind();
 		void unbind();
 		Vec2u getBounds();
 		Texture2D* getTex();
 		Texture2D* getDepth();
-		static ShadowMap* get(std::string);
+		static ShadowMap* get(StringId);
 	};
 
 	class Font : public Ressource {
-		sf::Font* font;
+		sf::Font* font = nullptr;
+		//sf::Font reads from the buffer for its whole lifetime, so the mapping stays open
+		AssetFile file;
 
 	protected:
+		void load() override;
+		void decode() override;
+		void unload() override;
 		bool glLoad(void*) override;
 		bool glUnload(void*) override;
+		unsigned long long cpuSize() override;
+		bool reloadable() override;
 
 	public:
 		Font(std::string);
-		static Font* get(std::string);
+		~Font();
+		static Font* get(StringId);
+	};
+
+	enum class BrushMode : uint {
+		raise, //adds strength at the centre
+		lower, //subtracts strength at the centre
+		flatten, //pulls towards target, strength in [0, 1]
+		smooth //pulls towards the 3x3 average, strength in [0, 1]
+	};
+
+	struct HeightBrush {
+		BrushMode mode = BrushMode::raise;
+		//in texels
+		float radius = 8.f;
+		float strength = 64.f;
+		ushort target = 0;
 	};
 
+	//row major ushort heights. edits go into a cpu copy and mark TILE x TILE tiles dirty once per flip buffer,
+	//the per frame job flips to the other buffer and copies only its dirty tiles into the mapping, merging
+	//neighbouring tiles of a tile row into one span. that buffer was read by the draws of an earlier frame,
+	//so the job skips the frame until the fence unbind placed behind those draws signaled. edits & the job
+	//run on the main thread
 	class HeightMap : public Ressource {
-		FlipFlopSSBO* buffer;
-		std::forward_list<std::tuple<bool, uint, ushort>*> changeList;
+		static const uint TILE = 32;
+		FlipFlopSSBO* buffer = nullptr;
 		uint width, height;
+		uint tilesX, tilesY, rowWords;
+		std::vector<ushort> heights;
+		//a bit per tile and flip buffer, rowWords words per tile row
+		std::vector<unsigned long long> dirty[2];
+		uint pending[2] = {};
+		//behind the last draws reading each buffer
+		GLsync fences[2] = {};
+
+		void markDirty(uint, uint, uint, uint);
+		//copies the dirty tiles of the buffer into its mapping
+		void upload(uint, ushort*);
 	protected:
 		HeightMap(std::string, uint, uint);
 		void load() override;
 		bool glLoad(void*) override;
 		bool glUnload(void*) override;
 	public:
+		~HeightMap();
 		void bind(uint);
+		//call after the draws reading the map, fences the bound buffer
 		void unbind();
+
+		ushort get(uint, uint);
 		void changeEntry(uint, uint, ushort);
+		//x, y, width, height, row major source of width * height values
+		void setRegion(uint, uint, uint, uint, const ushort*);
+		void fill(uint, uint, uint, uint, ushort);
+		//centre in texels
+		void brush(const Vec2&, const HeightBrush&);
+		//calls _func(x, y, height) -> new height for every texel of the rect, clipped to the map
+		template<class F>
+		void apply(uint, uint, uint, uint, F&&);
+
+		uint getWidth();
+		uint getHeight();
+		//tiles still waiting for an upload, summed over both buffers
+		uint dirtyTiles();
 	};
 
+	template<class F>
+	inline void HeightMap::apply(uint _x, uint _y, uint _width, uint _height, F&& _func) {
+		if (_x >= width || _y >= height) return;
+		const uint x1 = std::min(width, _x + _width), y1 = std::min(height, _y + _height);
+		if (x1 == _x || y1 == _y) return;
+		for (uint y = _y; y < y1; ++y) {
+			ushort* row = heights.data() + static_cast<size_t>(y) * width;
+			for (uint x = _x; x < x1; ++x)
+				row[x] = _func(x, y, row[x]);
+		}
+		markDirty(_x, _y, x1, y1);
+	}
+
 }
@@ -0,0 +1,479 @@
+#include "Atlas.hpp"
+#include "Assets.hpp"
+
+#include <fstream>
+
+using namespace Heerbann;
+
+//---------------------- SkylinePacker ----------------------\\
+
+SkylinePacker::SkylinePacker(uint _width, uint _height) : width(_width), height(_height) {
+	clear();
+}
+
+bool SkylinePacker::fit(size_t _index, uint _width, uint _height, uint& _y) {
+	if (skyline[_index].x + _width > width) return false;
+	uint left = _width;
+	_y = skyline[_index].y;
+	for (size_t i = _index; left > 0; ++i) {
+		_y = std::max(_y, skyline[i].y);
+		if (_y + _height > height) return false;
+		left -= std::min(left, skyline[i].width);
+	}
+	return true;
+}
+
+bool SkylinePacker::insert(uint _width, uint _height, Vec2u& _pos) {
+	if (_width == 0 || _height == 0) return false;
+	size_t best = skyline.size();
+	uint bestTop = std::numeric_limits<uint>::max(), bestWidth = std::numeric_limits<uint>::max(), bestY = 0;
+	for (size_t i = 0; i < skyline.size(); ++i) {
+		uint y;
+		if (!fit(i, _width, _height, y)) continue;
+		if (y + _height < bestTop || (y + _height == bestTop && skyline[i].width < bestWidth)) {
+			best = i;
+			bestTop = y + _height;
+			bestWidth = skyline[i].width;
+			bestY = y;
+		}
+	}
+	if (best == skyline.size()) return false;
+
+	_pos = Vec2u(skyline[best].x, bestY);
+	skyline.insert(skyline.begin() + best, Node{ _pos.x, bestTop, _width });
+	//cut the nodes now hidden under the new one
+	for (size_t i = best + 1; i < skyline.size();) {
+		const uint edge = skyline[i - 1].x + skyline[i - 1].width;
+		if (skyline[i].x >= edge) break;
+		const uint shrink = edge - skyline[i].x;
+		if (skyline[i].width <= shrink) {
+			skyline.erase(skyline.begin() + i);
+			continue;
+		}
+		skyline[i].x += shrink;
+		skyline[i].width -= shrink;
+		break;
+	}
+	//merge neighbours of the same height
+	for (size_t i = 0; i + 1 < skyline.size();) {
+		if (skyline[i].y == skyline[i + 1].y) {
+			skyline[i].width += skyline[i + 1].width;
+			skyline.erase(skyline.begin() + i + 1);
+		} else ++i;
+	}
+	area += static_cast<unsigned long long>(_width) * _height;
+	return true;
+}
+
+void SkylinePacker::clear() {
+	skyline.assign(1, Node{ 0, 0, width });
+	area = 0;
+}
+
+uint SkylinePacker::getWidth() {
+	return width;
+}
+
+uint SkylinePacker::getHeight() {
+	return height;
+}
+
+float SkylinePacker::occupancy() {
+	return static_cast<float>(static_cast<double>(area) / (static_cast<double>(width) * height));
+}
+
+//---------------------- DynamicAtlas ----------------------\\
+
+DynamicAtlas::DynamicAtlas(uint _pageSize, uint _padding) : pageSize(_pageSize), padding(_padding) {}
+
+DynamicAtlas::~DynamicAtlas() {
+	*alive = false;
+	for (auto& p : pages)
+		glDeleteTextures(1, &p.handle);
+	for (auto& r : regions)
+		delete r.second;
+}
+
+uint DynamicAtlas::addPage() {
+	GLuint handle;
+	glGenTextures(1, &handle);
+	glBindTexture(GL_TEXTURE_2D, handle);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, pageSize, pageSize);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	//the gaps between regions stay transparent
+	glClearTexImage(handle, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	GLError("DynamicAtlas::addPage");
+	pages.push_back({ handle, SkylinePacker(pageSize, pageSize) });
+	return static_cast<uint>(pages.size() - 1);
+}
+
+void DynamicAtlas::place(AtlasRegion* _region, const unsigned char* _rgba, uint _width, uint _height) {
+	const uint w = _width + 2 * padding, h = _height + 2 * padding;
+	Vec2u pos;
+	uint index = 0;
+	while (index < pages.size() && !pages[index].packer.insert(w, h, pos)) ++index;
+	if (index == pages.size()) {
+		index = addPage();
+		pages[index].packer.insert(w, h, pos);
+	}
+
+	//extrude the border into the padding
+	scratch.resize(static_cast<size_t>(w) * h * 4);
+	for (uint y = 0; y < h; ++y) {
+		const uint sy = static_cast<uint>(std::clamp(static_cast<int>(y) - static_cast<int>(padding), 0, static_cast<int>(_height) - 1));
+		const unsigned char* row = _rgba + static_cast<size_t>(sy) * _width * 4;
+		unsigned char* out = scratch.data() + static_cast<size_t>(y) * w * 4;
+		for (uint x = 0; x < w; ++x) {
+			const uint sx = static_cast<uint>(std::clamp(static_cast<int>(x) - static_cast<int>(padding), 0, static_cast<int>(_width) - 1));
+			std::memcpy(out + x * 4, row + sx * 4, 4);
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D, pages[index].handle);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, pos.x, pos.y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, scratch.data());
+	glBindTexture(GL_TEXTURE_2D, 0);
+	GLError("DynamicAtlas::place");
+
+	const float texel = 1.f / pageSize;
+	_region->texIndex = static_cast<int>(index);
+	_region->x = static_cast<int>(pos.x + padding);
+	_region->y = static_cast<int>(pos.y + padding);
+	_region->width = static_cast<int>(_width);
+	_region->height = static_cast<int>(_height);
+	_region->u = Vec2(_region->x * texel, (_region->x + _region->width) * texel);
+	_region->v = Vec2(_region->y * texel, (_region->y + _region->height) * texel);
+	_region->texture = pages[index].handle;
+}
+
+AtlasRegion* DynamicAtlas::add(const std::string& _id, const unsigned char* _rgba, uint _width, uint _height) {
+	StringId key = StringId::intern(_id);
+	if (AtlasRegion* existing = regions.get(key)) return existing;
+	if (_width + 2 * padding > pageSize || _height + 2 * padding > pageSize) {
+		LOG("[" + _id + "] is too large for an atlas page of " + std::to_string(pageSize));
+		return nullptr;
+	}
+	AtlasRegion* region = new AtlasRegion();
+	place(region, _rgba, _width, _height);
+	regions[key] = region;
+	return region;
+}
+
+AtlasRegion* DynamicAtlas::add(const std::string& _id, const sf::Image& _image) {
+	return add(_id, _image.getPixelsPtr(), _image.getSize().x, _image.getSize().y);
+}
+
+AtlasRegion* DynamicAtlas::load(const std::string& _file) {
+	StringId key = StringId::intern(_file);
+	if (AtlasRegion* existing = regions.get(key)) return existing;
+	AtlasRegion* region = new AtlasRegion();
+	regions[key] = region;
+
+	AssetRef<Image> image = M_Asset->acquire<Image>(_file);
+	if (!image) image = AssetRef<Image>(new Image(_file));
+	std::shared_ptr<bool> atlasAlive = alive;
+	M_Jobs->addFrameJob([this, atlasAlive, region, image, _file]()->bool {
+		if (!*atlasAlive) return true;
+		LoadHandle handle = image->getHandle();
+		if (handle->getState() == LoadState::failed || handle->getState() == LoadState::cancelled) {
+			LOG("atlas image [" + _file + "] failed to load");
+			return true;
+		}
+		if (!handle->done()) return false;
+		const sf::Vector2u size = image->get()->getSize();
+		if (size.x + 2 * padding > pageSize || size.y + 2 * padding > pageSize) {
+			LOG("[" + _file + "] is too large for an atlas page of " + std::to_string(pageSize));
+			return true;
+		}
+		place(region, image->get()->getPixelsPtr(), size.x, size.y);
+		return true;
+	});
+	return region;
+}
+
+AtlasRegion* DynamicAtlas::get(StringId _id) {
+	return regions.get(_id);
+}
+
+uint DynamicAtlas::pageCount() {
+	return static_cast<uint>(pages.size());
+}
+
+GLuint DynamicAtlas::page(uint _index) {
+	return pages[_index].handle;
+}
+
+uint DynamicAtlas::getPageSize() {
+	return pageSize;
+}
+
+//---------------------- CookedAtlas ----------------------\\
+
+int AtlasTable::find(StringId _id) const {
+	const unsigned long long* it = std::lower_bound(names, names + regions, _id.hash());
+	return it != names + regions && *it == _id.hash() ? static_cast<int>(it - names) : -1;
+}
+
+int AtlasTable::find(StringId _id, int _frame) const {
+	int i = find(_id);
+	if (i < 0) return -1;
+	//frames of a name are adjacent & sorted by index
+	for (; static_cast<uint>(i) < regions && names[i] == _id.hash() && index[i] <= _frame; ++i)
+		if (index[i] == _frame) return i;
+	return -1;
+}
+
+const char* AtlasTable::regionName(uint _index) const {
+	return strings + regionNames[_index];
+}
+
+const char* AtlasTable::pageName(uint _index) const {
+	return strings + pageNames[_index];
+}
+
+//byte offsets of the arrays behind the header, shared by bind & parse
+struct AtlasLayout {
+	size_t names, pageWidth, pageHeight, pageNames, regionNames, index, x, y, width, height, page, strings, size;
+
+	AtlasLayout(size_t _pages, size_t _regions, size_t _stringBytes) {
+		names = sizeof(CookedAtlasHeader);
+		pageWidth = names + _regions * sizeof(unsigned long long);
+		pageHeight = pageWidth + _pages * sizeof(uint);
+		pageNames = pageHeight + _pages * sizeof(uint);
+		regionNames = pageNames + _pages * sizeof(uint);
+		index = regionNames + _regions * sizeof(uint);
+		x = index + _regions * sizeof(int);
+		y = x + _regions * sizeof(ushort);
+		width = y + _regions * sizeof(ushort);
+		height = width + _regions * sizeof(ushort);
+		page = height + _regions * sizeof(ushort);
+		strings = page + _regions * sizeof(ushort);
+		size = strings + _stringBytes;
+	}
+};
+
+bool CookedAtlas::bind(const char* _data, size_t _size) {
+	if (_size < sizeof(CookedAtlasHeader)) return false;
+	const CookedAtlasHeader* header = reinterpret_cast<const CookedAtlasHeader*>(_data);
+	if (std::memcmp(header->magic, "RATL", 4) != 0 || header->version != COOKED_ATLAS_VERSION) return false;
+	const AtlasLayout layout(header->pages, header->regions, header->stringBytes);
+	if (layout.size > _size || (header->stringBytes > 0 && _data[layout.strings + header->stringBytes - 1] != '\0')) return false;
+
+	table.pages = header->pages;
+	table.regions = header->regions;
+	table.names = reinterpret_cast<const unsigned long long*>(_data + layout.names);
+	table.pageWidth = reinterpret_cast<const uint*>(_data + layout.pageWidth);
+	table.pageHeight = reinterpret_cast<const uint*>(_data + layout.pageHeight);
+	table.pageNames = reinterpret_cast<const uint*>(_data + layout.pageNames);
+	table.regionNames = reinterpret_cast<const uint*>(_data + layout.regionNames);
+	table.index = reinterpret_cast<const int*>(_data + layout.index);
+	table.x = reinterpret_cast<const ushort*>(_data + layout.x);
+	table.y = reinterpret_cast<const ushort*>(_data + layout.y);
+	table.width = reinterpret_cast<const ushort*>(_data + layout.width);
+	table.height = reinterpret_cast<const ushort*>(_data + layout.height);
+	table.page = reinterpret_cast<const ushort*>(_data + layout.page);
+	table.strings = _data + layout.strings;
+
+	for (uint i = 0; i < table.pages; ++i)
+		if (table.pageNames[i] >= header->stringBytes) return false;
+	for (uint i = 0; i < table.regions; ++i) {
+		if (table.regionNames[i] >= header->stringBytes || table.page[i] >= table.pages) return false;
+		if (i > 0 && (table.names[i - 1] > table.names[i] || (table.names[i - 1] == table.names[i] && table.index[i - 1] >= table.index[i]))) return false;
+	}
+	return true;
+}
+
+bool CookedAtlas::open(const std::string& _path, unsigned long long _sourceHash) {
+	close();
+	if (!file.open(_path)) return false;
+	//cooked by another version, as good as missing
+	const CookedAtlasHeader* header = reinterpret_cast<const CookedAtlasHeader*>(file.data());
+	if (file.size() >= sizeof(CookedAtlasHeader) && std::memcmp(header->magic, "RATL", 4) == 0 && header->version != COOKED_ATLAS_VERSION) {
+		close();
+		return false;
+	}
+	if (!bind(file.data(), file.size())) {
+		close();
+		throw new std::exception((std::string("[") + _path + std::string("] is not a cooked atlas")).data());
+	}
+	if (_sourceHash != 0 && header->sourceHash != _sourceHash) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+//up to _count integers separated by spaces & commas
+inline uint parseInts(const char* _begin, const char* _end, int* _out, uint _count) {
+	uint found = 0;
+	const char* p = _begin;
+	while (p < _end && found < _count) {
+		while (p < _end && (*p == ' ' || *p == '\t' || *p == ',')) ++p;
+		bool negative = p < _end && *p == '-';
+		if (negative) ++p;
+		if (p == _end || *p < '0' || *p > '9') break;
+		int value = 0;
+		for (; p < _end && *p >= '0' && *p <= '9'; ++p)
+			value = value * 10 + (*p - '0');
+		_out[found++] = negative ? -value : value;
+	}
+	return found;
+}
+
+void CookedAtlas::parse(const std::string& _path) {
+	AssetFile text;
+	if (!text.open(_path)) throw new std::exception((std::string("can't open file [") + _path + std::string("]")).data());
+	parse(text.data(), text.size(), _path);
+}
+
+void CookedAtlas::parse(const char* _text, size_t _size, const std::string& _path) {
+	close();
+
+	struct Region {
+		unsigned long long name;
+		uint nameOffset;
+		int index;
+		int x, y, width, height;
+		uint page;
+	};
+	std::string strings;
+	std::vector<uint> pageWidth, pageHeight, pageNames;
+	std::vector<Region> regions;
+
+	//a page starts at the top & after every blank line, its properties come before its first region
+	bool pageStart = true;
+	bool inRegion = false;
+	const char* p = _text;
+	const char* end = p + _size;
+	for (uint lineNr = 1; p < end; ++lineNr) {
+		const char* line = p;
+		while (p < end && *p != '\n') ++p;
+		const char* lineEnd = p;
+		if (p < end) ++p;
+		if (lineEnd > line && lineEnd[-1] == '\r') --lineEnd;
+		while (line < lineEnd && (*line == ' ' || *line == '\t')) ++line;
+		if (line == lineEnd) {
+			pageStart = true;
+			continue;
+		}
+
+		const char* colon = reinterpret_cast<const char*>(std::memchr(line, ':', lineEnd - line));
+		if (colon == nullptr) {
+			const uint offset = static_cast<uint>(strings.size());
+			strings.append(line, lineEnd - line);
+			strings.push_back('\0');
+			if (pageStart) {
+				pageNames.emplace_back(offset);
+				pageWidth.emplace_back(0);
+				pageHeight.emplace_back(0);
+				pageStart = false;
+				inRegion = false;
+			} else {
+				if (pageNames.empty())
+					throw new std::exception((std::string("[") + _path + std::string("] line ") + std::to_string(lineNr) + std::string(": region before the first page")).data());
+				regions.push_back({ StringId(line, lineEnd - line).hash(), offset, -1, 0, 0, 0, 0, static_cast<uint>(pageNames.size() - 1) });
+				inRegion = true;
+			}
+			continue;
+		}
+
+		pageStart = false;
+		const size_t keyLength = colon - line;
+		int values[2];
+		const uint count = parseInts(colon + 1, lineEnd, values, 2);
+		if (keyLength == 4 && std::memcmp(line, "size", 4) == 0 && count == 2) {
+			if (inRegion) {
+				regions.back().width = values[0];
+				regions.back().height = values[1];
+			} else if (!pageNames.empty()) {
+				pageWidth.back() = static_cast<uint>(values[0]);
+				pageHeight.back() = static_cast<uint>(values[1]);
+			}
+		} else if (inRegion && keyLength == 2 && std::memcmp(line, "xy", 2) == 0 && count == 2) {
+			regions.back().x = values[0];
+			regions.back().y = values[1];
+		} else if (inRegion && keyLength == 5 && std::memcmp(line, "index", 5) == 0 && count >= 1)
+			regions.back().index = values[0];
+		//rotate, orig, offset, format, filter & repeat aren't used
+	}
+	for (size_t i = 0; i < pageNames.size(); ++i)
+		if (pageWidth[i] == 0 || pageHeight[i] == 0)
+			throw new std::exception((std::string("[") + _path + std::string("] page [") + std::string(strings.data() + pageNames[i]) + std::string("] has no size")).data());
+
+	std::stable_sort(regions.begin(), regions.end(), [](const Region& _a, const Region& _b)->bool {
+		return _a.name != _b.name ? _a.name < _b.name : _a.index < _b.index;
+	});
+	for (size_t i = 1; i < regions.size();) {
+		if (regions[i].name != regions[i - 1].name || regions[i].index != regions[i - 1].index) {
+			++i;
+			continue;
+		}
+		LOG("[" + _path + "] region [" + std::string(strings.data() + regions[i].nameOffset) + "] index " + std::to_string(regions[i].index) + " exists already, skipped");
+		regions.erase(regions.begin() + i);
+	}
+	for (auto& r : regions)
+		if (r.x < 0 || r.y < 0 || r.width < 0 || r.height < 0 || r.x + r.width > 65535 || r.y + r.height > 65535)
+			throw new std::exception((std::string("[") + _path + std::string("] region [") + std::string(strings.data() + r.nameOffset) + std::string("] is out of range")).data());
+
+	const AtlasLayout layout(pageNames.size(), regions.size(), strings.size());
+	parsed.assign(layout.size, 0);
+	CookedAtlasHeader* header = reinterpret_cast<CookedAtlasHeader*>(parsed.data());
+	std::memcpy(header->magic, "RATL", 4);
+	header->version = COOKED_ATLAS_VERSION;
+	header->sourceHash = hash(_text, _size);
+	header->pages = static_cast<uint>(pageNames.size());
+	header->regions = static_cast<uint>(regions.size());
+	header->stringBytes = static_cast<uint>(strings.size());
+	char* out = parsed.data();
+	if (!pageNames.empty()) {
+		std::memcpy(out + layout.pageWidth, pageWidth.data(), pageWidth.size() * sizeof(uint));
+		std::memcpy(out + layout.pageHeight, pageHeight.data(), pageHeight.size() * sizeof(uint));
+		std::memcpy(out + layout.pageNames, pageNames.data(), pageNames.size() * sizeof(uint));
+	}
+	for (size_t i = 0; i < regions.size(); ++i) {
+		const Region& r = regions[i];
+		reinterpret_cast<unsigned long long*>(out + layout.names)[i] = r.name;
+		reinterpret_cast<uint*>(out + layout.regionNames)[i] = r.nameOffset;
+		reinterpret_cast<int*>(out + layout.index)[i] = r.index;
+		reinterpret_cast<ushort*>(out + layout.x)[i] = static_cast<ushort>(r.x);
+		reinterpret_cast<ushort*>(out + layout.y)[i] = static_cast<ushort>(r.y);
+		reinterpret_cast<ushort*>(out + layout.width)[i] = static_cast<ushort>(r.width);
+		reinterpret_cast<ushort*>(out + layout.height)[i] = static_cast<ushort>(r.height);
+		reinterpret_cast<ushort*>(out + layout.page)[i] = static_cast<ushort>(r.page);
+	}
+	if (!strings.empty()) std::memcpy(out + layout.strings, strings.data(), strings.size());
+	if (!bind(parsed.data(), parsed.size())) throw new std::exception((std::string("parsing [") + _path + std::string("] produced an invalid table")).data());
+}
+
+void CookedAtlas::close() {
+	file.close();
+	std::vector<char>().swap(parsed);
+	table = AtlasTable();
+}
+
+bool CookedAtlas::isOpen() {
+	return table.strings != nullptr;
+}
+
+const AtlasTable& CookedAtlas::get() {
+	return table;
+}
+
+bool CookedAtlas::cook(const std::string& _source, const std::string& _out) {
+	MappedFile source;
+	if (!source.open(_source)) throw new std::exception((std::string("can't open file [") + _source + std::string("]")).data());
+	CookedAtlas atlas;
+	atlas.parse(source.data(), source.size(), _source);
+	std::ofstream out(_out, std::ios::binary | std::ios::trunc);
+	if (!out) return false;
+	out.write(atlas.parsed.data(), atlas.parsed.size());
+	return out.good();
+}
+
+unsigned long long CookedAtlas::hash(const char* _text, size_t _size) {
+	const unsigned long long out = StringId(_text, _size).hash();
+	return out != 0 ? out : 1;
+}
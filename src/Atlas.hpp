@@ -0,0 +1,164 @@
+#pragma once
+
+#include "MainStruct.hpp"
+#include "StringId.hpp"
+#include "FileSystem.hpp"
+
+namespace Heerbann {
+
+	//---------------------- SkylinePacker ----------------------\\
+
+	//skyline bottom left rectangle packer. the skyline is the upper edge of everything placed so far,
+	//a rect goes where its top ends lowest, ties go to the tighter fit. insertion is incremental,
+	//nothing already placed ever moves
+	class SkylinePacker {
+
+		struct Node {
+			uint x, y, width;
+		};
+
+		uint width, height;
+		std::vector<Node> skyline;
+		unsigned long long area = 0;
+
+		//top of a _width wide rect resting on the skyline from node _index on, false if it leaves the page
+		bool fit(size_t, uint, uint, uint&);
+
+	public:
+		SkylinePacker(uint, uint);
+
+		//width, height, position out. false if the rect doesn't fit anymore
+		bool insert(uint, uint, Vec2u&);
+		void clear();
+
+		uint getWidth();
+		uint getHeight();
+		//used area / page area
+		float occupancy();
+	};
+
+	//---------------------- DynamicAtlas ----------------------\\
+
+	//packs small rgba8 images into pages at runtime. every page is a plain 2D texture, so a SpriteBatch draws
+	//regions from all pages in one call (one sampler per page) instead of switching textures per sprite.
+	//each image is surrounded by padding texels extruded from its border against bleeding under filtering.
+	//a full page is never repacked, the next image opens a new one. main thread only
+	class DynamicAtlas {
+
+		struct Page {
+			GLuint handle;
+			SkylinePacker packer;
+		};
+
+		const uint pageSize;
+		const uint padding;
+		std::vector<Page> pages;
+		FlatMap<StringId, AtlasRegion*> regions;
+		std::vector<unsigned char> scratch;
+		//checked by pending loads, the atlas may go away first
+		std::shared_ptr<bool> alive = std::make_shared<bool>(true);
+
+		uint addPage();
+		void place(AtlasRegion*, const unsigned char*, uint, uint);
+
+	public:
+		//page size in texels, padding in texels per side
+		DynamicAtlas(uint = 2048, uint = 2);
+		~DynamicAtlas();
+
+		//copies _rgba into the atlas. returns the existing region if the id was added before,
+		//nullptr if the image is larger than a page
+		AtlasRegion* add(const std::string&, const unsigned char*, uint, uint);
+		AtlasRegion* add(const std::string&, const sf::Image&);
+		//loads the image through the AssetManager and adds it once decoded. the region is returned right away
+		//and becomes ready with the upload, a SpriteBatch skips it until then
+		AtlasRegion* load(const std::string&);
+
+		AtlasRegion* get(StringId);
+		uint pageCount();
+		GLuint page(uint);
+		uint getPageSize();
+	};
+
+	//---------------------- CookedAtlas ----------------------\\
+
+	/*
+	[CookedAtlasHeader]
+	[region name hashes: u64 * regions, sorted by hash then index]
+	[page width, page height, page name: uint * pages each]
+	[region name: uint * regions]
+	[region index: int * regions]
+	[x, y, width, height, page: ushort * regions each]
+	[strings, zero terminated]
+	names are StringId hashes, the strings are only kept to name regions & to find the page files.
+	regions sharing a name are the frames of an animation, told apart by their libgdx index (-1 if none)
+	*/
+	#define COOKED_ATLAS_VERSION 2
+
+	struct CookedAtlasHeader {
+		char magic[4];
+		uint version;
+		//hash of the text it was cooked from, a changed .atlas invalidates the cooked file
+		unsigned long long sourceHash;
+		uint pages;
+		uint regions;
+		uint stringBytes;
+		uint reserved;
+	};
+
+	//the region table of an atlas in SoA, pointers into a mapped .ratlas or into the parsed text
+	struct AtlasTable {
+		uint pages = 0, regions = 0;
+		const unsigned long long* names = nullptr;
+		const uint* pageWidth = nullptr;
+		const uint* pageHeight = nullptr;
+		const uint* pageNames = nullptr;
+		const uint* regionNames = nullptr;
+		const int* index = nullptr;
+		const ushort* x = nullptr;
+		const ushort* y = nullptr;
+		const ushort* width = nullptr;
+		const ushort* height = nullptr;
+		const ushort* page = nullptr;
+		const char* strings = nullptr;
+
+		//index of the region or -1, binary search over the hashes. the frame with the lowest index if there are several
+		int find(StringId) const;
+		//frame _frame of the region (its libgdx index)
+		int find(StringId, int) const;
+		const char* regionName(uint) const;
+		const char* pageName(uint) const;
+	};
+
+	//read only region table of a libgdx .atlas. open maps the cooked file and only validates it, nothing
+	//is allocated per region. parse reads the text format in a single pass into the same layout,
+	//for atlases that weren't cooked yet
+	class CookedAtlas {
+		AssetFile file;
+		//parse result, in the cooked layout
+		std::vector<char> parsed;
+		AtlasTable table;
+
+		//points the table into _data, false if it isn't a valid cooked atlas
+		bool bind(const char*, size_t);
+
+	public:
+		//false if the file doesn't exist, is of another version or was cooked from a source with another
+		//hash (0 takes any). throws if it isn't a valid cooked atlas
+		bool open(const std::string&, unsigned long long = 0);
+		//throws if the file doesn't exist or is malformed
+		void parse(const std::string&);
+		//text, size, path for the errors. the text only has to live through the call
+		void parse(const char*, size_t, const std::string&);
+		void close();
+		bool isOpen();
+
+		const AtlasTable& get();
+
+		//text .atlas in, .ratlas out. reads loose files only, see cook in main.cpp
+		static bool cook(const std::string&, const std::string&);
+		//of the .atlas text, never 0
+		static unsigned long long hash(const char*, size_t);
+	};
+
+}
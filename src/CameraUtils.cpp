@@ -18,20 +18,19 @@ bool ViewportHandler::checkBounds(const Vec4u& _bounds) {
 	return false;
 }
 
-View* ViewportHandler::get(std::string _id) {
-	return views[_id];
+View* ViewportHandler::get(StringId _id) {
+	return views.get(_id);
 }
 
 View* ViewportHandler::create(std::string _id, ViewType _type, bool _uniform) {
 	View* out = new View(_id, _type, this, _uniform);
-	views[_id] = out;
+	views[StringId::intern(_id)] = out;
 	return out;
 }
 
-void ViewportHandler::remove(std::string _id) {
-	View* out = views[_id];
-	delete out;
-	views[_id] = nullptr;
+void ViewportHandler::remove(StringId _id) {
+	delete views.get(_id);
+	views.erase(_id);
 }
 
 void View::setViewportBounds(uint _x, uint _y, uint _width, uint _height) {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "MainStruct.hpp"
+#include "StringId.hpp"
 
 namespace Heerbann {
 
@@ -12,7 +13,7 @@ namespace Heerbann {
 
 	class ViewportHandler {
 
-		std::unordered_map<std::string, View*> views;
+		FlatMap<StringId, View*> views;
 
 		Vec4u currentGLBounds;
 
@@ -20,9 +21,10 @@ namespace Heerbann {
 
 		bool checkBounds(const Vec4u&);
 
-		View* get(std::string);
+		//nullptr if there is no such view
+		View* get(StringId);
 		View* create(std::string, ViewType, bool);
-		void remove(std::string);
+		void remove(StringId);
 
 	};
 
@@ -0,0 +1,187 @@
+#include "Entity.hpp"
+
+using namespace Heerbann;
+
+//---------------------- Components ----------------------\\
+
+std::mutex componentLock;
+
+std::vector<ComponentInfo>& components() {
+	static std::vector<ComponentInfo> out;
+	return out;
+}
+
+ComponentId Heerbann::registerComponent(const ComponentInfo& _info) {
+	std::lock_guard<std::mutex> guard(componentLock);
+	auto& list = components();
+	if (list.size() >= MAX_COMPONENTS)
+		throw new std::exception("too many component types, raise MAX_COMPONENTS");
+	list.emplace_back(_info);
+	return static_cast<ComponentId>(list.size() - 1);
+}
+
+ComponentInfo Heerbann::componentInfo(ComponentId _id) {
+	std::lock_guard<std::mutex> guard(componentLock);
+	return components()[_id];
+}
+
+//---------------------- Archetype ----------------------\\
+
+Archetype::Archetype(const ComponentMask& _mask) : mask(_mask) {
+	for (int i = 0; i < MAX_COMPONENTS; ++i) {
+		lookup[i] = -1;
+		if (!_mask.test(i)) continue;
+		lookup[i] = static_cast<int>(columns.size());
+		Column c;
+		c.id = i;
+		c.info = componentInfo(i);
+		columns.emplace_back(c);
+	}
+}
+
+Archetype::~Archetype() {
+	for (Column& c : columns) {
+		const ComponentInfo& info = c.info;
+		for (size_t i = 0; i < entities.size(); ++i)
+			info.destroy(c.data + i * info.size);
+		operator delete(c.data, std::align_val_t(info.align));
+	}
+}
+
+void Archetype::grow() {
+	uint newCapacity = capacity == 0 ? 64 : capacity * 2;
+	for (Column& c : columns) {
+		const ComponentInfo& info = c.info;
+		char* data = reinterpret_cast<char*>(operator new(info.size * newCapacity, std::align_val_t(info.align)));
+		for (size_t i = 0; i < entities.size(); ++i) {
+			info.move(data + i * info.size, c.data + i * info.size);
+			info.destroy(c.data + i * info.size);
+		}
+		if (c.data != nullptr) operator delete(c.data, std::align_val_t(info.align));
+		c.data = data;
+	}
+	capacity = newCapacity;
+}
+
+uint Archetype::push(Entity _entity) {
+	if (entities.size() == capacity) grow();
+	entities.emplace_back(_entity);
+	return static_cast<uint>(entities.size() - 1);
+}
+
+Entity Archetype::removeSwap(uint _row) {
+	uint last = static_cast<uint>(entities.size() - 1);
+	for (Column& c : columns) {
+		const ComponentInfo& info = c.info;
+		info.destroy(c.data + _row * info.size);
+		if (_row == last) continue;
+		info.move(c.data + _row * info.size, c.data + last * info.size);
+		info.destroy(c.data + last * info.size);
+	}
+	Entity moved;
+	if (_row != last) {
+		moved = entities[last];
+		entities[_row] = moved;
+	}
+	entities.pop_back();
+	return moved;
+}
+
+//---------------------- EntityStore ----------------------\\
+
+EntityStore::EntityStore() {
+	//every entity starts out in the empty archetype
+	getArchetype(ComponentMask());
+}
+
+EntityStore::~EntityStore() {
+	for (Archetype* a : archetypes)
+		delete a;
+}
+
+Archetype* EntityStore::getArchetype(const ComponentMask& _mask) {
+	auto it = archetypeMap.find(_mask);
+	if (it != archetypeMap.end()) return it->second;
+	Archetype* out = new Archetype(_mask);
+	archetypes.emplace_back(out);
+	archetypeMap[_mask] = out;
+	return out;
+}
+
+uint EntityStore::move(Entity _entity, Archetype* _to) {
+	Record& r = records[_entity.index];
+	Archetype* from = r.archetype;
+	uint row = _to->push(_entity);
+	for (Archetype::Column& c : from->columns) {
+		int dst = _to->column(c.id);
+		if (dst < 0) continue;
+		const ComponentInfo& info = c.info;
+		info.move(_to->columns[dst].data + row * info.size, c.data + r.row * info.size);
+	}
+	//the moved from husks are destroyed here
+	Entity moved = from->removeSwap(r.row);
+	if (moved.valid()) records[moved.index].row = r.row;
+	r.archetype = _to;
+	r.row = row;
+	return row;
+}
+
+void* EntityStore::component(Entity _entity, ComponentId _id) {
+	if (!isAlive(_entity)) return nullptr;
+	Record& r = records[_entity.index];
+	int c = r.archetype->column(_id);
+	if (c < 0) return nullptr;
+	return r.archetype->columns[c].data + r.row * r.archetype->columns[c].info.size;
+}
+
+Entity EntityStore::create() {
+	Entity out;
+	if (freeIndices.empty()) {
+		out.index = static_cast<uint>(records.size());
+		records.emplace_back();
+	} else {
+		out.index = freeIndices.back();
+		freeIndices.pop_back();
+	}
+	Record& r = records[out.index];
+	out.generation = r.generation;
+	r.archetype = archetypes[0];
+	r.row = r.archetype->push(out);
+	++alive;
+	return out;
+}
+
+void EntityStore::destroy(Entity _entity) {
+	if (!isAlive(_entity)) return;
+	Record& r = records[_entity.index];
+	Entity moved = r.archetype->removeSwap(r.row);
+	if (moved.valid()) records[moved.index].row = r.row;
+	r.archetype = nullptr;
+	++r.generation;
+	freeIndices.emplace_back(_entity.index);
+	--alive;
+}
+
+bool EntityStore::isAlive(Entity _entity) {
+	return _entity.index < records.size() && records[_entity.index].generation == _entity.generation
+		&& records[_entity.index].archetype != nullptr;
+}
+
+const std::vector<Archetype*>& EntityStore::query(const ComponentMask& _mask) {
+	Query& q = queries[_mask];
+	//only archetypes created since the last call need to be checked
+	for (; q.checked < archetypes.size(); ++q.checked) {
+		Archetype* a = archetypes[q.checked];
+		if ((a->getMask() & _mask) == _mask)
+			q.archetypes.emplace_back(a);
+	}
+	return q.archetypes;
+}
+
+uint EntityStore::size() {
+	return alive;
+}
+
+uint EntityStore::archetypeCount() {
+	return static_cast<uint>(archetypes.size());
+}
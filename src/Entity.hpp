@@ -0,0 +1,230 @@
+#pragma once
+
+#include "MainStruct.hpp"
+
+#include <bitset>
+
+namespace Heerbann {
+
+	//---------------------- Entity ----------------------\\
+
+	//generational handle. a destroyed entity's index is reused with a new generation,
+	//so stale handles are detected instead of silently pointing at someone else
+	struct Entity {
+		uint index = ~0u;
+		uint generation = 0;
+
+		inline bool operator==(const Entity& _other) const {
+			return index == _other.index && generation == _other.generation;
+		};
+
+		inline bool operator!=(const Entity& _other) const {
+			return !(*this == _other);
+		};
+
+		inline bool valid() const {
+			return index != ~0u;
+		};
+	};
+
+	//---------------------- Components ----------------------\\
+
+	#define MAX_COMPONENTS 64
+
+	typedef uint ComponentId;
+	typedef std::bitset<MAX_COMPONENTS> ComponentMask;
+
+	//type erased lifetime functions of a component type
+	struct ComponentInfo {
+		size_t size;
+		size_t align;
+		void(*move)(void*, void*); //move constructs dst from src
+		void(*destroy)(void*);
+	};
+
+	ComponentId registerComponent(const ComponentInfo&);
+	//a copy, the registry grows while other types register
+	ComponentInfo componentInfo(ComponentId);
+
+	//ids are handed out on first use, they are stable for the lifetime of the process
+	template<class T>
+	inline ComponentId componentId() {
+		static const ComponentId id = registerComponent({ sizeof(T), alignof(T),
+			[](void* _dst, void* _src) { new (_dst) T(std::move(*reinterpret_cast<T*>(_src))); },
+			[](void* _obj) { reinterpret_cast<T*>(_obj)->~T(); }
+		});
+		return id;
+	}
+
+	template<class ... T>
+	inline ComponentMask componentMask() {
+		ComponentMask out;
+		(out.set(componentId<T>()), ...);
+		return out;
+	}
+
+	//---------------------- Archetype ----------------------\\
+
+	//all entities with exactly the same component set. every component type is one
+	//contiguous column, row i of every column belongs to entities[i].
+	class Archetype {
+
+		friend EntityStore;
+
+		struct Column {
+			ComponentId id;
+			//copied so the hot paths never touch the locked registry
+			ComponentInfo info;
+			char* data = nullptr;
+		};
+
+		ComponentMask mask;
+		std::vector<Column> columns;
+		//column index per component id, -1 if not part of this archetype
+		int lookup[MAX_COMPONENTS];
+		std::vector<Entity> entities;
+		uint capacity = 0;
+
+		void grow();
+		//appends a row with unconstructed components
+		uint push(Entity);
+		//destroys the row and moves the last row into it. returns the moved entity or an invalid one
+		Entity removeSwap(uint);
+
+	public:
+		Archetype(const ComponentMask&);
+		~Archetype();
+
+		inline int column(ComponentId _id) const {
+			return lookup[_id];
+		};
+
+		template<class T>
+		inline T* data() {
+			int c = lookup[componentId<T>()];
+			return c < 0 ? nullptr : reinterpret_cast<T*>(columns[c].data);
+		};
+
+		inline const ComponentMask& getMask() const {
+			return mask;
+		};
+
+		inline uint size() const {
+			return static_cast<uint>(entities.size());
+		};
+
+		inline const Entity* getEntities() const {
+			return entities.data();
+		};
+	};
+
+	//---------------------- EntityStore ----------------------\\
+
+	//archetype based entity component store. main thread only, structural changes (create, destroy,
+	//add, remove) invalidate component pointers. the columns of a query may be processed in parallel.
+	class EntityStore {
+
+		struct Record {
+			Archetype* archetype = nullptr;
+			uint row = 0;
+			uint generation = 0;
+		};
+
+		//archetypes matching a component set, extended when new archetypes appear
+		struct Query {
+			std::vector<Archetype*> archetypes;
+			size_t checked = 0;
+		};
+
+		std::vector<Record> records;
+		std::vector<uint> freeIndices;
+		std::vector<Archetype*> archetypes;
+		std::unordered_map<ComponentMask, Archetype*> archetypeMap;
+		std::unordered_map<ComponentMask, Query> queries;
+		uint alive = 0;
+
+		Archetype* getArchetype(const ComponentMask&);
+		//moves the entity into _to, components not in _to are destroyed. returns the new row
+		uint move(Entity, Archetype*);
+		void* component(Entity, ComponentId);
+
+	public:
+		EntityStore();
+		~EntityStore();
+
+		Entity create();
+		void destroy(Entity);
+		bool isAlive(Entity);
+
+		template<class T, class ... Args>
+		T& add(Entity, Args&& ...);
+
+		template<class T>
+		void remove(Entity);
+
+		//nullptr if the entity is dead or does not have T
+		template<class T>
+		T* get(Entity);
+
+		template<class T>
+		bool has(Entity);
+
+		//archetypes containing all of _mask. cached, the first call per mask scans every archetype
+		const std::vector<Archetype*>& query(const ComponentMask&);
+
+		//calls _func(Entity, T&...) for every entity having all of T, linear over the packed columns.
+		//_func may not create, destroy, add or remove
+		template<class ... T, class F>
+		void each(F&&);
+
+		uint size();
+		uint archetypeCount();
+	};
+
+	template<class T, class ... Args>
+	inline T& EntityStore::add(Entity _entity, Args&& ... _args) {
+		assert(isAlive(_entity) && "dead entity");
+		ComponentId id = componentId<T>();
+		Record& r = records[_entity.index];
+		if (r.archetype->column(id) >= 0) {
+			T* out = reinterpret_cast<T*>(component(_entity, id));
+			*out = T(std::forward<Args>(_args)...);
+			return *out;
+		}
+		ComponentMask mask = r.archetype->getMask();
+		mask.set(id);
+		Archetype* to = getArchetype(mask);
+		uint row = move(_entity, to);
+		return *new (to->columns[to->column(id)].data + row * sizeof(T)) T(std::forward<Args>(_args)...);
+	}
+
+	template<class T>
+	inline void EntityStore::remove(Entity _entity) {
+		if (!has<T>(_entity)) return;
+		ComponentMask mask = records[_entity.index].archetype->getMask();
+		mask.reset(componentId<T>());
+		move(_entity, getArchetype(mask));
+	}
+
+	template<class T>
+	inline T* EntityStore::get(Entity _entity) {
+		return reinterpret_cast<T*>(component(_entity, componentId<T>()));
+	}
+
+	template<class T>
+	inline bool EntityStore::has(Entity _entity) {
+		return isAlive(_entity) && records[_entity.index].archetype->column(componentId<T>()) >= 0;
+	}
+
+	template<class ... T, class F>
+	inline void EntityStore::each(F&& _func) {
+		for (Archetype* a : query(componentMask<T...>())) {
+			const uint count = a->size();
+			const Entity* entities = a->getEntities();
+			auto cols = std::make_tuple(a->data<T>()...);
+			for (uint i = 0; i < count; ++i)
+				_func(entities[i], std::get<T*>(cols)[i]...);
+		}
+	}
+
+}
@@ -0,0 +1,372 @@
+#include "FileSystem.hpp"
+#include "Assets.hpp"
+
+#include <fstream>
+#include <zlib.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace Heerbann;
+
+//---------------------- MappedFile ----------------------\\
+
+MappedFile::MappedFile() {}
+
+MappedFile::MappedFile(const std::string& _path, Access _access) {
+	open(_path, _access);
+}
+
+MappedFile::MappedFile(MappedFile&& _other) {
+	*this = std::move(_other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& _other) {
+	if (this == &_other) return *this;
+	close();
+	std::swap(file, _other.file);
+#ifdef _WIN32
+	std::swap(mapping, _other.mapping);
+#endif
+	std::swap(pntr, _other.pntr);
+	std::swap(length, _other.length);
+	return *this;
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+bool MappedFile::open(const std::string& _path, Access _access) {
+	close();
+#ifdef _WIN32
+	DWORD hint = _access == Access::sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+	file = CreateFileA(_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | hint, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) {
+		close();
+		return false;
+	}
+	length = static_cast<size_t>(fileSize.QuadPart);
+	//a mapping of an empty file fails, there is nothing to map anyway
+	if (length == 0) return true;
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		close();
+		return false;
+	}
+	pntr = reinterpret_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	file = ::open(_path.c_str(), O_RDONLY);
+	if (file < 0) return false;
+	struct stat st;
+	if (fstat(file, &st) != 0) {
+		close();
+		return false;
+	}
+	length = static_cast<size_t>(st.st_size);
+	if (length == 0) return true;
+	void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file, 0);
+	pntr = view == MAP_FAILED ? nullptr : reinterpret_cast<const char*>(view);
+	if (pntr != nullptr) madvise(view, length, _access == Access::sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+#endif
+	if (pntr == nullptr) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+	if (pntr != nullptr) UnmapViewOfFile(pntr);
+	if (mapping != nullptr) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+	mapping = nullptr;
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (pntr != nullptr) munmap(const_cast<char*>(pntr), length);
+	if (file >= 0) ::close(file);
+	file = -1;
+#endif
+	pntr = nullptr;
+	length = 0;
+}
+
+bool MappedFile::isOpen() {
+#ifdef _WIN32
+	return file != INVALID_HANDLE_VALUE;
+#else
+	return file >= 0;
+#endif
+}
+
+const char* MappedFile::data() {
+	return pntr;
+}
+
+size_t MappedFile::size() {
+	return length;
+}
+
+void MappedFile::prefetch(size_t _offset, size_t _length) {
+	if (pntr == nullptr || _offset >= length) return;
+	_length = std::min(_length, length - _offset);
+#ifdef _WIN32
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = const_cast<char*>(pntr + _offset);
+	range.NumberOfBytes = _length;
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+	//madvise wants a page aligned start
+	size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t start = _offset & ~(page - 1);
+	madvise(const_cast<char*>(pntr + start), _length + (_offset - start), MADV_WILLNEED);
+#endif
+}
+
+//---------------------- PackArchive ----------------------\\
+
+bool PackArchive::open(const std::string& _path) {
+	close();
+	if (!file.open(_path, MappedFile::Access::random)) return false;
+	if (file.size() < sizeof(PackHeader)) {
+		close();
+		return false;
+	}
+	header = reinterpret_cast<const PackHeader*>(file.data());
+	const unsigned long long end = file.size();
+	//written so that nothing overflows on garbage offsets
+	bool valid = std::memcmp(header->magic, "RPAK", 4) == 0 && header->version == PACK_VERSION
+		&& header->indexOffset <= end && header->indexOffset % alignof(PackEntry) == 0
+		&& header->count <= (end - header->indexOffset) / sizeof(PackEntry) && header->namesOffset <= end;
+	if (valid) {
+		entries = reinterpret_cast<const PackEntry*>(file.data() + header->indexOffset);
+		//a truncated or corrupt pack would otherwise be read past the mapping by data & find
+		const unsigned long long namesSize = end - header->namesOffset;
+		for (uint i = 0; valid && i < header->count; ++i) {
+			const PackEntry& e = entries[i];
+			valid = e.offset <= end && e.size <= end - e.offset
+				&& e.nameOffset <= namesSize && e.nameLength <= namesSize - e.nameOffset
+				&& ((e.flags & PackEntry::compressed) != 0 || e.size == e.rawSize);
+		}
+	}
+	if (!valid) {
+		LOG("invalid pack archive [" + _path + "]");
+		close();
+		return false;
+	}
+	path = _path;
+	names = file.data() + header->namesOffset;
+	//the index is touched on every lookup, keep it resident
+	file.prefetch(header->indexOffset, file.size() - header->indexOffset);
+	return true;
+}
+
+void PackArchive::close() {
+	file.close();
+	header = nullptr;
+	entries = nullptr;
+	names = nullptr;
+}
+
+const PackEntry* PackArchive::find(const std::string& _path) {
+	if (header == nullptr) return nullptr;
+	std::string name = normalize(_path);
+	unsigned long long h = hash(name);
+	const PackEntry* end = entries + header->count;
+	const PackEntry* it = std::lower_bound(entries, end, h, [](const PackEntry& _e, unsigned long long _h) {
+		return _e.hash < _h;
+	});
+	//collisions are adjacent
+	for (; it != end && it->hash == h; ++it)
+		if (name.compare(0, std::string::npos, names + it->nameOffset, it->nameLength) == 0)
+			return it;
+	return nullptr;
+}
+
+const char* PackArchive::data(const PackEntry* _entry) {
+	return file.data() + _entry->offset;
+}
+
+void PackArchive::prefetch(const PackEntry* _entry) {
+	file.prefetch(static_cast<size_t>(_entry->offset), static_cast<size_t>(_entry->size));
+}
+
+const std::string& PackArchive::getPath() {
+	return path;
+}
+
+uint PackArchive::size() {
+	return header == nullptr ? 0 : header->count;
+}
+
+unsigned long long PackArchive::hash(const std::string& _path) {
+	//fnv-1a
+	unsigned long long out = 0xcbf29ce484222325ull;
+	for (char c : _path) {
+		out ^= static_cast<unsigned char>(c);
+		out *= 0x100000001b3ull;
+	}
+	return out;
+}
+
+std::string PackArchive::normalize(const std::string& _path) {
+	std::string out(_path);
+	std::replace(out.begin(), out.end(), '\\', '/');
+	while (out.compare(0, 2, "./") == 0)
+		out.erase(0, 2);
+	return out;
+}
+
+bool PackArchive::write(const std::string& _out, const std::vector<std::string>& _files, bool _compress) {
+	std::ofstream ofs(_out, std::ios::binary | std::ios::trunc);
+	if (!ofs.good()) return false;
+
+	PackHeader head = {};
+	std::memcpy(head.magic, "RPAK", 4);
+	head.version = PACK_VERSION;
+	head.count = static_cast<uint>(_files.size());
+	ofs.write(reinterpret_cast<const char*>(&head), sizeof(PackHeader));
+
+	std::vector<PackEntry> index;
+	std::string nameTable;
+	unsigned long long offset = sizeof(PackHeader);
+	const char zeros[PACK_ALIGN] = {};
+
+	for (const std::string& f : _files) {
+		MappedFile in(f);
+		if (!in.isOpen()) {
+			//runs before Main::intialize (--pack), so no logger
+			std::cout << "can't pack [" << f << "], file missing" << std::endl;
+			return false;
+		}
+		std::string name = normalize(f);
+		PackEntry e = {};
+		e.hash = hash(name);
+		e.rawSize = in.size();
+		e.nameOffset = static_cast<uint>(nameTable.size());
+		e.nameLength = static_cast<uint>(name.size());
+		nameTable += name;
+
+		const char* bytes = in.data();
+		e.size = in.size();
+		std::vector<Bytef> packed;
+		if (_compress && in.size() > 0) {
+			uLongf packedSize = compressBound(static_cast<uLong>(in.size()));
+			packed.resize(packedSize);
+			//only keep it if it pays off, png & co are compressed already
+			if (compress2(packed.data(), &packedSize, reinterpret_cast<const Bytef*>(in.data()), static_cast<uLong>(in.size()), Z_BEST_COMPRESSION) == Z_OK
+				&& packedSize < in.size() - in.size() / 8) {
+				e.flags |= PackEntry::compressed;
+				e.size = packedSize;
+				bytes = reinterpret_cast<const char*>(packed.data());
+			}
+		}
+
+		unsigned long long aligned = (offset + PACK_ALIGN - 1) & ~static_cast<unsigned long long>(PACK_ALIGN - 1);
+		ofs.write(zeros, aligned - offset);
+		e.offset = aligned;
+		ofs.write(bytes, e.size);
+		offset = aligned + e.size;
+		index.emplace_back(e);
+	}
+
+	std::sort(index.begin(), index.end(), [](const PackEntry& _a, const PackEntry& _b) {
+		return _a.hash < _b.hash;
+	});
+	unsigned long long aligned = (offset + PACK_ALIGN - 1) & ~static_cast<unsigned long long>(PACK_ALIGN - 1);
+	ofs.write(zeros, aligned - offset);
+	head.indexOffset = aligned;
+	ofs.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(PackEntry));
+	head.namesOffset = head.indexOffset + index.size() * sizeof(PackEntry);
+	ofs.write(nameTable.data(), nameTable.size());
+
+	ofs.seekp(0);
+	ofs.write(reinterpret_cast<const char*>(&head), sizeof(PackHeader));
+	return ofs.good();
+}
+
+//---------------------- AssetFile ----------------------\\
+
+AssetFile::AssetFile(AssetFile&& _other) {
+	*this = std::move(_other);
+}
+
+AssetFile& AssetFile::operator=(AssetFile&& _other) {
+	if (this == &_other) return *this;
+	close();
+	//the buffers of the mapping & the inflated vector don't move, so pntr stays valid
+	loose = std::move(_other.loose);
+	inflated.swap(_other.inflated);
+	std::swap(archive, _other.archive);
+	std::swap(entry, _other.entry);
+	std::swap(pntr, _other.pntr);
+	std::swap(length, _other.length);
+	return *this;
+}
+
+AssetFile::~AssetFile() {
+	close();
+}
+
+bool AssetFile::open(const std::string& _id, MappedFile::Access _access) {
+	close();
+	if (M_Asset->find(_id, archive, entry)) {
+		if (entry->flags & PackEntry::compressed) {
+			inflated.resize(static_cast<size_t>(entry->rawSize));
+			uLongf rawSize = static_cast<uLongf>(entry->rawSize);
+			if (uncompress(reinterpret_cast<Bytef*>(inflated.data()), &rawSize, reinterpret_cast<const Bytef*>(archive->data(entry)), static_cast<uLong>(entry->size)) != Z_OK
+				|| rawSize != entry->rawSize) {
+				LOG("corrupt entry [" + _id + "] in [" + archive->getPath() + "]");
+				close();
+				return false;
+			}
+			pntr = inflated.data();
+		} else pntr = archive->data(entry);
+		length = static_cast<size_t>(entry->rawSize);
+		return true;
+	}
+	//development: loose files next to the executable
+	if (!loose.open(_id, _access)) return false;
+	pntr = loose.data();
+	length = loose.size();
+	return true;
+}
+
+void AssetFile::close() {
+	loose.close();
+	std::vector<char>().swap(inflated);
+	if (archive != nullptr) M_Asset->release(archive);
+	archive = nullptr;
+	entry = nullptr;
+	pntr = nullptr;
+	length = 0;
+}
+
+bool AssetFile::isOpen() {
+	return archive != nullptr || loose.isOpen();
+}
+
+bool AssetFile::packed() {
+	return archive != nullptr;
+}
+
+const char* AssetFile::data() {
+	return pntr;
+}
+
+size_t AssetFile::size() {
+	return length;
+}
+
+void AssetFile::prefetch() {
+	if (!inflated.empty()) return;
+	if (archive != nullptr) archive->prefetch(entry);
+	else loose.prefetch();
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "MainStruct.hpp"
+
+namespace Heerbann {
+
+	//---------------------- MappedFile ----------------------\\
+
+	//read only view of a whole file straight from the os page cache, no heap copy
+	class MappedFile {
+#ifdef _WIN32
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+#else
+		int file = -1;
+#endif
+		const char* pntr = nullptr;
+		size_t length = 0;
+
+	public:
+		enum Access {
+			sequential, //read front to back once, the os reads ahead aggressively
+			random //sparse reads (archives, indices)
+		};
+
+		MappedFile();
+		MappedFile(const std::string&, Access = Access::sequential);
+		MappedFile(MappedFile&&);
+		MappedFile& operator=(MappedFile&&);
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile();
+
+		//false if the file can't be opened. an empty file is open with size 0
+		bool open(const std::string&, Access = Access::sequential);
+		void close();
+		bool isOpen();
+
+		const char* data();
+		size_t size();
+
+		//asks the os to page in [offset, offset + length) before it is touched
+		void prefetch(size_t = 0, size_t = ~size_t(0));
+	};
+
+	//---------------------- PackArchive ----------------------\\
+
+	/*
+	single file archive of assets, laid out so a mounted pack needs one open and one mapping:
+	[PackHeader][entry data, each PACK_ALIGN aligned][PackEntry index, sorted by hash][names]
+	paths are stored normalized (forward slashes, relative to the working directory like asset ids)
+	*/
+	#define PACK_VERSION 1
+	#define PACK_ALIGN 64
+
+	struct PackHeader {
+		char magic[4];
+		uint version;
+		uint count;
+		uint flags;
+		unsigned long long indexOffset;
+		unsigned long long namesOffset;
+	};
+
+	struct PackEntry {
+		enum Flags {
+			compressed = 1 //zlib, rawSize bytes after inflating
+		};
+		unsigned long long hash;
+		unsigned long long offset;
+		unsigned long long size; //bytes stored in the archive
+		unsigned long long rawSize;
+		uint nameOffset;
+		uint nameLength;
+		uint flags;
+		uint padding;
+	};
+
+	class PackArchive {
+
+		friend AssetManager;
+
+		MappedFile file;
+		std::string path;
+		const PackHeader* header = nullptr;
+		const PackEntry* entries = nullptr;
+		const char* names = nullptr;
+		//AssetFiles reading from the mapping and whether AssetManager::unmount dropped the archive
+		//while they did, guarded by the archive lock of the AssetManager
+		uint users = 0;
+		bool unmounted = false;
+
+	public:
+		//false if the file is missing or not a valid archive. every entry has to lie within the file
+		bool open(const std::string&);
+		void close();
+
+		//nullptr if the archive doesn't contain the path
+		const PackEntry* find(const std::string&);
+		//pointer to the stored bytes of an entry, still compressed if the entry is
+		const char* data(const PackEntry*);
+		void prefetch(const PackEntry*);
+
+		const std::string& getPath();
+		uint size();
+
+		//writes _files (asset ids) into a new archive. entries are compressed if that saves at least 1/8
+		static bool write(const std::string&, const std::vector<std::string>&, bool = true);
+		static unsigned long long hash(const std::string&);
+		//forward slashes, no leading ./
+		static std::string normalize(const std::string&);
+	};
+
+	//---------------------- AssetFile ----------------------\\
+
+	//bytes of one asset, zero copy from a mounted archive or a loose file mapping as fallback.
+	//compressed archive entries are inflated into an owned buffer.
+	class AssetFile {
+		MappedFile loose;
+		std::vector<char> inflated;
+		//referenced while open, see AssetManager::find
+		PackArchive* archive = nullptr;
+		const PackEntry* entry = nullptr;
+		const char* pntr = nullptr;
+		size_t length = 0;
+
+	public:
+		AssetFile() = default;
+		AssetFile(AssetFile&&);
+		AssetFile& operator=(AssetFile&&);
+		AssetFile(const AssetFile&) = delete;
+		AssetFile& operator=(const AssetFile&) = delete;
+		~AssetFile();
+
+		bool open(const std::string&, MappedFile::Access = MappedFile::Access::sequential);
+		void close();
+		bool isOpen();
+		//true if the bytes come from an archive
+		bool packed();
+
+		const char* data();
+		size_t size();
+		void prefetch();
+	};
+
+}
@@ -1,8 +1,341 @@
 
 #include "g3d.hpp"
 #include "Utils.hpp"
+#include "FileSystem.hpp"
+
+#include <fstream>
+#include <glm/gtc/packing.hpp>
 
 using namespace Heerbann;
 
+//---------------------- PackedVertex ----------------------\\
+
+PackedVertex PackedVertex::pack(const Vec3& _position, const Vec3& _min, const Vec3& _extent, const Vec3& _normal, const Vec2& _uv) {
+	PackedVertex out;
+	for (uint i = 0; i < 3; ++i)
+		out.position[i] = glm::packUnorm1x16(_extent[i] > 0.f ? (_position[i] - _min[i]) / _extent[i] : 0.f);
+	out.position[3] = 0;
+	const Vec2 oct = octahedral(_normal);
+	out.normal[0] = static_cast<short>(glm::packSnorm1x16(oct.x));
+	out.normal[1] = static_cast<short>(glm::packSnorm1x16(oct.y));
+	out.uv[0] = glm::packHalf1x16(_uv.x);
+	out.uv[1] = glm::packHalf1x16(_uv.y);
+	return out;
+}
+
+Vec2 PackedVertex::octahedral(const Vec3& _n) {
+	const float l1 = std::abs(_n.x) + std::abs(_n.y) + std::abs(_n.z);
+	if (l1 == 0.f) return Vec2(0.f);
+	Vec2 p(_n.x / l1, _n.y / l1);
+	if (_n.z < 0.f)
+		p = Vec2((1.f - std::abs(p.y)) * (p.x >= 0.f ? 1.f : -1.f), (1.f - std::abs(p.x)) * (p.y >= 0.f ? 1.f : -1.f));
+	return p;
+}
+
+void PackedVertex::setupAttributes() {
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position));
+
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, normal));
+
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, uv));
+}
+
+//---------------------- ModelData ----------------------\\
+
+ModelData::~ModelData() {
+	for (Mesh* m : meshList)
+		delete m;
+	for (auto& bones : boneCache)
+		for (Bone* b : bones)
+			delete b;
+	for (mNode* n : nodeCache)
+		delete n;
+	for (Animation* a : animations) {
+		for (NodeAnimation* c : a->nodeChannels)
+			delete c;
+		for (MeshAnimation* c : a->meshChannels)
+			delete c;
+		delete a;
+	}
+	delete[] animationCache;
+	delete[] metaCache;
+}
+
+void DrawCall::bindDequantization(uint _location) const {
+	glUniform3fv(_location, 1, &boundsMin[0]);
+	glUniform3fv(_location + 1, 1, &boundsExtent[0]);
+}
+
+//---------------------- ModelCache ----------------------\\
+
+//appends plain data & length prefixed strings
+struct BinaryWriter {
+	std::string buffer;
+
+	template<class T>
+	void put(const T& _val) {
+		static_assert(std::is_trivially_copyable<T>::value, "plain data only");
+		buffer.append(reinterpret_cast<const char*>(&_val), sizeof(T));
+	}
+
+	void put(const std::string& _val) {
+		put(static_cast<uint>(_val.size()));
+		buffer.append(_val);
+	}
+
+	template<class T>
+	void put(const std::vector<T>& _vals) {
+		put(static_cast<uint>(_vals.size()));
+		if (!_vals.empty()) buffer.append(reinterpret_cast<const char*>(_vals.data()), _vals.size() * sizeof(T));
+	}
+};
+
+//bounds checked counterpart of BinaryWriter, throws on a truncated file
+struct BinaryReader {
+	const char* pntr;
+	const char* end;
+
+	void need(size_t _bytes) {
+		if (static_cast<size_t>(end - pntr) < _bytes) throw new std::exception("cooked model truncated");
+	}
+
+	template<class T>
+	T get() {
+		need(sizeof(T));
+		T out;
+		std::memcpy(&out, pntr, sizeof(T));
+		pntr += sizeof(T);
+		return out;
+	}
+
+	std::string getString() {
+		uint size = get<uint>();
+		need(size);
+		std::string out(pntr, size);
+		pntr += size;
+		return out;
+	}
+
+	template<class T>
+	void getVector(std::vector<T>& _out) {
+		uint size = get<uint>();
+		need(size * sizeof(T));
+		_out.resize(size);
+		if (size > 0) std::memcpy(_out.data(), pntr, size * sizeof(T));
+		pntr += size * sizeof(T);
+	}
+};
+
+unsigned long long ModelCache::hash(const char* _data, size_t _size) {
+	//fnv-1a, seeded with the version so a format change invalidates every cooked file
+	unsigned long long out = 0xcbf29ce484222325ull ^ MODEL_CACHE_VERSION;
+	for (size_t i = 0; i < _size; ++i) {
+		out ^= static_cast<unsigned char>(_data[i]);
+		out *= 0x100000001b3ull;
+	}
+	return out;
+}
+
+bool ModelCache::write(const std::string& _path, unsigned long long _hash, ModelData* _model) {
+	BinaryWriter meta;
+
+	meta.put(_model->materials);
+
+	meta.put(static_cast<uint>(_model->meshList.size()));
+	for (uint i = 0; i < _model->meshList.size(); ++i) {
+		Mesh* m = _model->meshList[i];
+		meta.put(m->id);
+		meta.put(m->vertexOffset);
+		meta.put(m->vertexCount);
+		meta.put(m->indexOffset);
+		meta.put(m->indexCount);
+		meta.put(m->matIndex);
+		meta.put(m->boundsMin);
+		meta.put(m->boundsExtent);
+		//import order, boneMap holds one bone per name
+		const std::vector<Bone*>& bones = _model->boneCache[i];
+		meta.put(static_cast<uint>(bones.size()));
+		for (Bone* b : bones) {
+			meta.put(b->id);
+			meta.put(b->offset);
+			meta.put(static_cast<uint>(b->weights.size()));
+			for (auto& w : b->weights) {
+				meta.put(std::get<0>(w));
+				meta.put(std::get<1>(w));
+			}
+		}
+	}
+
+	std::unordered_map<mNode*, int> nodeIndex;
+	meta.put(static_cast<uint>(_model->nodeCache.size()));
+	for (uint i = 0; i < _model->nodeCache.size(); ++i) {
+		mNode* n = _model->nodeCache[i];
+		nodeIndex[n] = static_cast<int>(i);
+		meta.put(n->id);
+		meta.put(n->transform);
+		meta.put(n->parent == nullptr ? -1 : nodeIndex[n->parent]);
+		meta.put(n->meshes);
+	}
+
+	meta.put(static_cast<uint>(_model->animations.size()));
+	for (Animation* a : _model->animations) {
+		meta.put(a->id);
+		meta.put(a->duration);
+		meta.put(a->ticksPerSecond);
+		meta.put(static_cast<uint>(a->nodeChannels.size()));
+		for (NodeAnimation* c : a->nodeChannels) {
+			meta.put(c->affectedNode);
+			meta.put(c->positionKeys);
+			meta.put(c->quatKeys);
+			meta.put(c->scalingKeys);
+			meta.put(static_cast<int>(c->preState));
+			meta.put(static_cast<int>(c->postState));
+		}
+		meta.put(static_cast<uint>(a->meshChannels.size()));
+		for (MeshAnimation* c : a->meshChannels) {
+			meta.put(c->affectedMesh);
+			meta.put(c->keys);
+		}
+	}
+
+	auto align = [](unsigned long long _offset)->unsigned long long {
+		return (_offset + 63) & ~63ull;
+	};
+
+	CookedModelHeader head = {};
+	std::memcpy(head.magic, "RMDL", 4);
+	head.version = MODEL_CACHE_VERSION;
+	head.sourceHash = _hash;
+	head.vertexOffset = align(sizeof(CookedModelHeader));
+	head.vertexCount = _model->vertexBufferCacheSize;
+	head.indexOffset = align(head.vertexOffset + head.vertexCount * sizeof(PackedVertex));
+	head.indexCount = _model->indexBufferCacheSize;
+	head.metaOffset = align(head.indexOffset + head.indexCount * sizeof(unsigned int));
+	head.metaSize = meta.buffer.size();
+
+	//written to a temp file first, a crash mid write must not leave a valid looking cache
+	std::string tmp = _path + ".tmp";
+	{
+		std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+		if (!ofs.good()) return false;
+		const char zeros[64] = {};
+		ofs.write(reinterpret_cast<const char*>(&head), sizeof(CookedModelHeader));
+		ofs.write(zeros, head.vertexOffset - sizeof(CookedModelHeader));
+		ofs.write(reinterpret_cast<const char*>(_model->vertexBufferCache), head.vertexCount * sizeof(PackedVertex));
+		ofs.write(zeros, head.indexOffset - (head.vertexOffset + head.vertexCount * sizeof(PackedVertex)));
+		ofs.write(reinterpret_cast<const char*>(_model->indexBufferCache), head.indexCount * sizeof(unsigned int));
+		ofs.write(zeros, head.metaOffset - (head.indexOffset + head.indexCount * sizeof(unsigned int)));
+		ofs.write(meta.buffer.data(), meta.buffer.size());
+		if (!ofs.good()) return false;
+	}
+	std::remove(_path.c_str());
+	return std::rename(tmp.c_str(), _path.c_str()) == 0;
+}
+
+bool ModelCache::read(const std::string& _path, unsigned long long _hash, ModelData* _out, MappedFile& _file) {
+	if (!_file.open(_path)) return false;
+	if (_file.size() < sizeof(CookedModelHeader)) {
+		_file.close();
+		return false;
+	}
+	const CookedModelHeader* head = reinterpret_cast<const CookedModelHeader*>(_file.data());
+	bool valid = std::memcmp(head->magic, "RMDL", 4) == 0 && head->version == MODEL_CACHE_VERSION && head->sourceHash == _hash
+		&& head->vertexOffset + head->vertexCount * sizeof(PackedVertex) <= _file.size()
+		&& head->indexOffset + head->indexCount * sizeof(unsigned int) <= _file.size()
+		&& head->metaOffset + head->metaSize <= _file.size();
+	if (!valid) {
+		_file.close();
+		return false;
+	}
+	_file.prefetch();
+
+	_out->vertexBufferCacheSize = static_cast<uint>(head->vertexCount);
+	_out->vertexBufferCache = reinterpret_cast<PackedVertex*>(const_cast<char*>(_file.data() + head->vertexOffset));
+	_out->indexBufferCacheSize = static_cast<uint>(head->indexCount);
+	_out->indexBufferCache = reinterpret_cast<unsigned int*>(const_cast<char*>(_file.data() + head->indexOffset));
+
+	BinaryReader meta{ _file.data() + head->metaOffset, _file.data() + head->metaOffset + head->metaSize };
+
+	meta.getVector(_out->materials);
+
+	uint meshCount = meta.get<uint>();
+	_out->meshList.resize(meshCount);
+	_out->boneCache.resize(meshCount);
+	for (uint i = 0; i < meshCount; ++i) {
+		Mesh* m = new Mesh();
+		_out->meshList[i] = m;
+		m->id = meta.getString();
+		_out->meshMap[StringId::intern(m->id)] = m;
+		m->vertexOffset = meta.get<uint>();
+		m->vertexCount = meta.get<uint>();
+		m->indexOffset = meta.get<uint>();
+		m->indexCount = meta.get<uint>();
+		m->matIndex = meta.get<uint>();
+		m->boundsMin = meta.get<Vec3>();
+		m->boundsExtent = meta.get<Vec3>();
+		m->root = nullptr;
+		uint boneCount = meta.get<uint>();
+		for (uint k = 0; k < boneCount; ++k) {
+			//owned by _out right away, so a throwing read leaves nothing behind
+			Bone* b = new Bone();
+			_out->boneCache[i].emplace_back(b);
+			b->id = meta.getString();
+			b->offset = meta.get<Mat4>();
+			b->numWeights = meta.get<uint>();
+			b->weights.resize(b->numWeights);
+			for (uint j = 0; j < b->numWeights; ++j) {
+				uint vertex = meta.get<uint>();
+				b->weights[j] = std::make_tuple(vertex, meta.get<float>());
+			}
+			b->parent = nullptr;
+			m->boneMap[StringId::intern(b->id)] = b;
+		}
+	}
 
+	uint nodeCount = meta.get<uint>();
+	_out->nodeCache.resize(nodeCount);
+	for (uint i = 0; i < nodeCount; ++i) {
+		mNode* n = new mNode();
+		_out->nodeCache[i] = n;
+		n->id = meta.getString();
+		n->transform = meta.get<Mat4>();
+		int parent = meta.get<int>();
+		if (parent >= static_cast<int>(i)) throw new std::exception("cooked model node hierarchy corrupt");
+		n->parent = parent < 0 ? nullptr : _out->nodeCache[parent];
+		if (n->parent != nullptr) n->parent->children.emplace_back(n);
+		else _out->root = n;
+		meta.getVector(n->meshes);
+		_out->nodeMap[StringId::intern(n->id)] = n;
+	}
 
+	uint animationCount = meta.get<uint>();
+	for (uint i = 0; i < animationCount; ++i) {
+		Animation* a = new Animation();
+		_out->animations.emplace_back(a);
+		a->id = meta.getString();
+		a->duration = meta.get<float>();
+		a->ticksPerSecond = meta.get<float>();
+		uint nodeChannels = meta.get<uint>();
+		for (uint k = 0; k < nodeChannels; ++k) {
+			NodeAnimation* c = new NodeAnimation();
+			a->nodeChannels.emplace_back(c);
+			c->affectedNode = meta.getString();
+			meta.getVector(c->positionKeys);
+			meta.getVector(c->quatKeys);
+			meta.getVector(c->scalingKeys);
+			c->preState = static_cast<AnimBehaviour>(meta.get<int>());
+			c->postState = static_cast<AnimBehaviour>(meta.get<int>());
+		}
+		uint meshChannels = meta.get<uint>();
+		for (uint k = 0; k < meshChannels; ++k) {
+			MeshAnimation* c = new MeshAnimation();
+			a->meshChannels.emplace_back(c);
+			c->affectedMesh = meta.getString();
+			meta.getVector(c->keys);
+		}
+	}
+	return true;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "MainStruct.hpp"
+#include "StringId.hpp"
 
 namespace Heerbann {
 
@@ -73,15 +74,40 @@ namespace Heerbann {
 		std::vector<MeshAnimation*> meshChannels;
 	};
 
+	//---------------------- PackedVertex ----------------------\\
+
+	/*
+	model vertex, 16 bytes instead of 8 floats:
+	[position: unorm16 * 3 relative to the mesh bounds, 1 unused][normal: snorm16 * 2 octahedral][uv: half * 2]
+	the shaders dequantize with decodePosition & decodeNormal from include/vertex.glsl
+	*/
+	struct PackedVertex {
+		ushort position[4];
+		short normal[2];
+		ushort uv[2];
+
+		//object space position, bounds min, bounds extent, unit normal, uv
+		static PackedVertex pack(const Vec3&, const Vec3&, const Vec3&, const Vec3&, const Vec2&);
+		//unit vector to the [-1, 1] square, the lower hemisphere folded over the diagonals
+		static Vec2 octahedral(const Vec3&);
+		//sets up attributes 0 - 2 of the bound vao for a bound buffer of PackedVertex
+		static void setupAttributes();
+	};
+
 	struct Mesh {
-		uint vertexOffset;
+		std::string id; //key in ModelData::meshMap
+		uint vertexOffset; //vertices
 		uint vertexCount;
 		uint indexOffset;
 		uint indexCount;
 		uint matIndex;
+		//box the positions are quantized in
+		Vec3 boundsMin = Vec3(0.f);
+		Vec3 boundsExtent = Vec3(1.f);
 
 		Bone* root;
-		std::unordered_map<std::string, Bone*> boneMap;
+		//keys are interned
+		FlatMap<StringId, Bone*> boneMap;
 	};
 
 	struct ModelData {
@@ -90,10 +116,10 @@ namespace Heerbann {
 		GLuint indexBuffer;
 		GLuint animBuffer;
 
-		SSBO* matBuffer;
+		SSBO* matBuffer = nullptr;
 
 		uint vertexBufferCacheSize; //elements
-		float* vertexBufferCache = nullptr;
+		PackedVertex* vertexBufferCache = nullptr;
 
 		uint indexBufferCacheSize; //elements
 		unsigned int* indexBufferCache = nullptr;
@@ -104,20 +130,66 @@ namespace Heerbann {
 		uint metaCacheSize; //elements
 		char* metaCache = nullptr;
 
-		std::unordered_map<std::string, Mesh*> meshMap;
+		//keys are interned
+		FlatMap<StringId, Mesh*> meshMap;
 		std::vector<Mesh*> meshList;
 
 		std::vector<std::vector<Bone*>> boneCache;
 
-		mNode* root;
+		mNode* root = nullptr;
+		//parents always come before their children
 		std::vector<mNode*> nodeCache;
-		std::unordered_map<std::string, mNode*> nodeMap;
+		FlatMap<StringId, mNode*> nodeMap;
 
+		//backing store of matBuffer
+		std::vector<Material> materials;
+		std::vector<Animation*> animations;
+
+		//frees the meshes, bones, nodes & animations. the vertex & index caches are left to the owner,
+		//they may point into a mapping
+		~ModelData();
 	};
 
 	struct DrawCall {
 		GLuint vao;
 		uint count, offset;
+		//bounds of the mesh, undo the position quantization
+		Vec3 boundsMin = Vec3(0.f);
+		Vec3 boundsExtent = Vec3(1.f);
+
+		//vec3 uniforms at _location (min) & _location + 1 (extent)
+		void bindDequantization(uint) const;
+	};
+
+	//---------------------- ModelCache ----------------------\\
+
+	/*
+	cooked models, written after the first import so later runs skip assimp:
+	[CookedModelHeader][vertices][indices][meta: materials, meshes, nodes, animations]
+	vertices & indices are 64 byte aligned so the mapping can go straight into glBufferData
+	*/
+	#define MODEL_CACHE_VERSION 4
+
+	struct CookedModelHeader {
+		char magic[4];
+		uint version;
+		//hash of the source file, a changed source invalidates the cooked file
+		unsigned long long sourceHash;
+		unsigned long long vertexOffset;
+		unsigned long long vertexCount; //PackedVertex
+		unsigned long long indexOffset;
+		unsigned long long indexCount;
+		unsigned long long metaOffset;
+		unsigned long long metaSize;
+	};
+
+	class ModelCache {
+	public:
+		static unsigned long long hash(const char*, size_t);
+		//fills _out from the cooked file if it matches the hash. vertexBufferCache & indexBufferCache
+		//point into _file afterwards, it has to stay open until they are uploaded
+		static bool read(const std::string&, unsigned long long, ModelData*, MappedFile&);
+		static bool write(const std::string&, unsigned long long, ModelData*);
 	};
 	
 }
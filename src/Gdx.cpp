@@ -16,26 +16,18 @@ void Environment::initialize() {
 	orthoLightCam = M_View->create("orthoLightCam", ViewType::ortho, false);
 	persLightCam = M_View->create("persLightCam", ViewType::pers, false);
 
-	glGenBuffers(2, dLightBuffer);
-	for (uint i = 0; i < 2; ++i) {
-		glBindBuffer(GL_SHADER_STORAGE_BUFFER, dLightBuffer[i]);
-		glBufferStorage(GL_SHADER_STORAGE_BUFFER, MAXDYNAMICLIGHTS * sizeof(sLight) + 4 * sizeof(float), nullptr,
-			GL_MAP_PERSISTENT_BIT | GL_MAP_WRITE_BIT);
-		dLightPntr[i] = reinterpret_cast<float*>(glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, MAXDYNAMICLIGHTS * sizeof(sLight) + sizeof(uint),
-			GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT));
-		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-	}
-
 	GLError("Environment initialization");
 }
 
 void Environment::rebuildLight() {
-	dlightI = (dlightI + 1) % 2;
-	dLightPntr[dlightI][0] = static_cast<float>(dLights.size());
-	for (uint i = 0; i < dLights.size(); ++i) {
-		Light* l = dLights[i];
-		std::memcpy(dLightPntr[dlightI] + 4 + i * sizeof(sLight)/sizeof(float), static_cast<float*>(static_cast<void*>(l->light)), sizeof(sLight));
-	}
+	StreamBuffer* stream = M_Stream(StreamUsage::storage);
+	if (stream == nullptr) return;
+	const uint count = std::min(static_cast<uint>(dLights.size()), MAXDYNAMICLIGHTS);
+	dLightRange = stream->allocate(4 * sizeof(float) + count * sizeof(sLight), alignof(Vec4));
+	float* data = dLightRange.as<float>();
+	data[0] = static_cast<float>(count);
+	for (uint i = 0; i < count; ++i)
+		std::memcpy(data + 4 + i * sizeof(sLight) / sizeof(float), dLights[i]->light, sizeof(sLight));
 }
 
 void Environment::update() {
@@ -107,17 +99,21 @@ Light* Environment::getLight(std::string _id) {
 	return nullptr;
 }
 
-std::vector<Light*> Environment::queryLights(View*) {
-	return dLights; //TODO
+Light** Environment::queryLights(View*, uint& _count) {
+	//TODO cull against the view
+	_count = static_cast<uint>(dLights.size());
+	Light** out = M_Arena->alloc<Light*>(_count);
+	std::copy(dLights.begin(), dLights.end(), out);
+	return out;
 }
 
 void Environment::bindLights(uint _binding) {
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, _binding, getDLights());
-	GLError("Environment::bindLights");
+	if (dLightRange.pntr == nullptr) return;
+	M_Stream(StreamUsage::storage)->bindRange(_binding, dLightRange);
 }
 
-GLuint Environment::getDLights() {
-	return dLightBuffer[dlightI];
+const StreamRange& Environment::getDLights() {
+	return dLightRange;
 }
 
 float Light::radius(float _cutOff) {
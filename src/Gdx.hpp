@@ -1,6 +1,7 @@
 #pragma once
 
 #include "MainStruct.hpp"
+#include "StreamBuffer.hpp"
 
 namespace Heerbann {
 
@@ -16,9 +17,8 @@ namespace Heerbann {
 		View* orthoLightCam;
 		View* persLightCam;
 
-		GLuint dLightBuffer[2];
-		float* dLightPntr[2];
-		uint dlightI = 0;
+		//count followed by the dynamic lights, rewritten every frame into the storage stream
+		StreamRange dLightRange;
 
 		AABBTree* staticGeometry;
 		AABBTree* dynamicGeometry;
@@ -41,10 +41,12 @@ namespace Heerbann {
 		sLight* removeLight(std::string, bool);
 		Light* getLight(std::string);
 
-		std::vector<Light*> queryLights(View*);
+		//lights affecting the view, allocated in the FrameArena so they are valid until the next flip
+		Light** queryLights(View*, uint&);
 		
 		void bindLights(uint);
-		GLuint getDLights();
+		//empty before the first update
+		const StreamRange& getDLights();
 	};
 
 	struct sLight {
@@ -8,8 +8,8 @@ void InputMultiplexer::update() {
 		std::sort(o.begin(), o.end(), sort);
 }
 
-void InputMultiplexer::add(std::string _id, InputEntry* _entry) {
-	entries_cache[_id] = _entry;
+void InputMultiplexer::add(const std::string& _id, InputEntry* _entry) {
+	entries_cache[StringId::intern(_id)] = _entry;
 	if (_entry->keyPressEvent != nullptr)
 		entries[0].emplace_back(_entry);
 
@@ -60,13 +60,14 @@ void InputMultiplexer::add(std::string _id, InputEntry* _entry) {
 	update();
 }
 
-void InputMultiplexer::remove(std::string _id) {
+void InputMultiplexer::remove(StringId _id) {
 	remove(operator[](_id));
+	entries_cache.erase(_id);
 }
 
 void InputMultiplexer::remove(InputEntry* _entry) {
 	if (_entry == nullptr) return;
-	for (int i = 0; i <= 21; ++i) {
+	for (size_t i = 0; i < entries.size(); ++i) {
 		auto& o = entries[i];
 		for (auto it = o.begin(); it < o.end(); ++it)
 			if (*it == _entry) {
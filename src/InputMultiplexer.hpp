@@ -1,6 +1,7 @@
 #pragma once
 
 #include "MainStruct.hpp"
+#include "StringId.hpp"
 
 namespace Heerbann {
 
@@ -115,7 +116,7 @@ namespace Heerbann {
 
 	class InputMultiplexer {
 	private:
-		std::unordered_map<std::string, InputEntry*> entries_cache;
+		FlatMap<StringId, InputEntry*> entries_cache;
 
 		//0 - keyPressEvent
 		//1 - keyReleaseEvent
@@ -148,14 +149,13 @@ namespace Heerbann {
 		void update();
 
 	public:
-		void add(std::string, InputEntry*);
+		void add(const std::string&, InputEntry*);
 
-		InputEntry* operator[](std::string _id) {
-			if (entries_cache.count(_id) == 0) return nullptr;
-			return entries_cache[_id];
+		InputEntry* operator[](StringId _id) {
+			return entries_cache.get(_id);
 		};
 	
-		void remove(std::string);
+		void remove(StringId);
 		void remove(InputEntry*);
 
 		bool fire(sf::Event&);
@@ -9,6 +9,7 @@
 #include "AI.hpp"
 #include "InputMultiplexer.hpp"
 #include "Gdx.hpp"
+#include "G3D.hpp"
 
 using namespace Heerbann;
 using namespace UI;
@@ -124,7 +125,6 @@ void PreLoadLevel::preLoad() {
 
 	assetToLoad.emplace_back(new LoadItem("assets/shader/simple forward/sb_sf", Type::shader));
 	assetToLoad.emplace_back(new LoadItem("assets/shader/simple forward/sb_sf_vsm", Type::shader));
-	assetToLoad.emplace_back(new LoadItem("assets/shader/simple forward/sb_sf_vsm_notex", Type::shader));
 	assetToLoad.emplace_back(new LoadItem("assets/shader/simple forward/sb_vsm", Type::shader));
 	assetToLoad.emplace_back(new LoadItem("assets/shader/simple forward/sb_vsm", Type::shader));
 	assetToLoad.emplace_back(new LoadItem("assets/shader/simple forward/sb_sf_blur", Type::shader));
@@ -132,28 +132,17 @@ void PreLoadLevel::preLoad() {
 	assetToLoad.emplace_back(new LoadItem("assets/shader/voxel/shader_voxel_builder", Type::shader));
 	assetToLoad.emplace_back(new LoadItem("assets/shader/voxel/shader_voxel_draw", Type::shader));
 
+	//the other define sets that get drawn, so no permutation compiles on its first frame.
+	//the ids have to match the ones the renderers request
+	ShaderProgram::variant("assets/shader/simple forward/sb_sf_vsm", { "HAS_TEXTURE" });
+	ShaderProgram::variant("shader/vsm/shader_vsm_s2_light");
+	ShaderProgram::variant("shader/vsm/shader_vsm_s2_light", { "HAS_TEXTURE" });
+
 	//assetToLoad.emplace_back(new LoadItem("assets/fonts/black.ttf", Type::font));
 
 	
-	std::vector<std::string> postfix;
-	postfix.emplace_back("_ao.png");
-	postfix.emplace_back("_basecolor.png");
-	postfix.emplace_back("_height.png");
-	postfix.emplace_back("_normal.png");
-	postfix.emplace_back("_roughness.png");
-
-	for (auto pf : postfix) {	
-		assetToLoad.emplace_back(new LoadItem("assets/tex/forest_soil" + pf, Type::image_png));
-		assetToLoad.emplace_back(new LoadItem("assets/tex/forest_cliff" + pf, Type::image_png));
-		assetToLoad.emplace_back(new LoadItem("assets/tex/forest_dirt" + pf, Type::image_png));
-		assetToLoad.emplace_back(new LoadItem("assets/tex/forest_grass" + pf, Type::image_png));
-		assetToLoad.emplace_back(new LoadItem("assets/tex/forest_moss" + pf, Type::image_png));
-		assetToLoad.emplace_back(new LoadItem("assets/tex/forest_mud" + pf, Type::image_png));
-		assetToLoad.emplace_back(new LoadItem("assets/tex/forest_road" + pf, Type::image_png));
-		assetToLoad.emplace_back(new LoadItem("assets/tex/forest_rock" + pf, Type::image_png));
-		assetToLoad.emplace_back(new LoadItem("assets/tex/forest_wet_mud" + pf, Type::image_png));
-	}
-	
+	//the terrain layers are loaded by the Array2DTextures in TestWorldLevel::postLoad
+
 	//assetToLoad.emplace_back(new LoadItem("assets/shader/bg_shader", Type::shader));
 
 	//assetToLoad.emplace_back(new LoadItem("assets/shader/bg_shader", Type::shader));
@@ -230,6 +219,8 @@ void TestWorldLevel::load() {
 }
 
 void TestWorldLevel::postLoad() {	
+	//pure render test, headless there is nothing to set up
+	if (!App::Main::hasGL()) return;
 	//world->finalize(bgShader, treeShader);
 	//Main::getAI()->create();
 	//bgShader = reinterpret_cast<ShaderProgram*>(Main::getAssetManager()->getAsset("assets/shader/bg_shader")->data);
@@ -273,46 +264,20 @@ void TestWorldLevel::postLoad() {
 	*/
 
 	floorModel = new Model();
-	
-	Mesh* floorMesh = new Mesh();
-	floorMesh->indexCount = 6;
-	floorMesh->indexOffset = 0;
-	floorModel->meshList.emplace_back(floorMesh);
-
-	float col = M_FloatBits(sf::Color::Green);
-
-	float vertices[] = {
-		5000.f,
-		0.0f,
-		5000.f,
-		0.f,
-		1.f,
-		0.f,
-		col,
-
-		5000.f,
-		0.0f,
-		-5000.f,
-		0.f,
-		1.f,
-		0.f,
-		col,
-
-		-5000.f,
-		0.0f,
-		-5000.f,
-		0.f,
-		1.f,
-		0.f,
-		col,
-
-		-5000.f,
-		0.0f,
-		5000.f,
-		0.f,
-		1.f,
-		0.f,
-		col
+
+	//packed like the model vertices, the shadow & light passes only take PackedVertex
+	DrawCall floorCall;
+	floorCall.count = 6;
+	floorCall.offset = 0;
+	floorCall.boundsMin = Vec3(-5000.f, 0.f, -5000.f);
+	floorCall.boundsExtent = Vec3(10000.f, 0.f, 10000.f);
+
+	const Vec3 up(0.f, 1.f, 0.f);
+	PackedVertex vertices[] = {
+		PackedVertex::pack(Vec3(5000.f, 0.f, 5000.f), floorCall.boundsMin, floorCall.boundsExtent, up, Vec2(1.f, 1.f)),
+		PackedVertex::pack(Vec3(5000.f, 0.f, -5000.f), floorCall.boundsMin, floorCall.boundsExtent, up, Vec2(1.f, 0.f)),
+		PackedVertex::pack(Vec3(-5000.f, 0.f, -5000.f), floorCall.boundsMin, floorCall.boundsExtent, up, Vec2(0.f, 0.f)),
+		PackedVertex::pack(Vec3(-5000.f, 0.f, 5000.f), floorCall.boundsMin, floorCall.boundsExtent, up, Vec2(0.f, 1.f))
 	};
 
 	unsigned int indices[] = { 
@@ -320,13 +285,13 @@ void TestWorldLevel::postLoad() {
 		1, 2, 3   
 	};
 
-	glGenVertexArrays(1, &floorModel->vao);
+	glGenVertexArrays(1, &floorCall.vao);
 
 	GLuint index, vertex;
 	glGenBuffers(1, &index);
 	glGenBuffers(1, &vertex);
 
-	glBindVertexArray(floorModel->vao);
+	glBindVertexArray(floorCall.vao);
 
 	glBindBuffer(GL_ARRAY_BUFFER, vertex);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
@@ -334,14 +299,7 @@ void TestWorldLevel::postLoad() {
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
-	glEnableVertexAttribArray(0); //a_Pos
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)0);
-
-	glEnableVertexAttribArray(1); //a_norm
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)(3 * sizeof(float)));
-
-	glEnableVertexAttribArray(2); //a_Col
-	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, 7 * sizeof(float), (void*)(6 * sizeof(float)));
+	PackedVertex::setupAttributes();
 
 	glBindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -362,12 +320,19 @@ void TestWorldLevel::postLoad() {
 
 	drawable_2 = new VSMRenderable();
 	drawable_2->hasTex = false;
-	drawable_2->vao = floorModel->vao;
-	drawable_2->count = floorMesh->indexCount;
-	drawable_2->offset = floorMesh->indexOffset;
+	drawable_2->drawC = floorCall;
 	drawable_2->model = floorModel;
 	drawable_2->shadowTex = sl->shadowMap->getTex("color");
 
+	//both live in the world, it submits them to its renderer every frame
+	EntityStore* entities = M_World->getEntities();
+	Entity deer = M_World->create("deer");
+	entities->add<Transform>(deer);
+	entities->add<RenderComponent>(deer, RenderComponent{ *drawable_1 });
+	Entity ground = M_World->create("floor");
+	entities->add<Transform>(ground);
+	entities->add<RenderComponent>(ground, RenderComponent{ *drawable_2 });
+
 	//textureblocks
 	
 	std::vector<std::string> files;
@@ -382,89 +347,28 @@ void TestWorldLevel::postLoad() {
 	files.emplace_back("assets/tex/forest_wet_mud");
 
 	std::vector<std::string> postFix;
-	postFix.emplace_back("_ao.png");
-	postFix.emplace_back("_basecolor.png");
-	postFix.emplace_back("_height.png");
-	postFix.emplace_back("_normal.png");
-	postFix.emplace_back("_roughness.png");
-
-	tex = new GLuint[5];
-	glGenTextures(5, tex);
-	for (uint i = 0; i < 5; ++i) {
-		glBindTexture(GL_TEXTURE_2D_ARRAY, tex[i]);
-		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		GLuint internalFormat, format, type;
-		uint texSize = POW(2048, 2) * files.size();
-	
-		switch (i) {
-			case 0: //_ao
-			{
-				format = GL_RED;
-				internalFormat = GL_R16;
-				type = GL_UNSIGNED_SHORT;
-			}
-			break;
-			case 1://_basecolor
-			{
-				format = GL_RGBA;
-				internalFormat = GL_RGBA8;
-				type = GL_UNSIGNED_BYTE;
-			}
-			break;
-			case 2://_height
-			{
-				format = GL_RED;
-				internalFormat = GL_R16;
-				type = GL_UNSIGNED_SHORT;
-			}
-			break;
-			case 3://_normal
-			{
-				format = GL_RGBA;
-				internalFormat = GL_RGBA8;
-				type = GL_UNSIGNED_BYTE;
-			}
-			break;
-			case 4://_roughness
-			{
-				format = GL_RED;
-				internalFormat = GL_R16;
-				type = GL_UNSIGNED_SHORT;
-			}
-			break;			
-		}
-
-		glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, internalFormat, 2048, 2048, 9);
-		GLError("TestWorldLevel::postLoad");
-		for (uint k = 0; k < files.size(); ++k) {
-			auto file = M_Asset->getAsset(files[k] + postFix[i]);
-			std::cout << files[k] + postFix[i] << std::endl;
-			sf::Image* image = reinterpret_cast<sf::Image*>(file->data);
-			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, k, 2048, 2048, 1, format, type, image->getPixelsPtr());
-			GLError("TestWorldLevel::postLoad");
-			delete file->data;			
-		}
-
-		//glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
-		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
-		GLError("TestWorldLevel::postLoad");
+	postFix.emplace_back("_ao");
+	postFix.emplace_back("_basecolor");
+	postFix.emplace_back("_height");
+	postFix.emplace_back("_normal");
+	postFix.emplace_back("_roughness");
+
+	//layers cooked with --cook are block compressed with a full mip chain, the pngs are the fallback
+	AssetFile probe;
+	const bool cooked = probe.open(files[0] + postFix[0] + ".rtex");
+	probe.close();
+
+	for (uint i = 0; i < postFix.size(); ++i) {
+		std::vector<std::string> layers;
+		for (auto& f : files)
+			layers.emplace_back(f + postFix[i] + (cooked ? ".rtex" : ".png"));
+		//sf::Image hands out rgba8, the single channel maps only keep red
+		GLint internalFormat = (i == 1 || i == 3) ? GL_RGBA8 : GL_R8;
+		MipContent mips = i == 1 ? MipContent::color : i == 3 ? MipContent::normal : MipContent::linear;
+		tex[i] = new Array2DTexture("terrain" + postFix[i], layers, 1, GL_TEXTURE_2D_ARRAY, 0, internalFormat, GL_RGBA, GL_UNSIGNED_BYTE, mips);
 	}
 
-	LoadItem* item = new LoadItem("bgTex", Type::texture_png);
-	item->isLoaded = true;
-	item->isLocked = false;
-	item->data = tex;
-
-	M_Asset->addAsset(item);
-
-	
-
-	WorldBuilderDefinition* wdef = new WorldBuilderDefinition();
-
+	WorldBuilderDefinition wdef;
 	M_World->build(wdef);
 
 	debug = new TextureDebugRenderer();
@@ -483,17 +387,17 @@ void TestWorldLevel::update() {
 	Vec2 tmp = NOR(Vec2(newX, newY)) * -1.f;
 	//sun->direction = Vec4(tmp.x, tmp.y, 0.f, 0.f);
 
-
-	view->clear(sf::Color::White);
-	view->apply();	
-
 	//vsm->add(drawable_1);
 	//vsm->add(drawable_2);
+
+	M_World->update();
 }
 
 void TestWorldLevel::draw() {
-	M_World->draw(view, vsm);
-	vsm->draw(view);
-	//debug->draw(tex[1], GL_TEXTURE_2D_ARRAY, 6, 2048, 2048, 0, 2048, 2048);
+	//update runs zero or more times per frame, so the view is set up here
+	view->clear(sf::Color::White);
+	view->apply();
+	M_World->draw(view);
+	//debug->draw(tex[1]->get(), GL_TEXTURE_2D_ARRAY, 6, 2048, 2048, 0, 2048, 2048);
 }
 
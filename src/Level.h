@@ -26,6 +26,7 @@ namespace Heerbann {
 
 	struct LoadingScreenLevel : public Level {
 		LoadingScreenLevel() : Level("LoadingScreenLevel") {};
+		~LoadingScreenLevel() { destroy(); };
 
 		Label* label;
 
@@ -36,6 +37,7 @@ namespace Heerbann {
 
 	struct MainMenuLevel : public Level {
 		MainMenuLevel() : Level("MainMenuLevel") {};
+		~MainMenuLevel() { destroy(); };
 
 		void load() override;
 		void unload() override;
@@ -56,7 +58,7 @@ namespace Heerbann {
 		VSMRenderable* drawable_2;
 
 		TextureDebugRenderer* debug;
-		GLuint* tex;
+		Array2DTexture* tex[5];
 
 		Model* model, *floorModel;
 		sf::Texture* mTex;
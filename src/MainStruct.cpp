@@ -13,38 +13,69 @@
 #include "TimeLog.hpp"
 #include "Gdx.hpp"
 #include "World.hpp"
+#include "StreamBuffer.hpp"
+#include "UploadRing.hpp"
 
 using namespace Heerbann;
 using namespace App;
 
-Main::Main() {}
+Main::Main() {
+	//outside of intialize, setSeed & getRandom are usable before the window exists
+	random = new RandomService();
+}
 
 Main::~Main() {
+	//needs the context
+	for (auto s : streams)
+		if (s != nullptr) delete s;
+	if (uploads != nullptr) delete uploads;
+	delete offscreen;
+	delete pacer;
+	delete jobs;
+	delete arena;
+	delete random;
 	delete batch;
 	if(indexBuffer != nullptr) delete indexBuffer;
 }
 
 void Main::update() {
 	++frameId;
-
-	// if true is returned job is removed
-	while (!loadJob.empty()) {
-		std::tuple tuple = loadJob.front();		
-		if(std::get<0>(tuple)(std::get<1>(tuple)));
-			loadJob.pop();
-	}
+	arena->flip();
+	//fences everything drawn from the streams last frame
+	for (auto s : streams)
+		if (s != nullptr) s->flip();
+	if (uploads != nullptr) uploads->update();
+	assets->update();
+	jobs->runGLJobs(true);
 }
 
 void Main::intialize(MainConfig* _config) {
 
-	context = new sf::RenderWindow();
-	context->create(sf::VideoMode(_config->windowWidth, _config->windowHeight, 32), _config->name, _config->windowStyle, _config->settings);
-	//context->setVerticalSyncEnabled(true);
-	context->setFramerateLimit(60);	
-
+	headless = _config->headless;
+	size = sf::Vector2u(_config->windowWidth, _config->windowHeight);
+	if (!headless) {
+		context = new sf::RenderWindow();
+		context->create(sf::VideoMode(_config->windowWidth, _config->windowHeight, 32), _config->name, _config->windowStyle, _config->settings);
+		//pacing is done by the FramePacer, sfml's limiter would sleep on top of it
+		context->setFramerateLimit(0);
+		context->setVerticalSyncEnabled(_config->pacing == FramePacing::vsync);
+	} else if (_config->offscreenContext)
+		offscreen = new sf::Context(_config->settings, _config->windowWidth, _config->windowHeight);
+	glAvailable = context != nullptr || offscreen != nullptr;
+	//headless there is nothing to present, so the sim just runs as fast as it can
+	pacer = new FramePacer(headless ? FramePacing::freerun : _config->pacing, _config->frameCap, _config->fixedStep, _config->maxSimSteps);
+
+	jobs = new JobScheduler(_config->workerThreads);
+	jobs->setGLBudget(_config->glBudgetMs, _config->glBudgetBytes, _config->glBudgetPrograms);
+	arena = new FrameArena(_config->frameArenaSize);
 	inputListener = new InputMultiplexer();
-	world = new VoxelWorld();
 	assets = new AssetManager();
+	for (auto& a : _config->archives)
+		assets->mount(a);
+	assets->setMaxInFlight(_config->assetsInFlight != 0 ? _config->assetsInFlight : std::max(2u, 2u * jobs->workerCount()));
+	assets->getShaderCache()->initialize(glAvailable ? _config->shaderCache : "");
+	//its renderer is a ressource, so the world comes after the asset manager
+	world = new World();
 	stage = new UI::Stage();
 	level = new LevelManager();
 	timer = new Timer();
@@ -65,26 +96,37 @@ void Main::intialize(MainConfig* _config) {
 		indexBuffer[i * 6 + ++k] = 4 * i;
 	}
 	
-	glewExperimental = GL_TRUE;
-	auto status = glewInit();
-	if (!status == GLEW_OK) {
-		std::cout << "glew not ok" << std::endl;
+	if (glAvailable) {
+		glewExperimental = GL_TRUE;
+		auto status = glewInit();
+		if (!status == GLEW_OK) {
+			std::cout << "glew not ok" << std::endl;
+		}
 	}
 
 	//------------- Everything needing openGl goes below this line -------------\\
 
-	//glEnable(GL_BLEND);
-	//glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glEnable(GL_DEPTH_TEST);
-	glDepthMask(GL_TRUE);
-	glDepthFunc(GL_LEQUAL);
-	glDepthRange(0.0f, 1.0f);
-
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
-	glFrontFace(GL_CCW);
-	//glEnable(GL_SCISSOR_TEST);
+	if (glAvailable) {
+		//glEnable(GL_BLEND);
+		//glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glEnable(GL_DEPTH_TEST);
+		glDepthMask(GL_TRUE);
+		glDepthFunc(GL_LEQUAL);
+		glDepthRange(0.0f, 1.0f);
+
+		glEnable(GL_CULL_FACE);
+		glCullFace(GL_BACK);
+		glFrontFace(GL_CCW);
+		//glEnable(GL_SCISSOR_TEST);
+
+		for (uint i = 0; i < 4; ++i)
+			if (_config->streamSizes[i] != 0)
+				streams[i] = new StreamBuffer(static_cast<StreamUsage>(i), _config->streamSizes[i]);
+		if (_config->uploadRingSize != 0)
+			uploads = new UploadRing(_config->uploadRingSize);
+	}
 	
+	//without gl the AssetManager skips glLoad, see Ressource::headlessLoad
 	new ShaderProgram("assets/shader/spritebatch/sb_sprite");
 	new Font("assets/fonts/default.ttf");
 
@@ -105,7 +147,7 @@ void Main::intialize(MainConfig* _config) {
 	//batch = new SpriteBatch(_config->MAXSPRITES);
 	
 	level->initialize();
-	env->initialize();
+	if (glAvailable) env->initialize();
 
 	//aiHandler = new AI::AIHandler();
 	
@@ -116,6 +158,14 @@ Main* App::Main::getInstance() {
 	return instance;
 }
 
+bool App::Main::isHeadless() {
+	return instance->headless;
+}
+
+bool App::Main::hasGL() {
+	return instance->glAvailable;
+}
+
 std::wstring Util::s2ws(const char* _in) {
 	return s2ws(std::string(_in));
 }
@@ -138,25 +188,515 @@ std::vector<std::wstring> Util::split(std::wstring _in, std::wstring _del) {
 
 //---------------------- Job ----------------------\\
 
-void Main::addJob(std::function<void(void*)> _job, void* _entry) {
-	std::lock_guard<std::mutex> guard(instance->jobLock);
-	instance->loadJob.emplace(std::make_tuple(_job, _entry));
+void Main::addJob(std::function<bool(void*)> _job, void* _entry) {
+	instance->jobs->addFrameJob([_job, _entry]()->bool {
+		return _job(_entry);
+	});
+}
+
+JobScheduler* Main::getJobs() {
+	return instance->jobs;
+}
+
+FrameArena* Main::getArena() {
+	return instance->arena;
+}
+
+StreamBuffer* Main::getStream(StreamUsage _usage) {
+	return instance->streams[static_cast<uint>(_usage)];
+}
+
+UploadRing* Main::getUploads() {
+	return instance->uploads;
+}
+
+//-1 on every thread that is not a worker
+thread_local int workerIndex = -1;
+
+JobScheduler::JobScheduler(uint _workers) {
+	if (_workers == 0) {
+		uint hw = std::thread::hardware_concurrency();
+		_workers = hw > 1 ? hw - 1 : 1;
+	}
+	workers.resize(_workers);
+	for (uint i = 0; i < _workers; ++i)
+		workers[i] = new Worker();
+	for (uint i = 0; i < _workers; ++i)
+		workers[i]->thread = std::thread(&JobScheduler::workerLoop, this, i);
+}
+
+JobScheduler::~JobScheduler() {
+	running = false;
+	sleep.notify_all();
+	for (auto w : workers) {
+		w->thread.join();
+		delete w;
+	}
+}
+
+void JobScheduler::workerLoop(uint _index) {
+	workerIndex = static_cast<int>(_index);
+	while (running) {
+		JobHandle job = pop(_index);
+		if (job == nullptr) {
+			std::unique_lock<std::mutex> guard(sleepLock);
+			sleep.wait_for(guard, 1ms, [&]()->bool { return queued > 0 || !running; });
+			continue;
+		}
+		execute(job);
+	}
+}
+
+JobHandle JobScheduler::submit(std::function<bool()> _work, std::initializer_list<JobHandle> _dependencies, Job::Lane _lane) {
+	return submit(_work, std::vector<JobHandle>(_dependencies), _lane);
+}
+
+JobHandle JobScheduler::submit(std::function<bool()> _work, const std::vector<JobHandle>& _dependencies, Job::Lane _lane) {
+	JobHandle job = std::make_shared<Job>();
+	job->work = _work;
+	job->lane = _lane;
+	return enqueue(job, _dependencies);
+}
+
+JobHandle JobScheduler::enqueue(const JobHandle& _job, const std::vector<JobHandle>& _dependencies) {
+	++outstanding;
+	for (auto& dep : _dependencies) {
+		if (dep == nullptr) continue;
+		std::lock_guard<std::mutex> guard(dep->lock);
+		if (dep->done) continue;
+		++_job->pending;
+		dep->continuations.emplace_back(_job);
+	}
+	release(_job);
+	return _job;
+}
+
+JobHandle JobScheduler::then(const JobHandle& _job, std::function<bool()> _work, Job::Lane _lane) {
+	return submit(_work, { _job }, _lane);
+}
+
+JobHandle JobScheduler::submitGL(std::function<bool()> _work, std::function<GLCost()> _estimate, std::initializer_list<JobHandle> _dependencies) {
+	JobHandle job = std::make_shared<Job>();
+	job->work = _work;
+	job->estimate = _estimate;
+	job->lane = Job::gl;
+	return enqueue(job, std::vector<JobHandle>(_dependencies));
+}
+
+void JobScheduler::addFrameJob(std::function<bool()> _work) {
+	JobHandle job = std::make_shared<Job>();
+	job->work = _work;
+	job->lane = Job::gl;
+	job->tracked = false;
+	release(job);
+}
+
+void JobScheduler::release(const JobHandle& _job) {
+	if (--_job->pending == 0)
+		schedule(_job);
+}
+
+void JobScheduler::schedule(const JobHandle& _job) {
+	if (_job->lane == Job::gl) {
+		if (_job->estimate != nullptr)
+			_job->cost = _job->estimate();
+		std::lock_guard<std::mutex> guard(glLock);
+		glQueue.emplace_back(_job);
+		return;
+	}
+	//keep continuations on the worker that produced their input
+	uint index = workerIndex >= 0 ? static_cast<uint>(workerIndex) : next++ % workers.size();
+	{
+		std::lock_guard<std::mutex> guard(workers[index]->lock);
+		workers[index]->queue.emplace_back(_job);
+	}
+	++queued;
+	sleep.notify_one();
+}
+
+void JobScheduler::execute(const JobHandle& _job) {
+	if (_job->work()) {
+		finish(_job);
+		return;
+	}
+	//not done yet, give the other jobs a chance first
+	uint index = workerIndex >= 0 ? static_cast<uint>(workerIndex) : next++ % workers.size();
+	{
+		std::lock_guard<std::mutex> guard(workers[index]->lock);
+		workers[index]->queue.emplace_front(_job);
+	}
+	++queued;
+}
+
+void JobScheduler::finish(const JobHandle& _job) {
+	std::vector<JobHandle> continuations;
+	{
+		std::lock_guard<std::mutex> guard(_job->lock);
+		_job->done = true;
+		continuations.swap(_job->continuations);
+	}
+	for (auto& c : continuations)
+		release(c);
+	if (_job->tracked) --outstanding;
+}
+
+JobHandle JobScheduler::pop(uint _index) {
+	Worker* w = workers[_index];
+	{
+		std::lock_guard<std::mutex> guard(w->lock);
+		if (!w->queue.empty()) {
+			JobHandle job = w->queue.back();
+			w->queue.pop_back();
+			--queued;
+			return job;
+		}
+	}
+	return steal(_index);
+}
+
+JobHandle JobScheduler::steal(uint _thief) {
+	for (uint i = 1; i <= workers.size(); ++i) {
+		Worker* w = workers[(_thief + i) % workers.size()];
+		std::lock_guard<std::mutex> guard(w->lock);
+		if (w->queue.empty()) continue;
+		JobHandle job = w->queue.front();
+		w->queue.pop_front();
+		--queued;
+		return job;
+	}
+	return nullptr;
+}
+
+void JobScheduler::runGLJobs(bool _budgeted) {
+	std::vector<JobHandle> jobs;
+	{
+		std::lock_guard<std::mutex> guard(glLock);
+		jobs.swap(glQueue);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	unsigned long long bytes = 0;
+	uint programs = 0;
+	uint ran = 0;
+	bool exhausted = false;
+
+	std::vector<JobHandle> unfinished;
+	for (auto& job : jobs) {
+		//frame jobs are cheap and run every frame regardless of the budget
+		if (job->tracked) {
+			if (_budgeted && ran > 0) {
+				float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+				exhausted = exhausted || ms >= budgetMs
+					|| (budgetBytes > 0 && bytes + job->cost.bytes > budgetBytes)
+					|| (budgetPrograms > 0 && programs + job->cost.programs > budgetPrograms);
+			}
+			//keep the submission order, the rest is carried over to the next frame
+			if (exhausted) {
+				unfinished.emplace_back(job);
+				continue;
+			}
+			++ran;
+			bytes += job->cost.bytes;
+			programs += job->cost.programs;
+		}
+		if (job->work()) finish(job);
+		else {
+			//what is left of it, a job only polling on other loads doesn't eat the next budget
+			if (job->tracked && job->estimate != nullptr) job->cost = job->estimate();
+			unfinished.emplace_back(job);
+		}
+	}
+
+	if (_budgeted) {
+		std::lock_guard<std::mutex> guard(statsLock);
+		stats.ran = ran;
+		stats.deferred = 0;
+		for (auto& job : unfinished)
+			if (job->tracked) ++stats.deferred;
+		stats.bytes = bytes;
+		stats.ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	if (unfinished.empty()) return;
+	std::lock_guard<std::mutex> guard(glLock);
+	glQueue.insert(glQueue.begin(), unfinished.begin(), unfinished.end());
+}
+
+void JobScheduler::setGLBudget(float _ms, unsigned long long _bytes, uint _programs) {
+	budgetMs = _ms;
+	budgetBytes = _bytes;
+	budgetPrograms = _programs;
+}
+
+JobScheduler::GLStats JobScheduler::glStats() {
+	GLStats out;
+	{
+		std::lock_guard<std::mutex> guard(statsLock);
+		out = stats;
+	}
+	out.backlog = 0;
+	out.backlogBytes = 0;
+	out.backlogPrograms = 0;
+	std::lock_guard<std::mutex> guard(glLock);
+	for (auto& job : glQueue) {
+		if (!job->tracked) continue;
+		++out.backlog;
+		out.backlogBytes += job->cost.bytes;
+		out.backlogPrograms += job->cost.programs;
+	}
+	return out;
+}
+
+bool JobScheduler::runOne() {
+	JobHandle job = workerIndex >= 0 ? pop(static_cast<uint>(workerIndex)) : steal(next++ % workers.size());
+	if (job == nullptr) return false;
+	execute(job);
+	return true;
+}
+
+void JobScheduler::pump() {
+	while (busy()) {
+		if (!isWorker()) runGLJobs();
+		if (!runOne()) std::this_thread::yield();
+	}
+}
+
+void JobScheduler::wait(const JobHandle& _job) {
+	while (!_job->finished()) {
+		if (!isWorker()) runGLJobs();
+		if (!runOne()) std::this_thread::yield();
+	}
+}
+
+bool JobScheduler::busy() {
+	return outstanding > 0;
+}
+
+uint JobScheduler::workerCount() {
+	return static_cast<uint>(workers.size());
+}
+
+bool JobScheduler::isWorker() {
+	return workerIndex >= 0;
+}
+
+//---------------------- FrameArena ----------------------\\
+
+FrameArena::FrameArena(size_t _size) {
+	for (Buffer& b : buffers) {
+		b.data = new char[_size];
+		b.size = _size;
+	}
+}
+
+FrameArena::~FrameArena() {
+	for (Buffer& b : buffers) {
+		reset(b);
+		delete[] b.data;
+	}
+}
+
+void FrameArena::reset(Buffer& _buffer) {
+	size_t needed = _buffer.offset + _buffer.overflowBytes;
+	for (char* p : _buffer.overflow)
+		delete[] p;
+	_buffer.overflow.clear();
+	_buffer.overflowBytes = 0;
+	_buffer.offset = 0;
+	//grow to the largest frame seen so the next one fits into a single block again
+	if (needed > _buffer.size) {
+		delete[] _buffer.data;
+		_buffer.size = needed + needed / 4;
+		_buffer.data = new char[_buffer.size];
+	}
+}
+
+void FrameArena::flip() {
+	peak = std::max(peak, used());
+	current = (current + 1) % 2;
+	reset(buffers[current]);
+}
+
+void* FrameArena::alloc(size_t _size, size_t _align) {
+	assert((_align & (_align - 1)) == 0);
+	Buffer& b = buffers[current];
+	uintptr_t base = reinterpret_cast<uintptr_t>(b.data);
+	uintptr_t out = (base + b.offset + _align - 1) & ~static_cast<uintptr_t>(_align - 1);
+	if (out + _size <= base + b.size) {
+		b.offset = out + _size - base;
+		return reinterpret_cast<void*>(out);
+	}
+	//does not fit: the heap covers the rest of this frame, the buffer grows on its next reset
+	char* mem = new char[_size + _align];
+	b.overflow.emplace_back(mem);
+	b.overflowBytes += _size + _align;
+	out = (reinterpret_cast<uintptr_t>(mem) + _align - 1) & ~static_cast<uintptr_t>(_align - 1);
+	return reinterpret_cast<void*>(out);
+}
+
+size_t FrameArena::used() {
+	return buffers[current].offset + buffers[current].overflowBytes;
+}
+
+size_t FrameArena::peakUsage() {
+	return std::max(peak, used());
 }
 
 //---------------------- Random ----------------------\\
 
+inline unsigned long long rotl(unsigned long long _x, int _k) {
+	return (_x << _k) | (_x >> (64 - _k));
+}
+
+inline unsigned long long splitmix64(unsigned long long& _state) {
+	unsigned long long z = (_state += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+RandomStream::RandomStream(unsigned long long _seed) {
+	seed(_seed);
+}
+
+void RandomStream::seed(unsigned long long _seed) {
+	for (int i = 0; i < 4; ++i)
+		s[i] = splitmix64(_seed);
+}
+
+unsigned long long RandomStream::next() {
+	const unsigned long long result = s[0] + s[3];
+	const unsigned long long t = s[1] << 17;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 45);
+	return result;
+}
+
+float RandomStream::nextFloat() {
+	//upper 24 bits, the lower bits of xoshiro256+ are weak
+	return static_cast<float>(next() >> 40) * (1.f / 16777216.f);
+}
+
+float RandomStream::nextFloat(float _low, float _high) {
+	return _low + nextFloat() * (_high - _low);
+}
+
+uint RandomStream::nextUint(uint _bound) {
+	return static_cast<uint>(((next() >> 32) * _bound) >> 32);
+}
+
+void RandomStream::fill(float* _out, size_t _count, float _low, float _high) {
+	const float scale = (_high - _low) * (1.f / 16777216.f);
+	//structure of arrays so the compiler can keep the 4 lanes in simd registers
+	unsigned long long s0[4], s1[4], s2[4], s3[4];
+	for (int l = 0; l < 4; ++l) {
+		unsigned long long x = next();
+		s0[l] = splitmix64(x);
+		s1[l] = splitmix64(x);
+		s2[l] = splitmix64(x);
+		s3[l] = splitmix64(x);
+	}
+	size_t i = 0;
+	for (; i + 4 <= _count; i += 4) {
+		for (int l = 0; l < 4; ++l) {
+			_out[i + l] = _low + static_cast<float>(static_cast<int>((s0[l] + s3[l]) >> 40)) * scale;
+			const unsigned long long t = s1[l] << 17;
+			s2[l] ^= s0[l];
+			s3[l] ^= s1[l];
+			s1[l] ^= s2[l];
+			s0[l] ^= s3[l];
+			s2[l] ^= t;
+			s3[l] = rotl(s3[l], 45);
+		}
+	}
+	for (; i < _count; ++i)
+		_out[i] = _low + static_cast<float>(next() >> 40) * scale;
+}
+
+RandomService::RandomService(unsigned long long _seed) : seedValue(_seed), generation(0), nextSlot(1u << 16) {
+	mainThread = std::this_thread::get_id();
+}
+
+unsigned long long RandomService::mix(unsigned long long _a, unsigned long long _b) {
+	unsigned long long x = _a ^ (0x9e3779b97f4a7c15ull * (_b + 1));
+	return splitmix64(x);
+}
+
+void RandomService::setSeed(unsigned long long _seed) {
+	seedValue = _seed;
+	++generation;
+}
+
+unsigned long long RandomService::getSeed() {
+	return seedValue;
+}
+
+RandomStream RandomService::stream(unsigned long long _id, unsigned long long _sub) {
+	return RandomStream(mix(mix(seedValue, _id), _sub));
+}
+
+RandomStream RandomService::stream(const std::string& _name, unsigned long long _sub) {
+	//fnv-1a
+	unsigned long long hash = 0xcbf29ce484222325ull;
+	for (char c : _name) {
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 0x100000001b3ull;
+	}
+	return stream(hash, _sub);
+}
+
+RandomStream& RandomService::local() {
+	struct Local {
+		RandomStream stream;
+		unsigned int generation = ~0u;
+		unsigned int slot = ~0u;
+	};
+	thread_local Local l;
+	if (l.slot == ~0u) {
+		if (std::this_thread::get_id() == mainThread) l.slot = 0;
+		else if (workerIndex >= 0) l.slot = static_cast<unsigned int>(workerIndex) + 1;
+		else l.slot = nextSlot++;
+	}
+	unsigned int gen = generation;
+	if (l.generation != gen) {
+		//reserved id, system streams should use names
+		l.stream = stream(~0ull, l.slot);
+		l.generation = gen;
+	}
+	return l.stream;
+}
+
+void RandomService::parallelFill(float* _out, size_t _count, unsigned long long _id, float _low, float _high) {
+	const int chunks = static_cast<int>((_count + CHUNK - 1) / CHUNK);
+	const unsigned long long base = mix(seedValue, _id);
+#pragma omp parallel for schedule(static)
+	for (int c = 0; c < chunks; ++c) {
+		RandomStream s(mix(base, static_cast<unsigned long long>(c)));
+		size_t begin = static_cast<size_t>(c) * CHUNK;
+		s.fill(_out + begin, std::min(CHUNK, _count - begin), _low, _high);
+	}
+}
+
 void Main::setSeed(long _seed) {
-	instance->random.seed(_seed);
+	instance->random->setSeed(static_cast<unsigned long long>(_seed));
 }
 
 float Main::getRandom() {
-	return (float)((instance->random() >> 40) * 1.0 / (1L << 24));
+	return instance->random->local().nextFloat();
 }
 
 float Main::getRandom(float _low, float _high) {
 	return _low + getRandom() * (_high - _low);
 }
 
+RandomService* Main::getRandomService() {
+	return instance->random;
+}
+
 //---------------------- Context ----------------------\\
 
 sf::RenderWindow* Main::getContext() {
@@ -164,7 +704,8 @@ sf::RenderWindow* Main::getContext() {
 }
 
 void Main::setSize(unsigned int _width, unsigned int _height) {
-	getContext()->setSize(sf::Vector2u(_width, _height));
+	instance->size = sf::Vector2u(_width, _height);
+	if (getContext() != nullptr) getContext()->setSize(instance->size);
 }
 
 //---------------------- Inputs ----------------------\\
@@ -177,6 +718,10 @@ Timer* App::Main::getTimer() {
 	return getInstance()->timer;
 }
 
+FramePacer* App::Main::getPacer() {
+	return getInstance()->pacer;
+}
+
 Logger* App::Main::getLogger() {
 	return getInstance()->logger;
 }
@@ -191,7 +736,7 @@ InputMultiplexer* Main::getInput() {
 
 //---------------------- World ----------------------\\
 
-VoxelWorld* Main::getWorld() {
+World* Main::getWorld() {
 	return instance->world;
 }
 
@@ -218,7 +763,15 @@ GLuint* Main::getIndexBuffer() {
 }
 
 float App::Main::deltaTime() {
-	return 0.0f;
+	return pacer->delta();
+}
+
+float App::Main::fixedDeltaTime() {
+	return pacer->fixedDelta();
+}
+
+float App::Main::alpha() {
+	return pacer->alpha();
 }
 
 
@@ -31,6 +31,8 @@
 #include <condition_variable>
 #include <mutex>
 #include <queue>
+#include <deque>
+#include <memory>
 #include <vector>
 #include <atomic>
 #include <functional>
@@ -220,17 +222,25 @@ typedef glm::quat Quat;
 #define M_Font Heerbann::App::Get()->getFontCache()
 #define M_Stage Heerbann::App::Get()->getStage()
 #define M_Random Heerbann::App::Get()->getRandom()
+#define M_Rand Heerbann::App::Get()->getRandomService()
 #define M_View Heerbann::App::Get()->getViewport()
 #define M_World Heerbann::App::Get()->getWorld()
 #define M_Level Heerbann::App::Get()->getLevel()
 #define M_Context Heerbann::App::Get()->getContext()
 #define M_Timer Heerbann::App::Get()->getTimer()
+#define M_Pacer Heerbann::App::Get()->getPacer()
 #define M_Logger Heerbann::App::Get()->getLogger()
 #define M_Shape Heerbann::App::Get()->getShape()
 #define M_Env Heerbann::App::Get()->getEnv()
+#define M_Jobs Heerbann::App::Get()->getJobs()
+#define M_Arena Heerbann::App::Get()->getArena()
+#define M_Stream(X) Heerbann::App::Get()->getStream((X))
+#define M_Upload Heerbann::App::Get()->getUploads()
 
 #define ID Heerbann::App::Util::getId()
 #define DeltaTime Heerbann::App::Get()->deltaTime()
+#define FixedDeltaTime Heerbann::App::Get()->fixedDeltaTime()
+#define FrameAlpha Heerbann::App::Get()->alpha()
 #define DefaultFont Heerbann::App::Get()->getDefaultFont()
 
 #define TIMESTAMP Heerbann::App::Get()->getTimer()->timeStamp()
@@ -302,6 +312,27 @@ using namespace std::chrono_literals;
 	//Assets
 	enum Type : int;
 	struct Ressource;
+	//FileSystem
+	class MappedFile;
+	class PackArchive;
+	struct PackEntry;
+	class AssetFile;
+	//TextureCompression
+	enum class BlockFormat : uint;
+	class BlockCompressor;
+	class CookedTexture;
+	//MipChain
+	enum class MipContent : uint;
+	enum class MipFilter : uint;
+	class MipChain;
+
+	class LoadRequest;
+	template<class T>
+	class AssetRef;
+	struct AssetBudget;
+	struct Residency;
+	class ShaderPreprocessor;
+	class ShaderCache;
 	class AssetManager;
 	class Image;
 	class Texture2D;
@@ -310,6 +341,16 @@ using namespace std::chrono_literals;
 	class TextureAtlas;
 	class SSBO;
 	class FlipFlopSSBO;
+	//StreamBuffer
+	enum class StreamUsage : uint;
+	struct StreamRange;
+	class StreamBuffer;
+	//Atlas
+	class SkylinePacker;
+	class DynamicAtlas;
+	//UploadRing
+	struct UploadSlot;
+	class UploadRing;
 	class Model;
 	class ShaderProgram;
 	class Framebuffer;
@@ -334,6 +375,12 @@ using namespace std::chrono_literals;
 	//World
 	class VoxelWorld;
 	struct WorldBuilderDefinition;
+	class World;
+
+	//Entity
+	struct Entity;
+	class Archetype;
+	class EntityStore;
 
 	//CameraUtils
 	enum ViewType : int;
@@ -358,6 +405,10 @@ using namespace std::chrono_literals;
 	struct Mesh;
 	struct ModelData;
 	struct DrawCall;
+	class ModelCache;
+	struct PackedVertex;
+	struct MeshStats;
+	class MeshOptimizer;
 
 	//Gdx
 	class Environment;
@@ -374,6 +425,27 @@ using namespace std::chrono_literals;
 	class Logger;
 	struct TimeStamp;
 	class Timer;
+	class FramePacer;
+
+	//Jobs
+	struct Job;
+	class JobScheduler;
+
+	typedef std::shared_ptr<Job> JobHandle;
+
+	//Memory
+	class FrameArena;
+
+	//Random
+	class RandomStream;
+	class RandomService;
+
+	enum FramePacing {
+		vsync, //the driver paces via swap interval
+		capped, //sleeps until the next frame deadline
+		uncapped, //runs as fast as possible
+		freerun //exactly one simulation step per frame, decoupled from real time (headless)
+	};
 
 	struct MainConfig {
 		unsigned int MAXSPRITES = 1000;
@@ -382,15 +454,295 @@ using namespace std::chrono_literals;
 		unsigned int windowHeight = 480;
 		int windowStyle = sf::Style::Default;
 		sf::ContextSettings settings;
+		//number of worker threads, 0 = hardware threads - 1
+		unsigned int workerThreads = 0;
+		//per frame budget for finalizing gl jobs (uploads, shader links), see JobScheduler::runGLJobs
+		float glBudgetMs = 4.f;
+		unsigned long long glBudgetBytes = 64ull * 1024ull * 1024ull;
+		unsigned int glBudgetPrograms = 4;
+		FramePacing pacing = FramePacing::vsync;
+		//frames per second, capped only
+		float frameCap = 60.f;
+		//simulation step of LevelManager::update in seconds
+		float fixedStep = 1.f / 60.f;
+		//simulation steps per frame before the sim starts to lag behind
+		unsigned int maxSimSteps = 5;
+		//no window and no gl: glLoad is skipped and levels tick freerunning, for soak tests & benchmarks
+		bool headless = false;
+		//headless only: create a hidden gl context so glLoad still runs (upload benchmarks)
+		bool offscreenContext = false;
+		//pack archives mounted at startup, later ones shadow earlier ones. missing archives are skipped
+		//and everything is read from loose files (development)
+		std::vector<std::string> archives = { "assets.pak" };
+		//ressources in the load pipeline at once (io, decode & upload), 0 = 2 per worker
+		unsigned int assetsInFlight = 0;
+		//initial size of each FrameArena buffer in bytes, grows to the peak frame
+		size_t frameArenaSize = 4u * 1024u * 1024u;
+		//capacity of the StreamBuffer per StreamUsage (vertex, index, uniform, storage) in bytes, 0 = none.
+		//each has to hold about three frames of data before allocate starts to wait for the gpu
+		size_t streamSizes[4] = { 8u * 1024u * 1024u, 2u * 1024u * 1024u, 1024u * 1024u, 16u * 1024u * 1024u };
+		//staging memory for texture uploads in bytes, 0 = textures upload from client memory.
+		//textures larger than this, or arriving while it is full, fall back to client memory
+		size_t uploadRingSize = 64u * 1024u * 1024u;
+		//directory of the shader program binary cache, empty disables it
+		std::string shaderCache = "cache/shader/";
+	};
+
+	//estimated cost of a gl job, checked against the per frame budget
+	struct GLCost {
+		unsigned long long bytes = 0; //bytes uploaded to the gpu
+		unsigned int programs = 0; //shader programs compiled & linked
+	};
+
+	//---------------------- Job ----------------------\\
+
+	//a unit of work for the JobScheduler. the job is repolled until work returns true.
+	//a job becomes runnable when all its dependencies finished, its continuations
+	//are released the moment it finishes.
+	struct Job {
+
+		friend JobScheduler;
+
+		enum Lane {
+			worker, //any worker thread
+			gl //main thread, inside Main::update
+		};
+
+	private:
+		std::function<bool()> work;
+		//evaluated once the job becomes runnable and again after every run that didn't finish it, gl lane only
+		std::function<GLCost()> estimate;
+		GLCost cost;
+		Lane lane;
+		//counts the job towards JobScheduler::busy
+		bool tracked = true;
+
+		//open dependencies + 1 until the job is submitted
+		std::atomic<int> pending = 1;
+		std::atomic<bool> done = false;
+
+		std::mutex lock;
+		std::vector<JobHandle> continuations;
+
+	public:
+		inline bool finished() {
+			return done;
+		};
+	};
+
+	class JobScheduler {
+	public:
+
+		struct GLStats {
+			//tracked gl jobs waiting to run & their estimated cost
+			uint backlog = 0;
+			unsigned long long backlogBytes = 0;
+			uint backlogPrograms = 0;
+			//last budgeted runGLJobs
+			uint ran = 0;
+			uint deferred = 0;
+			unsigned long long bytes = 0;
+			float ms = 0.f;
+		};
+
+	private:
+
+		struct Worker {
+			std::thread thread;
+			std::mutex lock;
+			std::deque<JobHandle> queue;
+		};
+
+		std::vector<Worker*> workers;
+		std::atomic<bool> running = true;
+		std::atomic<uint> next = 0;
+
+		//runnable jobs in the worker deques
+		std::atomic<int> queued = 0;
+		//submitted but unfinished tracked jobs
+		std::atomic<int> outstanding = 0;
+
+		std::mutex sleepLock;
+		std::condition_variable sleep;
+
+		std::mutex glLock;
+		std::vector<JobHandle> glQueue;
+
+		float budgetMs = 4.f;
+		unsigned long long budgetBytes = 0;
+		uint budgetPrograms = 0;
+
+		std::mutex statsLock;
+		GLStats stats;
+
+		void workerLoop(uint);
+		JobHandle enqueue(const JobHandle&, const std::vector<JobHandle>&);
+		void schedule(const JobHandle&);
+		void release(const JobHandle&);
+		void execute(const JobHandle&);
+		void finish(const JobHandle&);
+		JobHandle pop(uint);
+		JobHandle steal(uint);
+
+	public:
+		JobScheduler(uint);
+		~JobScheduler();
+
+		//thread safe. the job runs once every dependency finished.
+		JobHandle submit(std::function<bool()>, std::initializer_list<JobHandle> = {}, Job::Lane = Job::worker);
+		JobHandle submit(std::function<bool()>, const std::vector<JobHandle>&, Job::Lane = Job::worker);
+		//runs after _job finished
+		JobHandle then(const JobHandle&, std::function<bool()>, Job::Lane = Job::worker);
+		//gl lane job whose cost is estimated once its dependencies finished
+		JobHandle submitGL(std::function<bool()>, std::function<GLCost()>, std::initializer_list<JobHandle> = {});
+		//untracked job on the gl lane, repolled every frame until it returns true
+		void addFrameJob(std::function<bool()>);
+
+		//main thread only. runs queued gl jobs once, unfinished ones wait for the next frame.
+		//budgeted: stops once the frame budget is used up, but always makes progress by one job
+		void runGLJobs(bool = false);
+		void setGLBudget(float, unsigned long long, uint);
+		GLStats glStats();
+		//runs one worker job on the calling thread, returns false if there was nothing to do
+		bool runOne();
+		//runs gl jobs (main thread only) and worker jobs until nothing tracked is outstanding
+		void pump();
+		//helps out until _job finished. never call from a worker with a gl-lane dependency
+		void wait(const JobHandle&);
+
+		bool busy();
+		uint workerCount();
+		static bool isWorker();
+	};
+
+	//---------------------- FrameArena ----------------------\
+
+	//bump allocator for transient per frame data (renderables, draw lists). main thread only.
+	//double buffered: memory handed out in frame n stays valid until the end of frame n + 1.
+	//nothing is destructed, so only trivially destructible types may live in here.
+	class FrameArena {
+
+		struct Buffer {
+			char* data = nullptr;
+			size_t size = 0;
+			size_t offset = 0;
+			//allocations that did not fit, freed on the next reset of this buffer
+			std::vector<char*> overflow;
+			size_t overflowBytes = 0;
+		};
+
+		Buffer buffers[2];
+		uint current = 0;
+		size_t peak = 0;
+
+		void reset(Buffer&);
+
+	public:
+		FrameArena(size_t);
+		~FrameArena();
+
+		//swaps the buffers and resets the one from two frames ago
+		void flip();
+
+		void* alloc(size_t, size_t = alignof(std::max_align_t));
+
+		//count default constructed T's
+		template<class T>
+		T* alloc(uint);
+
+		template<class T, class ... Args>
+		T* create(Args&& ...);
+
+		//bytes used in the current frame
+		size_t used();
+		//highest usage of a single frame so far
+		size_t peakUsage();
+	};
+
+	template<class T>
+	inline T* FrameArena::alloc(uint _count) {
+		static_assert(std::is_trivially_destructible<T>::value, "FrameArena never calls destructors");
+		if (_count == 0) return nullptr;
+		T* out = reinterpret_cast<T*>(alloc(sizeof(T) * _count, alignof(T)));
+		for (uint i = 0; i < _count; ++i)
+			new (out + i) T();
+		return out;
+	}
+
+	template<class T, class ... Args>
+	inline T* FrameArena::create(Args&& ... _args) {
+		static_assert(std::is_trivially_destructible<T>::value, "FrameArena never calls destructors");
+		return new (alloc(sizeof(T), alignof(T))) T(std::forward<Args>(_args)...);
+	}
+
+	//---------------------- Random ----------------------\\
+
+	//xoshiro256+ generator. cheap to copy, not thread safe: every thread or system owns its own stream.
+	class RandomStream {
+		unsigned long long s[4];
+	public:
+		RandomStream(unsigned long long = 0);
+
+		//expands the seed with splitmix64
+		void seed(unsigned long long);
+
+		unsigned long long next();
+		//[0, 1)
+		float nextFloat();
+		//[_low, _high)
+		float nextFloat(float, float);
+		//[0, _bound)
+		uint nextUint(uint);
+
+		//bulk fill in [_low, _high). runs 4 interleaved generators so the loop vectorizes,
+		//the sequence differs from calling nextFloat _count times but is just as reproducible
+		void fill(float*, size_t, float = 0.f, float = 1.f);
+	};
+
+	//hands out independent, reproducible streams derived from one seed (Main::setSeed)
+	class RandomService {
+		std::atomic<unsigned long long> seedValue;
+		//bumped by setSeed so thread local streams know to reseed
+		std::atomic<unsigned int> generation;
+		std::atomic<unsigned int> nextSlot;
+		std::thread::id mainThread;
+
+		static unsigned long long mix(unsigned long long, unsigned long long);
+
+	public:
+		//samples per chunk in parallelFill, chunk k always comes from the same stream
+		static constexpr size_t CHUNK = 4096;
+
+		RandomService(unsigned long long = 0);
+
+		void setSeed(unsigned long long);
+		unsigned long long getSeed();
+
+		//same seed + id = same sequence, independent of threads and call order elsewhere
+		RandomStream stream(unsigned long long, unsigned long long = 0);
+		RandomStream stream(const std::string&, unsigned long long = 0);
+
+		//stream of the calling thread. main thread is slot 0, workers 1..n, any other thread
+		//gets the next free slot, so only use this where the exact sequence does not matter
+		RandomStream& local();
+
+		//fills _count samples in parallel, the result only depends on seed and id, not on the thread count
+		void parallelFill(float*, size_t, unsigned long long, float = 0.f, float = 1.f);
 	};
 
 	namespace App {
 
 		class Main {
 		private:
-			sf::RenderWindow* context;
+			sf::RenderWindow* context = nullptr;
+			//headless only, see MainConfig::offscreenContext
+			sf::Context* offscreen = nullptr;
+			bool headless = false;
+			bool glAvailable = false;
+			//window size, without a window the configured size
+			sf::Vector2u size;
 			InputMultiplexer* inputListener;
-			VoxelWorld* world;
+			World* world;
 			//ViewportHandler* viewports;
 			AssetManager* assets;
 			UI::Stage* stage;
@@ -401,6 +753,7 @@ using namespace std::chrono_literals;
 			ViewportHandler* viewport;
 			Logger* logger;
 			Timer* timer;
+			FramePacer* pacer;
 			ShapeRenderer* shape;
 			Environment* env;
 
@@ -408,10 +761,12 @@ using namespace std::chrono_literals;
 
 			static Main* instance;
 
-			std::mt19937_64 random;
+			RandomService* random;
 
-			std::queue<std::tuple<std::function<bool(void*)>, void*>> loadJob;
-			std::mutex jobLock;
+			JobScheduler* jobs;
+			FrameArena* arena;
+			StreamBuffer* streams[4] = {};
+			UploadRing* uploads = nullptr;
 
 			GLuint* indexBuffer;
 
@@ -426,9 +781,19 @@ using namespace std::chrono_literals;
 
 			static Main* getInstance();
 
+			//true if no window was created
+			static bool isHeadless();
+			//true if there is a gl context, glLoad & draw calls are only valid if this is set
+			static bool hasGL();
+
 			static GLuint* getIndexBuffer();
 
+			//real time of the last frame in seconds
 			float deltaTime();
+			//length of one simulation step in seconds
+			float fixedDeltaTime();
+			//interpolation between the last two simulation steps for rendering
+			float alpha();
 
 			//---------------------- AI ----------------------\\
 
@@ -442,15 +807,26 @@ using namespace std::chrono_literals;
 
 			//---------------------- Job ----------------------\\
 
-			//thread safe
+			//thread safe. runs on the main thread every frame until the job returns true
 			static void addJob(std::function<bool(void*)>, void*);
 
+			static JobScheduler* getJobs();
+
+			//---------------------- Memory ----------------------\\
+
+			static FrameArena* getArena();
+			//nullptr without gl or if the usage is disabled in MainConfig::streamSizes
+			static StreamBuffer* getStream(StreamUsage);
+			//any thread, nullptr without gl or if disabled in MainConfig::uploadRingSize
+			static UploadRing* getUploads();
+
 			//---------------------- Random ----------------------\\
 
 			static void setSeed(long);
-			//random in interval [0, 1]
+			//random in interval [0, 1), thread safe. draws from the calling thread's stream
 			static float getRandom();
 			static float getRandom(float, float);
+			static RandomService* getRandomService();
 
 			//---------------------- Context ----------------------\\
 
@@ -458,11 +834,11 @@ using namespace std::chrono_literals;
 			static void setSize(unsigned int _width, unsigned int _height);
 
 			inline static unsigned int width() {
-				return getInstance()->getContext()->getSize().x;
+				return getInstance()->context == nullptr ? getInstance()->size.x : getInstance()->context->getSize().x;
 			};
 
 			inline static unsigned int height() {
-				return getInstance()->getContext()->getSize().y;
+				return getInstance()->context == nullptr ? getInstance()->size.y : getInstance()->context->getSize().y;
 			};
 
 			static ShapeRenderer* getShape();
@@ -470,6 +846,7 @@ using namespace std::chrono_literals;
 			//---------------------- TIME & Logger ----------------------\\
 
 			static Timer* getTimer();
+			static FramePacer* getPacer();
 			static Logger* getLogger();
 
 			//---------------------- Batch ----------------------\\
@@ -482,7 +859,7 @@ using namespace std::chrono_literals;
 
 			//---------------------- World ----------------------\\
 
-			static VoxelWorld* getWorld();
+			static World* getWorld();
 			static Environment* getEnv();
 		
 			//---------------------- Viewport ----------------------\\
@@ -509,6 +886,7 @@ using namespace std::chrono_literals;
 		namespace Gdx {
 
 			inline void printOpenGlErrors(std::string _id) {
+				if (!Main::hasGL()) return;
 				bool hasError = false;
 				GLenum err;
 				while ((err = glGetError()) != GL_NO_ERROR) {
@@ -0,0 +1,247 @@
+#include "MeshOptimizer.hpp"
+
+using namespace Heerbann;
+
+//---------------------- MeshOptimizer ----------------------\\
+
+//fifo cache simulation: a vertex is cached while fewer than CACHE_SIZE misses happened since it was loaded.
+//the clock starts past CACHE_SIZE so a stamp of 0 is never cached
+struct FifoCache {
+	std::vector<uint> stamps;
+	uint time = MeshOptimizer::CACHE_SIZE + 1;
+
+	FifoCache(size_t _vertices) : stamps(_vertices, 0) {}
+
+	//true on a miss
+	inline bool touch(uint _vertex) {
+		if (time - stamps[_vertex] <= MeshOptimizer::CACHE_SIZE) return false;
+		stamps[_vertex] = time++;
+		return true;
+	}
+
+	inline bool cached(uint _vertex) const {
+		return time - stamps[_vertex] <= MeshOptimizer::CACHE_SIZE;
+	}
+
+	inline void flush() {
+		time += MeshOptimizer::CACHE_SIZE + 1;
+	}
+};
+
+MeshStats MeshOptimizer::analyze(const std::vector<uint>& _indices, uint _vertexCount) {
+	MeshStats out;
+	out.triangles = static_cast<uint>(_indices.size() / 3);
+	if (out.triangles == 0) return out;
+	FifoCache cache(_vertexCount);
+	std::vector<bool> used(_vertexCount, false);
+	uint misses = 0;
+	for (uint v : _indices) {
+		if (cache.touch(v)) ++misses;
+		if (!used[v]) {
+			used[v] = true;
+			++out.vertices;
+		}
+	}
+	out.acmr = static_cast<float>(misses) / out.triangles;
+	out.atvr = static_cast<float>(misses) / out.vertices;
+	return out;
+}
+
+std::vector<uint> MeshOptimizer::deduplicate(std::vector<PackedVertex>& _vertices, std::vector<uint>& _indices) {
+	const size_t count = _vertices.size();
+	std::vector<uint> remap(count, INVALID);
+	//open addressing over the packed bits, the unused position component is always 0
+	size_t buckets = 1;
+	while (buckets < count * 2) buckets *= 2;
+	std::vector<uint> table(buckets, INVALID);
+	std::vector<PackedVertex> unique;
+	unique.reserve(count);
+	for (size_t i = 0; i < count; ++i) {
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&_vertices[i]);
+		unsigned long long hash = 0xcbf29ce484222325ull;
+		for (size_t b = 0; b < sizeof(PackedVertex); ++b) {
+			hash ^= bytes[b];
+			hash *= 0x100000001b3ull;
+		}
+		size_t slot = static_cast<size_t>(hash) & (buckets - 1);
+		while (table[slot] != INVALID && std::memcmp(&unique[table[slot]], &_vertices[i], sizeof(PackedVertex)) != 0)
+			slot = (slot + 1) & (buckets - 1);
+		if (table[slot] == INVALID) {
+			table[slot] = static_cast<uint>(unique.size());
+			unique.emplace_back(_vertices[i]);
+		}
+		remap[i] = table[slot];
+	}
+	for (auto& i : _indices)
+		i = remap[i];
+	_vertices.swap(unique);
+	return remap;
+}
+
+void MeshOptimizer::optimizeCache(std::vector<uint>& _indices, uint _vertexCount) {
+	//tipsify, Sander et al. "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"
+	const size_t triangles = _indices.size() / 3;
+	if (triangles == 0) return;
+
+	//triangles around each vertex
+	std::vector<uint> live(_vertexCount, 0);
+	for (uint v : _indices)
+		++live[v];
+	std::vector<uint> offsets(_vertexCount + 1, 0);
+	for (uint i = 0; i < _vertexCount; ++i)
+		offsets[i + 1] = offsets[i] + live[i];
+	std::vector<uint> adjacency(_indices.size());
+	std::vector<uint> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t t = 0; t < triangles; ++t)
+		for (uint k = 0; k < 3; ++k)
+			adjacency[fill[_indices[t * 3 + k]]++] = static_cast<uint>(t);
+
+	FifoCache cache(_vertexCount);
+	std::vector<bool> emitted(triangles, false);
+	std::vector<uint> deadEnd, candidates, out;
+	deadEnd.reserve(_indices.size());
+	out.reserve(_indices.size());
+	uint cursor = 0;
+
+	long long fanning = _indices[0];
+	while (fanning >= 0) {
+		const uint f = static_cast<uint>(fanning);
+		candidates.clear();
+		for (uint a = offsets[f]; a < offsets[f + 1]; ++a) {
+			const uint t = adjacency[a];
+			if (emitted[t]) continue;
+			emitted[t] = true;
+			for (uint k = 0; k < 3; ++k) {
+				const uint v = _indices[t * 3 + k];
+				out.emplace_back(v);
+				deadEnd.emplace_back(v);
+				candidates.emplace_back(v);
+				--live[v];
+				cache.touch(v);
+			}
+		}
+
+		//the one of the fan that stays longest in the cache while its remaining triangles are emitted
+		fanning = -1;
+		long long best = -1;
+		for (uint v : candidates) {
+			if (live[v] == 0) continue;
+			long long priority = 0;
+			const long long age = cache.time - cache.stamps[v];
+			if (age + 2 * live[v] <= CACHE_SIZE) priority = age;
+			if (priority > best) {
+				best = priority;
+				fanning = v;
+			}
+		}
+		if (fanning >= 0) continue;
+		//dead end: the most recent vertex with triangles left, then any in input order
+		while (!deadEnd.empty() && fanning < 0) {
+			const uint v = deadEnd.back();
+			deadEnd.pop_back();
+			if (live[v] > 0) fanning = v;
+		}
+		while (fanning < 0 && cursor < _vertexCount) {
+			if (live[cursor] > 0) fanning = cursor;
+			else ++cursor;
+		}
+	}
+	_indices.swap(out);
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<uint>& _indices, const std::vector<PackedVertex>& _vertices, const Vec3& _min, const Vec3& _extent, float _threshold) {
+	const uint triangles = static_cast<uint>(_indices.size() / 3);
+	if (triangles < 2) return;
+	const uint vertexCount = static_cast<uint>(_vertices.size());
+	const float acmr = analyze(_indices, vertexCount).acmr;
+
+	//clusters start with a cold cache and end as soon as their acmr is within _threshold of the whole mesh,
+	//so reordering them costs at most that much reuse
+	std::vector<uint> starts(1, 0);
+	FifoCache cache(vertexCount);
+	uint misses = 0, count = 0;
+	for (uint t = 0; t < triangles; ++t) {
+		for (uint k = 0; k < 3; ++k)
+			if (cache.touch(_indices[t * 3 + k])) ++misses;
+		++count;
+		if (t + 1 < triangles && static_cast<float>(misses) <= _threshold * acmr * count) {
+			starts.emplace_back(t + 1);
+			misses = count = 0;
+			cache.flush();
+		}
+	}
+	const uint clusters = static_cast<uint>(starts.size());
+	if (clusters < 2) return;
+	starts.emplace_back(triangles);
+
+	auto position = [&](uint _vertex)->Vec3 {
+		const PackedVertex& p = _vertices[_vertex];
+		return _min + Vec3(p.position[0], p.position[1], p.position[2]) * (1.f / 65535.f) * _extent;
+	};
+
+	//area weighted centroid & normal per cluster, clusters facing away from the center are drawn first
+	std::vector<Vec3> centroids(clusters, Vec3(0.f)), normals(clusters, Vec3(0.f));
+	Vec3 center(0.f);
+	float area = 0.f;
+	for (uint c = 0; c < clusters; ++c) {
+		float clusterArea = 0.f;
+		for (uint t = starts[c]; t < starts[c + 1]; ++t) {
+			const Vec3 p0 = position(_indices[t * 3]), p1 = position(_indices[t * 3 + 1]), p2 = position(_indices[t * 3 + 2]);
+			const Vec3 n = glm::cross(p1 - p0, p2 - p0);
+			const float a = glm::length(n);
+			centroids[c] += (p0 + p1 + p2) * (a / 3.f);
+			normals[c] += n;
+			clusterArea += a;
+		}
+		center += centroids[c];
+		area += clusterArea;
+		if (clusterArea > 0.f) centroids[c] /= clusterArea;
+	}
+	if (area > 0.f) center /= area;
+
+	std::vector<float> keys(clusters, 0.f);
+	for (uint c = 0; c < clusters; ++c) {
+		const float length = glm::length(normals[c]);
+		if (length > 0.f) keys[c] = glm::dot(centroids[c] - center, normals[c] / length);
+	}
+	std::vector<uint> order(clusters);
+	for (uint c = 0; c < clusters; ++c)
+		order[c] = c;
+	std::stable_sort(order.begin(), order.end(), [&](uint _a, uint _b)->bool {
+		return keys[_a] > keys[_b];
+	});
+
+	std::vector<uint> out;
+	out.reserve(_indices.size());
+	for (uint c : order)
+		out.insert(out.end(), _indices.begin() + starts[c] * 3, _indices.begin() + starts[c + 1] * 3);
+	_indices.swap(out);
+}
+
+std::vector<uint> MeshOptimizer::optimizeFetch(std::vector<PackedVertex>& _vertices, std::vector<uint>& _indices) {
+	std::vector<uint> remap(_vertices.size(), INVALID);
+	std::vector<PackedVertex> out;
+	out.reserve(_vertices.size());
+	for (auto& i : _indices) {
+		if (remap[i] == INVALID) {
+			remap[i] = static_cast<uint>(out.size());
+			out.emplace_back(_vertices[i]);
+		}
+		i = remap[i];
+	}
+	_vertices.swap(out);
+	return remap;
+}
+
+void MeshOptimizer::optimize(std::vector<PackedVertex>& _vertices, std::vector<uint>& _indices, const Vec3& _min, const Vec3& _extent,
+	std::vector<uint>& _remap, MeshStats& _before, MeshStats& _after) {
+	_before = analyze(_indices, static_cast<uint>(_vertices.size()));
+	std::vector<uint> unique = deduplicate(_vertices, _indices);
+	optimizeCache(_indices, static_cast<uint>(_vertices.size()));
+	optimizeOverdraw(_indices, _vertices, _min, _extent);
+	std::vector<uint> fetch = optimizeFetch(_vertices, _indices);
+	_remap.resize(unique.size());
+	for (size_t i = 0; i < unique.size(); ++i)
+		_remap[i] = fetch[unique[i]];
+	_after = analyze(_indices, static_cast<uint>(_vertices.size()));
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "MainStruct.hpp"
+#include "G3D.hpp"
+
+namespace Heerbann {
+
+	//---------------------- MeshOptimizer ----------------------\\
+
+	//post transform cache behaviour of an index buffer, simulated with a fifo cache of MeshOptimizer::CACHE_SIZE
+	struct MeshStats {
+		uint vertices = 0;
+		uint triangles = 0;
+		//cache misses per triangle, 0.5 is the limit for a regular grid & 3 means no reuse at all
+		float acmr = 0.f;
+		//cache misses per vertex, 1 is optimal
+		float atvr = 0.f;
+	};
+
+	//reorders a triangle list for the gpu after import, every pass keeps the mesh visually identical:
+	//deduplicate merges vertices that pack to the same bits, optimizeCache orders the triangles for
+	//vertex reuse (tipsify), optimizeOverdraw sorts clusters of those triangles outside in without
+	//giving up more than _threshold of the cache efficiency, optimizeFetch lays the vertices out in
+	//the order they are first used. the remaps map old vertex indices to new ones, INVALID if dropped
+	class MeshOptimizer {
+	public:
+		static constexpr uint CACHE_SIZE = 16;
+		static constexpr uint INVALID = ~0u;
+
+		//indices, vertex count
+		static MeshStats analyze(const std::vector<uint>&, uint);
+
+		static std::vector<uint> deduplicate(std::vector<PackedVertex>&, std::vector<uint>&);
+		//indices, vertex count
+		static void optimizeCache(std::vector<uint>&, uint);
+		//indices, vertices, bounds min, bounds extent, acmr threshold
+		static void optimizeOverdraw(std::vector<uint>&, const std::vector<PackedVertex>&, const Vec3&, const Vec3&, float = 1.05f);
+		static std::vector<uint> optimizeFetch(std::vector<PackedVertex>&, std::vector<uint>&);
+
+		//all passes in order. vertices, indices, bounds min, bounds extent, remap out, stats before & after
+		static void optimize(std::vector<PackedVertex>&, std::vector<uint>&, const Vec3&, const Vec3&, std::vector<uint>&, MeshStats&, MeshStats&);
+	};
+
+}
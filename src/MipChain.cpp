@@ -0,0 +1,327 @@
+#include "MipChain.hpp"
+
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <xmmintrin.h>
+#define MIP_SSE
+#endif
+
+using namespace Heerbann;
+
+//---------------------- Kernels ----------------------\\
+
+//one rgba texel in float, a single sse register where available
+#ifdef MIP_SSE
+typedef __m128 Texel;
+
+inline Texel loadTexel(const float* _p) {
+	return _mm_loadu_ps(_p);
+}
+
+inline void storeTexel(float* _p, Texel _t) {
+	_mm_storeu_ps(_p, _t);
+}
+
+inline Texel addTexel(Texel _a, Texel _b) {
+	return _mm_add_ps(_a, _b);
+}
+
+inline Texel scaleTexel(Texel _a, float _s) {
+	return _mm_mul_ps(_a, _mm_set1_ps(_s));
+}
+
+inline Texel zeroTexel() {
+	return _mm_setzero_ps();
+}
+#else
+struct Texel {
+	float v[4];
+};
+
+inline Texel loadTexel(const float* _p) {
+	return { _p[0], _p[1], _p[2], _p[3] };
+}
+
+inline void storeTexel(float* _p, Texel _t) {
+	std::memcpy(_p, _t.v, sizeof(float) * 4);
+}
+
+inline Texel addTexel(Texel _a, Texel _b) {
+	return { _a.v[0] + _b.v[0], _a.v[1] + _b.v[1], _a.v[2] + _b.v[2], _a.v[3] + _b.v[3] };
+}
+
+inline Texel scaleTexel(Texel _a, float _s) {
+	return { _a.v[0] * _s, _a.v[1] * _s, _a.v[2] * _s, _a.v[3] * _s };
+}
+
+inline Texel zeroTexel() {
+	return { 0.f, 0.f, 0.f, 0.f };
+}
+#endif
+
+//srgb decode per byte, encode through a table over [0, 1]
+struct GammaTables {
+	float toLinear[256];
+	unsigned char toSrgb[4096];
+
+	GammaTables() {
+		for (uint i = 0; i < 256; ++i) {
+			float c = i / 255.f;
+			toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (uint i = 0; i < 4096; ++i) {
+			float c = i / 4095.f;
+			float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+			toSrgb[i] = static_cast<unsigned char>(std::clamp(s, 0.f, 1.f) * 255.f + 0.5f);
+		}
+	}
+};
+
+const GammaTables& gamma() {
+	static const GammaTables out;
+	return out;
+}
+
+//kaiser windowed sinc, 8 taps per axis for a 2:1 reduction
+struct KaiserWeights {
+	float w[8];
+
+	static double besselI0(double _x) {
+		double sum = 1.0, term = 1.0;
+		for (int k = 1; k < 32; ++k) {
+			term *= (_x / (2.0 * k)) * (_x / (2.0 * k));
+			sum += term;
+		}
+		return sum;
+	}
+
+	KaiserWeights() {
+		const double pi = 3.14159265358979323846;
+		const double alpha = 4.0;
+		const double radius = 2.0; //in destination texels
+		double total = 0.0;
+		for (int k = 0; k < 8; ++k) {
+			//tap centre relative to the destination texel centre, in destination texels
+			double x = (k - 3.5) * 0.5;
+			double sinc = x == 0.0 ? 1.0 : std::sin(pi * x) / (pi * x);
+			double r = x / radius;
+			double window = besselI0(alpha * std::sqrt(std::max(0.0, 1.0 - r * r))) / besselI0(alpha);
+			w[k] = static_cast<float>(sinc * window);
+			total += w[k];
+		}
+		for (int k = 0; k < 8; ++k)
+			w[k] = static_cast<float>(w[k] / total);
+	}
+};
+
+const KaiserWeights& kaiser() {
+	static const KaiserWeights out;
+	return out;
+}
+
+void expand(const unsigned char* _in, uint _width, uint _height, MipContent _content, float* _out, bool _parallel) {
+	const float* toLinear = gamma().toLinear;
+	const int rows = static_cast<int>(_height);
+#pragma omp parallel for schedule(static) if(_parallel)
+	for (int y = 0; y < rows; ++y) {
+		const size_t begin = static_cast<size_t>(y) * _width * 4;
+		for (size_t i = begin; i < begin + static_cast<size_t>(_width) * 4; i += 4) {
+			for (uint c = 0; c < 3; ++c) {
+				switch (_content) {
+					case MipContent::color: _out[i + c] = toLinear[_in[i + c]]; break;
+					case MipContent::normal: _out[i + c] = _in[i + c] / 127.5f - 1.f; break;
+					default: _out[i + c] = _in[i + c] / 255.f; break;
+				}
+			}
+			_out[i + 3] = _in[i + 3] / 255.f;
+		}
+	}
+}
+
+void encode(float* _in, uint _width, uint _height, MipContent _content, unsigned char* _out, bool _parallel) {
+	const unsigned char* toSrgb = gamma().toSrgb;
+	const int rows = static_cast<int>(_height);
+#pragma omp parallel for schedule(static) if(_parallel)
+	for (int y = 0; y < rows; ++y) {
+		const size_t begin = static_cast<size_t>(y) * _width * 4;
+		for (size_t i = begin; i < begin + static_cast<size_t>(_width) * 4; i += 4) {
+			float* t = _in + i;
+			if (_content == MipContent::normal) {
+				//averaged normals shrink, put them back on the unit sphere. kept in _in for the next level
+				float len = std::sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+				if (len > 1e-6f)
+					for (uint c = 0; c < 3; ++c) t[c] /= len;
+				for (uint c = 0; c < 3; ++c)
+					_out[i + c] = static_cast<unsigned char>(std::clamp(t[c] * 0.5f + 0.5f, 0.f, 1.f) * 255.f + 0.5f);
+			} else if (_content == MipContent::color) {
+				for (uint c = 0; c < 3; ++c)
+					_out[i + c] = toSrgb[static_cast<uint>(std::clamp(t[c], 0.f, 1.f) * 4095.f + 0.5f)];
+			} else {
+				for (uint c = 0; c < 3; ++c)
+					_out[i + c] = static_cast<unsigned char>(std::clamp(t[c], 0.f, 1.f) * 255.f + 0.5f);
+			}
+			_out[i + 3] = static_cast<unsigned char>(std::clamp(t[3], 0.f, 1.f) * 255.f + 0.5f);
+		}
+	}
+}
+
+//2x2 average, an axis of size 1 is passed through
+void boxDown(const float* _in, uint _width, uint _height, float* _out, bool _parallel) {
+	const uint w = std::max(1u, _width / 2);
+	const int h = static_cast<int>(std::max(1u, _height / 2));
+#pragma omp parallel for schedule(static) if(_parallel)
+	for (int y = 0; y < h; ++y) {
+		const size_t r0 = static_cast<size_t>(std::min(y * 2u, _height - 1)) * _width;
+		const size_t r1 = static_cast<size_t>(std::min(y * 2u + 1, _height - 1)) * _width;
+		for (uint x = 0; x < w; ++x) {
+			const uint x0 = std::min(x * 2, _width - 1), x1 = std::min(x * 2 + 1, _width - 1);
+			Texel sum = addTexel(addTexel(loadTexel(_in + (r0 + x0) * 4), loadTexel(_in + (r0 + x1) * 4)),
+				addTexel(loadTexel(_in + (r1 + x0) * 4), loadTexel(_in + (r1 + x1) * 4)));
+			storeTexel(_out + (static_cast<size_t>(y) * w + x) * 4, scaleTexel(sum, 0.25f));
+		}
+	}
+}
+
+//halves the width, edges clamp
+void kaiserRows(const float* _in, uint _width, uint _height, float* _out, bool _parallel) {
+	if (_width == 1) {
+		std::memcpy(_out, _in, sizeof(float) * 4 * _height);
+		return;
+	}
+	const float* weights = kaiser().w;
+	const uint w = _width / 2;
+	const int h = static_cast<int>(_height);
+#pragma omp parallel for schedule(static) if(_parallel)
+	for (int y = 0; y < h; ++y) {
+		const float* row = _in + static_cast<size_t>(y) * _width * 4;
+		for (uint x = 0; x < w; ++x) {
+			Texel sum = zeroTexel();
+			for (int k = 0; k < 8; ++k) {
+				int sx = std::clamp(static_cast<int>(x * 2) - 3 + k, 0, static_cast<int>(_width) - 1);
+				sum = addTexel(sum, scaleTexel(loadTexel(row + sx * 4), weights[k]));
+			}
+			storeTexel(_out + (static_cast<size_t>(y) * w + x) * 4, sum);
+		}
+	}
+}
+
+//halves the height, edges clamp
+void kaiserColumns(const float* _in, uint _width, uint _height, float* _out, bool _parallel) {
+	if (_height == 1) {
+		std::memcpy(_out, _in, sizeof(float) * 4 * _width);
+		return;
+	}
+	const float* weights = kaiser().w;
+	const int h = static_cast<int>(_height / 2);
+#pragma omp parallel for schedule(static) if(_parallel)
+	for (int y = 0; y < h; ++y) {
+		size_t rows[8];
+		for (int k = 0; k < 8; ++k)
+			rows[k] = static_cast<size_t>(std::clamp(y * 2 - 3 + k, 0, static_cast<int>(_height) - 1)) * _width;
+		for (uint x = 0; x < _width; ++x) {
+			Texel sum = zeroTexel();
+			for (int k = 0; k < 8; ++k)
+				sum = addTexel(sum, scaleTexel(loadTexel(_in + (rows[k] + x) * 4), weights[k]));
+			storeTexel(_out + (static_cast<size_t>(y) * _width + x) * 4, sum);
+		}
+	}
+}
+
+//---------------------- MipChain ----------------------\\
+
+uint MipChain::levelCount(uint _width, uint _height) {
+	uint out = 1;
+	for (uint s = std::max(_width, _height); s > 1; s /= 2) ++out;
+	return out;
+}
+
+size_t MipChain::chainSize(uint _width, uint _height, MipContent _content, uint _maxLevels) {
+	uint count = _content == MipContent::none ? 1 : levelCount(_width, _height);
+	if (_maxLevels > 0) count = std::min(count, _maxLevels);
+	size_t out = 0;
+	for (uint i = 0, w = _width, h = _height; i < count; ++i, w = std::max(1u, w / 2), h = std::max(1u, h / 2))
+		out += static_cast<size_t>(w) * h * 4;
+	return out;
+}
+
+uint MipChain::layout(uint _width, uint _height, MipContent _content, uint _maxLevels) {
+	clear();
+	uint count = _content == MipContent::none ? 1 : levelCount(_width, _height);
+	if (_maxLevels > 0) count = std::min(count, _maxLevels);
+	for (uint i = 0, w = _width, h = _height; i < count; ++i, w = std::max(1u, w / 2), h = std::max(1u, h / 2)) {
+		bounds.emplace_back(w, h);
+		offsets.emplace_back(total);
+		total += static_cast<size_t>(w) * h * 4;
+	}
+	return count;
+}
+
+void MipChain::build(const unsigned char* _rgba, uint _width, uint _height, MipContent _content, MipFilter _filter, uint _maxLevels) {
+	layout(_width, _height, _content, _maxLevels);
+	pixels.resize(total);
+	base = pixels.data();
+	generate(_rgba, _content, _filter);
+}
+
+void MipChain::build(unsigned char* _out, const unsigned char* _rgba, uint _width, uint _height, MipContent _content, MipFilter _filter, uint _maxLevels) {
+	layout(_width, _height, _content, _maxLevels);
+	base = _out;
+	generate(_rgba, _content, _filter);
+}
+
+void MipChain::generate(const unsigned char* _rgba, MipContent _content, MipFilter _filter) {
+	const uint count = levels();
+	const uint width = bounds[0].x, height = bounds[0].y;
+	if (_rgba != base) std::memcpy(base, _rgba, static_cast<size_t>(width) * height * 4);
+	if (count == 1) return;
+
+	const bool parallel = !JobScheduler::isWorker();
+	std::vector<float> current(static_cast<size_t>(width) * height * 4), next, rows;
+	expand(base, width, height, _content, current.data(), parallel);
+	uint w = width, h = height;
+	for (uint i = 1; i < count; ++i) {
+		const uint nw = bounds[i].x, nh = bounds[i].y;
+		next.resize(static_cast<size_t>(nw) * nh * 4);
+		if (_filter == MipFilter::box)
+			boxDown(current.data(), w, h, next.data(), parallel);
+		else {
+			rows.resize(static_cast<size_t>(nw) * h * 4);
+			kaiserRows(current.data(), w, h, rows.data(), parallel);
+			kaiserColumns(rows.data(), nw, h, next.data(), parallel);
+		}
+		encode(next.data(), nw, nh, _content, base + offsets[i], parallel);
+		current.swap(next);
+		w = nw;
+		h = nh;
+	}
+}
+
+void MipChain::clear() {
+	//releases the memory, a chain is usually dropped right after the upload
+	std::vector<unsigned char>().swap(pixels);
+	bounds.clear();
+	offsets.clear();
+	base = nullptr;
+	total = 0;
+}
+
+uint MipChain::levels() {
+	return static_cast<uint>(bounds.size());
+}
+
+const unsigned char* MipChain::level(uint _level) {
+	return base + offsets[_level];
+}
+
+Vec2u MipChain::levelBounds(uint _level) {
+	return bounds[_level];
+}
+
+size_t MipChain::levelSize(uint _level) {
+	return static_cast<size_t>(bounds[_level].x) * bounds[_level].y * 4;
+}
+
+size_t MipChain::size() {
+	return total;
+}
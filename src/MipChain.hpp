@@ -0,0 +1,56 @@
+#pragma once
+
+#include "MainStruct.hpp"
+
+namespace Heerbann {
+
+	//---------------------- MipChain ----------------------\\
+
+	enum class MipContent : uint {
+		none, //no chain, level 0 only
+		color, //srgb encoded, filtered in linear space
+		linear, //masks, heights, roughness...
+		normal //tangent space normals in rgb, renormalized per level
+	};
+
+	enum class MipFilter : uint {
+		box, //2x2 average, cheap enough for load time
+		kaiser //kaiser windowed sinc, sharper distant levels for offline cooking
+	};
+
+	//full rgba8 mip chain built on the cpu. level 0 is the source unchanged, every further level is
+	//filtered from the float result of the one above so the error doesn't accumulate through 8 bit rounding.
+	//on a JobScheduler worker the build runs serial (the pipeline already decodes in parallel), elsewhere
+	//the rows are spread over the omp threads
+	class MipChain {
+		std::vector<unsigned char> pixels;
+		std::vector<Vec2u> bounds;
+		std::vector<size_t> offsets;
+		//pixels or the caller's memory
+		unsigned char* base = nullptr;
+		size_t total = 0;
+
+		uint layout(uint, uint, MipContent, uint);
+		void generate(const unsigned char*, MipContent, MipFilter);
+
+	public:
+		static uint levelCount(uint, uint);
+		//bytes of all levels of a chain, width, height, content, max levels
+		static size_t chainSize(uint, uint, MipContent, uint = 0);
+
+		//rgba8 source, width, height, content, filter, max levels (0 = down to 1x1)
+		void build(const unsigned char*, uint, uint, MipContent, MipFilter = MipFilter::box, uint = 0);
+		//same, but the levels go back to back into _out (chainSize bytes) instead of memory of the chain.
+		//_out has to outlive the use of level(). the source may be _out itself, level 0 is then left in place
+		void build(unsigned char*, const unsigned char*, uint, uint, MipContent, MipFilter = MipFilter::box, uint = 0);
+		void clear();
+
+		uint levels();
+		const unsigned char* level(uint);
+		Vec2u levelBounds(uint);
+		size_t levelSize(uint);
+		//all levels together
+		size_t size();
+	};
+
+}
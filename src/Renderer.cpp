@@ -76,12 +76,16 @@ bool TextureDebugRenderer::glUnload(void*) {
 
 TextureDebugRenderer::TextureDebugRenderer() : Renderer("TextureDebugRenderer") {}
 
+TextureDebugRenderer::~TextureDebugRenderer() {
+	destroy();
+}
+
 void TextureDebugRenderer::add(Renderable* _renderable) {
 	renderables.emplace_back(_renderable);
 }
 
-void TextureDebugRenderer::add(std::vector<Renderable*> _renderables) {
-	renderables.emplace_back(_renderables.begin(), _renderables.end());
+void TextureDebugRenderer::add(Renderable* const* _renderables, uint _count) {
+	renderables.insert(renderables.end(), _renderables, _renderables + _count);
 }
 
 void TextureDebugRenderer::draw(View* _view) {
@@ -221,25 +225,32 @@ bool ShadowRenderer::glUnload(void*) {
 
 ShadowRenderer::ShadowRenderer(std::string _id, uint _renderType) : Renderer(_id), renderType(_renderType) {}
 
+ShadowRenderer::~ShadowRenderer() {
+	destroy();
+}
+
 void ShadowRenderer::add(Renderable* _renderable) {
 	renderables.emplace_back(reinterpret_cast<ShadowRenderable*>(_renderable));
 }
 
-void ShadowRenderer::add(std::vector<Renderable*> _renderables) {
-	for (auto r : _renderables)
-		add(r);
+void ShadowRenderer::add(Renderable* const* _renderables, uint _count) {
+	renderables.reserve(renderables.size() + _count);
+	for (uint i = 0; i < _count; ++i)
+		add(_renderables[i]);
 }
 
 void ShadowRenderer::draw(View* _view) {
 	shader->bind();
 	for (auto r : renderables) {
 		r->light->shadowMap->bind();
-		for (auto p : r->models) {
+		for (uint i = 0; i < r->modelCount; ++i) {
+			auto& p = r->models[i];
 			Model* m = p.second;
 			m->bindTransform(2);
 			r->light->bindLightTransform(1, m->position, 1500.f, 500.f);//TODO distance for dir light?
 
 			auto& dc = p.first;
+			dc.bindDequantization(3);
 			glBindVertexArray(dc.vao);
 			glDrawElements(GL_TRIANGLES, dc.count, GL_UNSIGNED_INT, (void*)(dc.offset * sizeof(uint)));
 			glBindVertexArray(0);
@@ -247,6 +258,7 @@ void ShadowRenderer::draw(View* _view) {
 		r->light->shadowMap->unbind();
 	}
 	shader->unbind();
+	renderables.clear();
 
 	GLError("TestWorldLevel::draw::" + id);
 }
@@ -272,10 +284,20 @@ bool VoxelBackGroundRenderer::glUnload(void*) {
 
 VoxelBackGroundRenderer::VoxelBackGroundRenderer(std::string _id) : Renderer(_id) {}
 
+VoxelBackGroundRenderer::~VoxelBackGroundRenderer() {
+	destroy();
+}
+
 void VoxelBackGroundRenderer::add(Renderable* _renderable) {
 	renderables.emplace_back(reinterpret_cast<VoxelRenderable*>(_renderable));
 }
 
+void VoxelBackGroundRenderer::add(Renderable* const* _renderables, uint _count) {
+	renderables.reserve(renderables.size() + _count);
+	for (uint i = 0; i < _count; ++i)
+		add(_renderables[i]);
+}
+
 void VoxelBackGroundRenderer::draw(View* _view) {
 	//TODO
 	BoundingBox* aabb = _view->getCamera()->frustum->toAABB(_view->getCamera());
@@ -310,25 +332,33 @@ void Heerbann::VSMLightRenderer::load() {
 }
 
 bool Heerbann::VSMLightRenderer::glLoad(void *) {
-	return false;
+	if (!shaders[0]->loaded() || !shaders[1]->loaded()) return false;
+	isLoaded = true;
+	return true;
 }
 
 bool VSMLightRenderer::glUnload(void*) {
-	delete shader;
+	//the variants belong to the registry and may be shared
 	return true;
 }
 
 VSMLightRenderer::VSMLightRenderer(std::string _id) : Renderer(_id) {
-	shader = new ShaderProgram("shader/vsm/shader_vsm_s2_light");
+	shaders[0] = ShaderProgram::variant("shader/vsm/shader_vsm_s2_light");
+	shaders[1] = ShaderProgram::variant("shader/vsm/shader_vsm_s2_light", { "HAS_TEXTURE" });
+}
+
+VSMLightRenderer::~VSMLightRenderer() {
+	destroy();
 }
 
 void VSMLightRenderer::add(Renderable* _renderable) {
 	renderables.emplace_back(reinterpret_cast<VSMLightRenderable*>(_renderable));
 }
 
-void VSMLightRenderer::add(std::vector<Renderable*> _renderables) {
-	for (auto r : _renderables)
-		add(r);
+void VSMLightRenderer::add(Renderable* const* _renderables, uint _count) {
+	renderables.reserve(renderables.size() + _count);
+	for (uint i = 0; i < _count; ++i)
+		add(_renderables[i]);
 }
 
 void VSMLightRenderer::draw(View* _view) {
@@ -336,8 +366,13 @@ void VSMLightRenderer::draw(View* _view) {
 		renderables.clear();
 		return;
 	}
-	shader->bind();
+	ShaderProgram* bound = nullptr;
 	for (auto r : renderables) {
+		ShaderProgram* shader = shaders[r->texture == nullptr ? 0 : 1];
+		if (shader != bound) {
+			shader->bind();
+			bound = shader;
+		}
 
 		r->model->bindTransform(3);
 		r->model->bindinvTransform(4);
@@ -353,17 +388,17 @@ void VSMLightRenderer::draw(View* _view) {
 		r->matBuffer->bind(2);
 
 		glUniform1ui(7, r->matIndex);
-		glUniform1ui(8, r->texture == nullptr ? 0 : 1);
+		r->drawC.bindDequantization(8);
 
 		glBindVertexArray(r->drawC.vao);
-		glDrawElements(GL_TRIANGLES, r->drawC.offset, GL_UNSIGNED_INT, (void*)(r->drawC.count * sizeof(uint)));
+		glDrawElements(GL_TRIANGLES, r->drawC.count, GL_UNSIGNED_INT, (void*)(r->drawC.offset * sizeof(uint)));
 		glBindVertexArray(0);
 
 		glBindTexture(GL_TEXTURE_2D, 0);
 		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 
 	}
-	shader->unbind();
+	if (bound != nullptr) bound->unbind();
 	renderables.clear();
 	GLError("VSMLightRenderer::draw");
 }
@@ -385,13 +420,18 @@ bool VSMShadowRenderer::glUnload(void*) {
 
 VSMShadowRenderer::VSMShadowRenderer(std::string _id) : Renderer(_id) {}
 
+VSMShadowRenderer::~VSMShadowRenderer() {
+	destroy();
+}
+
 void VSMShadowRenderer::add(Renderable* _renderable) {
-	renderables.emplace_back(reinterpret_cast<VSMShadownRenderable*>(_renderable));
+	renderables.emplace_back(reinterpret_cast<VSMShadowRenderable*>(_renderable));
 }
 
-void VSMShadowRenderer::add(std::vector<Renderable*> _renderables) {
-	for (auto r : _renderables)
-		add(r);
+void VSMShadowRenderer::add(Renderable* const* _renderables, uint _count) {
+	renderables.reserve(renderables.size() + _count);
+	for (uint i = 0; i < _count; ++i)
+		add(_renderables[i]);
 }
 
 void VSMShadowRenderer::draw(View* _view) {
@@ -399,7 +439,8 @@ void VSMShadowRenderer::draw(View* _view) {
 	_view->bindCombined(2);
 	for (auto r : renderables) {
 		r->model->bindTransform(2);
-		for (auto l : r->lights) {
+		for (uint i = 0; i < r->lightCount; ++i) {
+			Light* l = r->lights[i];
 			l->bindLightTransform(4, r->model->position, 1000.f, 500.f); //TODO
 			l->shadowMap->getDepth()->bind(1);
 			l->shadowMap->getTex()->bind(2);
@@ -409,6 +450,7 @@ void VSMShadowRenderer::draw(View* _view) {
 		}
 	}
 	shader->unbind();
+	renderables.clear();
 	GLError("VSMShadowRenderer::draw::" + id);
 }
 
@@ -438,68 +480,72 @@ bool VSMRenderer::glUnload(void*) {
 
 VSMRenderer::VSMRenderer(std::string _id) : Renderer(_id) {}
 
+VSMRenderer::~VSMRenderer() {
+	destroy();
+}
+
 void VSMRenderer::add(Renderable* _renderable) {
 	renderables.emplace_back(reinterpret_cast<VSMRenderable*>(_renderable));
 }
 
-void VSMRenderer::add(std::vector<Renderable*> _renderables) {
-	for (auto r : _renderables)
-		add(r);
+void VSMRenderer::add(Renderable* const* _renderables, uint _count) {
+	renderables.reserve(renderables.size() + _count);
+	for (uint i = 0; i < _count; ++i)
+		add(_renderables[i]);
 }
 
 void VSMRenderer::draw(View* _view) {
+	//all transient data lives in the frame arena, nothing here touches the heap
+	FrameArena* arena = M_Arena;
 
-
-	auto lights = M_Env->queryLights(_view);
+	uint lightCount = 0;
+	Light** lights = M_Env->queryLights(_view, lightCount);
+	uint count = static_cast<uint>(renderables.size());
 
 	//shadowMapR
-	std::vector<Renderable*> shadowRenderables(lights.size());
-	std::vector<std::pair<DrawCall, Model*>> shadowDrawCalls(renderables.size);
-	for (auto r : renderables) {
-		shadowDrawCalls.emplace_back(std::make_pair(r->drawC, r->model));
-	}
-
-	for (auto l : lights) {
-		ShadowRenderable* out = new ShadowRenderable();
-		out->light = l;
+	auto shadowDrawCalls = arena->alloc<std::pair<DrawCall, Model*>>(count);
+	for (uint i = 0; i < count; ++i)
+		shadowDrawCalls[i] = std::make_pair(renderables[i]->drawC, renderables[i]->model);
+
+	Renderable** shadowMapRenderables = arena->alloc<Renderable*>(lightCount);
+	for (uint i = 0; i < lightCount; ++i) {
+		ShadowRenderable* out = arena->create<ShadowRenderable>();
+		out->light = lights[i];
 		out->models = shadowDrawCalls;
-		shadowRenderables.emplace_back(out);
+		out->modelCount = count;
+		shadowMapRenderables[i] = out;
 	}
-	shadowMapR->add(shadowRenderables);
+	shadowMapR->add(shadowMapRenderables, lightCount);
 
 	//lightR
-	std::vector<Renderable*> VSMLightRenderables(renderables.size);
-	for (auto r : renderables) {
-		VSMLightRenderable* out = new VSMLightRenderable();
+	Renderable** lightRenderables = arena->alloc<Renderable*>(count);
+	for (uint i = 0; i < count; ++i) {
+		VSMRenderable* r = renderables[i];
+		VSMLightRenderable* out = arena->create<VSMLightRenderable>();
 		out->drawC = r->drawC;
 		out->model = r->model;
 		out->matBuffer = r->model->getData()->matBuffer;
 		out->texture = r->tex;
 		out->matIndex = r->matIndex;
-		VSMLightRenderables.emplace_back(out);
+		lightRenderables[i] = out;
 	}
-	lightR->add(VSMLightRenderables);
+	lightR->add(lightRenderables, count);
 
 	//shadowR
-	std::vector<Renderable*> shadowRenderables(renderables.size);
-	for (auto r : renderables) {
-		VSMShadowRenderable* out = new VSMShadowRenderable();
+	Renderable** shadowRenderables = arena->alloc<Renderable*>(count);
+	for (uint i = 0; i < count; ++i) {
+		VSMShadowRenderable* out = arena->create<VSMShadowRenderable>();
 		out->lights = lights;
-		out->model = r->model;
-		shadowRenderables.emplace_back(out);
+		out->lightCount = lightCount;
+		out->model = renderables[i]->model;
+		shadowRenderables[i] = out;
 	}
-	shadowR->add(shadowRenderables);
+	shadowR->add(shadowRenderables, count);
 
 	//draw
 	shadowMapR->draw(_view);
 	lightR->draw(_view);
 	shadowR->draw(_view);
 
-	for (auto r : shadowRenderables)
-		delete r;
-
-	for (auto r : VSMLightRenderables)
-		delete r;
-
 	renderables.clear();
 }
\ No newline at end of file
@@ -11,7 +11,8 @@ namespace Heerbann {
 	public:
 		Renderer(std::string);
 		virtual void add(Renderable*) = 0;
-		virtual void add(std::vector<Renderable*>) = 0;
+		//span of renderables. they are only read until the next draw, so they can live in the FrameArena
+		virtual void add(Renderable* const*, uint) = 0;
 		virtual void draw(View*) = 0;
 	};
 
@@ -58,14 +59,16 @@ namespace Heerbann {
 		bool glUnload(void*) override;
 	public:
 		TextureDebugRenderer();
+		~TextureDebugRenderer();
 		void add(Renderable*) override;
-		void add(std::vector<Renderable*>) override;
+		void add(Renderable* const*, uint) override;
 		void draw(View*) override;
 	};
 
 	struct ShadowRenderable : Renderable {
-		Light* light;
-		std::vector<std::pair<DrawCall, Model*>> models;
+		Light* light = nullptr;
+		const std::pair<DrawCall, Model*>* models = nullptr;
+		uint modelCount = 0;
 	};
 
 	class ShadowRenderer : public Renderer {
@@ -80,8 +83,9 @@ namespace Heerbann {
 	public:
 		enum { VSM };
 		ShadowRenderer(std::string, uint);
+		~ShadowRenderer();
 		void add(Renderable*) override;
-		void add(std::vector<Renderable*>) override;
+		void add(Renderable* const*, uint) override;
 		void draw(View*) override;
 	};
 
@@ -116,7 +120,9 @@ namespace Heerbann {
 	public:
 		uint VOXELS = 102;
 		VoxelBackGroundRenderer(std::string);
+		~VoxelBackGroundRenderer();
 		void add(Renderable*) override;
+		void add(Renderable* const*, uint) override;
 		void draw(View*) override;
 	};
 
@@ -131,7 +137,8 @@ namespace Heerbann {
 	};
 
 	class VSMLightRenderer : public Renderer {
-		ShaderProgram* shader;
+		//permutations of the light shader, indexed by whether the renderable has a texture
+		ShaderProgram* shaders[2];
 		std::vector<VSMLightRenderable*> renderables;
 	protected:
 		void load() override;
@@ -139,14 +146,16 @@ namespace Heerbann {
 		bool glUnload(void*) override;
 	public:
 		VSMLightRenderer(std::string);
+		~VSMLightRenderer();
 		void add(Renderable*) override;
-		void add(std::vector<Renderable*>) override;
+		void add(Renderable* const*, uint) override;
 		void draw(View*) override;
 	};
 
 	struct VSMShadowRenderable : Renderable {
-		Model* model;
-		std::vector<Light*> lights;
+		Model* model = nullptr;
+		Light* const* lights = nullptr;
+		uint lightCount = 0;
 	};
 
 	class VSMShadowRenderer : public Renderer {
@@ -159,8 +168,9 @@ namespace Heerbann {
 		bool glUnload(void*) override;
 	public:
 		VSMShadowRenderer(std::string);
+		~VSMShadowRenderer();
 		void add(Renderable*) override;
-		void add(std::vector<Renderable*>) override;
+		void add(Renderable* const*, uint) override;
 		void draw(View*) override;
 	};
 
@@ -189,8 +199,9 @@ namespace Heerbann {
 		bool glUnload(void*) override;
 	public:
 		VSMRenderer(std::string);
+		~VSMRenderer();
 		void add(Renderable*) override;
-		void add(std::vector<Renderable*>) override;
+		void add(Renderable* const*, uint) override;
 		void draw(View*) override;
 	};
 
@@ -0,0 +1,140 @@
+#include "StreamBuffer.hpp"
+
+using namespace Heerbann;
+
+//---------------------- StreamBuffer ----------------------\\
+
+inline unsigned long long alignUp(unsigned long long _value, unsigned long long _align) {
+	return (_value + _align - 1) / _align * _align;
+}
+
+GLenum StreamBuffer::targetFor(StreamUsage _usage) {
+	switch (_usage) {
+		case StreamUsage::vertex: return GL_ARRAY_BUFFER;
+		case StreamUsage::index: return GL_ELEMENT_ARRAY_BUFFER;
+		case StreamUsage::uniform: return GL_UNIFORM_BUFFER;
+		default: return GL_SHADER_STORAGE_BUFFER;
+	}
+}
+
+StreamBuffer::StreamBuffer(StreamUsage _usage, size_t _capacity) : usage(_usage), target(targetFor(_usage)), capacity(_capacity) {
+	assert(_capacity > 0);
+	GLint offsetAlignment = 0;
+	if (_usage == StreamUsage::uniform)
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+	else if (_usage == StreamUsage::storage)
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+	alignment = std::max<size_t>(alignment, static_cast<size_t>(offsetAlignment));
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &handle);
+	glBindBuffer(target, handle);
+	glBufferStorage(target, capacity, nullptr, flags);
+	data = reinterpret_cast<char*>(glMapBufferRange(target, 0, capacity, flags));
+	glBindBuffer(target, 0);
+	GLError("StreamBuffer::StreamBuffer");
+	assert(data != nullptr);
+}
+
+StreamBuffer::~StreamBuffer() {
+	for (auto& s : segments)
+		glDeleteSync(s.fence);
+	glBindBuffer(target, handle);
+	glUnmapBuffer(target);
+	glBindBuffer(target, 0);
+	glDeleteBuffers(1, &handle);
+}
+
+bool StreamBuffer::retire(bool _wait) {
+	bool waited = false;
+	while (!segments.empty()) {
+		Segment& s = segments.front();
+		GLenum status = glClientWaitSync(s.fence, 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED && _wait && !waited) {
+			++stalls;
+			waited = true;
+			//the first wait flushes, the fence might still sit in the command queue
+			do status = glClientWaitSync(s.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+			while (status == GL_TIMEOUT_EXPIRED);
+		}
+		if (status == GL_TIMEOUT_EXPIRED) break;
+		//a failed wait is treated as done, spinning on it would hang the frame
+		if (status == GL_WAIT_FAILED) GLError("StreamBuffer::retire");
+		tail = s.end;
+		glDeleteSync(s.fence);
+		segments.pop_front();
+		//only wait for as much as needed
+		if (waited) break;
+	}
+	if (segments.empty()) tail = frameBegin;
+	return waited;
+}
+
+StreamRange StreamBuffer::allocate(size_t _size, size_t _align) {
+	const unsigned long long align = std::max<unsigned long long>(alignment, _align);
+	unsigned long long begin = alignUp(head, align);
+	//a range never straddles the end of the buffer, skip to the start of the next lap instead
+	if (begin % capacity + _size > capacity)
+		begin = alignUp(begin, capacity);
+	const unsigned long long end = begin + _size;
+	if (end - frameBegin > capacity) {
+		LOG("stream buffer overflow: " + std::to_string(end - frameBegin) + " of " + std::to_string(capacity) + " bytes in one frame");
+		throw new std::exception("stream buffer overflow, raise MainConfig::streamSizes");
+	}
+	while (end - tail > capacity)
+		retire(true);
+
+	head = end;
+	last = begin;
+	StreamRange out;
+	out.offset = static_cast<GLintptr>(begin % capacity);
+	out.pntr = data + out.offset;
+	out.size = static_cast<GLsizeiptr>(_size);
+	return out;
+}
+
+void StreamBuffer::shrink(StreamRange& _range, size_t _size) {
+	assert(static_cast<unsigned long long>(_range.offset) == last % capacity && "only the latest allocation can shrink");
+	assert(_size <= static_cast<size_t>(_range.size));
+	head = last + _size;
+	_range.size = static_cast<GLsizeiptr>(_size);
+}
+
+void StreamBuffer::flip() {
+	if (head != frameBegin) {
+		peak = std::max<size_t>(peak, static_cast<size_t>(head - frameBegin));
+		segments.push_back({ head, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+		frameBegin = head;
+	}
+	retire(false);
+}
+
+void StreamBuffer::bind() const {
+	glBindBuffer(target, handle);
+}
+
+void StreamBuffer::bindRange(uint _binding, const StreamRange& _range) const {
+	assert(usage == StreamUsage::uniform || usage == StreamUsage::storage);
+	glBindBufferRange(target, _binding, handle, _range.offset, _range.size);
+	GLError("StreamBuffer::bindRange");
+}
+
+GLuint StreamBuffer::getHandle() const {
+	return handle;
+}
+
+GLenum StreamBuffer::getTarget() const {
+	return target;
+}
+
+size_t StreamBuffer::getCapacity() const {
+	return capacity;
+}
+
+size_t StreamBuffer::peakUsage() const {
+	return peak;
+}
+
+uint StreamBuffer::stallCount() const {
+	return stalls;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "MainStruct.hpp"
+
+namespace Heerbann {
+
+	//---------------------- StreamBuffer ----------------------\\
+
+	enum class StreamUsage : uint {
+		vertex, index, uniform, storage
+	};
+
+	//a piece of a StreamBuffer. pntr is write only (coherent, no flush needed), offset is into the gl buffer.
+	//the range is owned by the frame it was allocated in, write it, draw from it and forget it
+	struct StreamRange {
+		void* pntr = nullptr;
+		GLintptr offset = 0;
+		GLsizeiptr size = 0;
+
+		template<class T>
+		inline T* as() const {
+			return reinterpret_cast<T*>(pntr);
+		};
+	};
+
+	//one persistently mapped buffer sub allocated as a ring for per frame cpu to gpu data. flip closes the
+	//allocations of the frame with a fence, allocate only blocks if the ring caught up with a frame the gpu
+	//is still reading. main thread only
+	class StreamBuffer {
+
+		struct Segment {
+			//head at the flip, everything below is covered by the fence
+			unsigned long long end;
+			GLsync fence;
+		};
+
+		const StreamUsage usage;
+		const GLenum target;
+		GLuint handle = 0;
+		char* data = nullptr;
+		const size_t capacity;
+		size_t alignment = 16;
+
+		//monotonic positions, the offset into the buffer is the position % capacity
+		unsigned long long head = 0;
+		unsigned long long frameBegin = 0;
+		//the gpu is done with everything below
+		unsigned long long tail = 0;
+		//start of the latest allocation, for shrink
+		unsigned long long last = 0;
+		std::deque<Segment> segments;
+
+		size_t peak = 0;
+		uint stalls = 0;
+
+		//drops the finished segments, blocking on the oldest one if _wait is set
+		bool retire(bool _wait);
+
+	public:
+		//needs a gl context
+		StreamBuffer(StreamUsage, size_t);
+		~StreamBuffer();
+
+		//size in bytes, alignment (0 = the usage's offset alignment). throws if a single frame exceeds the capacity
+		StreamRange allocate(size_t, size_t = 0);
+
+		template<class T>
+		StreamRange allocate(uint _count) {
+			return allocate(sizeof(T) * _count, alignof(T));
+		};
+
+		//gives the unused end of the latest allocation back, for writers that reserve the worst case
+		void shrink(StreamRange&, size_t);
+
+		//once per frame after the frame's draws were submitted
+		void flip();
+
+		//binds the whole buffer to the usage's target
+		void bind() const;
+		//indexed binding of a range, uniform & storage only
+		void bindRange(uint, const StreamRange&) const;
+
+		GLuint getHandle() const;
+		GLenum getTarget() const;
+		size_t getCapacity() const;
+		//largest frame so far in bytes
+		size_t peakUsage() const;
+		//how often allocate had to wait for the gpu
+		uint stallCount() const;
+
+		static GLenum targetFor(StreamUsage);
+	};
+
+}
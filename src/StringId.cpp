@@ -0,0 +1,38 @@
+#include "StringId.hpp"
+
+using namespace Heerbann;
+
+//---------------------- StringId ----------------------\\
+
+struct InternTable {
+	std::mutex lock;
+	//node based, references handed out by str stay valid
+	std::unordered_map<unsigned long long, std::string> names;
+};
+
+InternTable& internTable() {
+	static InternTable out;
+	return out;
+}
+
+StringId StringId::intern(const std::string& _str) {
+	StringId out(_str);
+	InternTable& table = internTable();
+	std::lock_guard<std::mutex> guard(table.lock);
+	auto it = table.names.find(out.value);
+	if (it == table.names.end())
+		table.names.emplace(out.value, _str);
+	else if (it->second != _str) {
+		LOG("string id collision between [" + it->second + "] and [" + _str + "]");
+		assert(false && "string id collision");
+	}
+	return out;
+}
+
+const std::string& StringId::str() const {
+	static const std::string empty;
+	InternTable& table = internTable();
+	std::lock_guard<std::mutex> guard(table.lock);
+	auto it = table.names.find(value);
+	return it == table.names.end() ? empty : it->second;
+}
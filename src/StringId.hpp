@@ -0,0 +1,237 @@
+#pragma once
+
+#include "MainStruct.hpp"
+
+namespace Heerbann {
+
+	//---------------------- StringId ----------------------\\
+
+	//64 bit fnv-1a of a string, compared & hashed as a single integer. literals are hashed at compile time,
+	//runtime strings on construction without allocating. intern additionally records the string in a global
+	//table so str() can name the id in logs, registries intern their keys when an entry is added
+	class StringId {
+		unsigned long long value = 0;
+
+		static constexpr unsigned long long fnv(const char* _str, size_t _length) {
+			unsigned long long out = 0xcbf29ce484222325ull;
+			for (size_t i = 0; i < _length; ++i) {
+				out ^= static_cast<unsigned char>(_str[i]);
+				out *= 0x100000001b3ull;
+			}
+			return out;
+		}
+
+	public:
+		constexpr StringId() = default;
+		template<size_t N>
+		constexpr StringId(const char(&_literal)[N]) : value(fnv(_literal, N - 1)) {}
+		constexpr StringId(const char* _str, size_t _length) : value(fnv(_str, _length)) {}
+		StringId(const std::string& _str) : value(fnv(_str.data(), _str.size())) {}
+
+		//any thread. asserts if a different string was interned with the same hash
+		static StringId intern(const std::string&);
+
+		constexpr unsigned long long hash() const {
+			return value;
+		}
+
+		//the interned string, empty if the id never went through intern
+		const std::string& str() const;
+
+		constexpr bool operator==(const StringId& _other) const {
+			return value == _other.value;
+		}
+
+		constexpr bool operator!=(const StringId& _other) const {
+			return value != _other.value;
+		}
+
+		constexpr bool operator<(const StringId& _other) const {
+			return value < _other.value;
+		}
+	};
+
+	constexpr StringId operator"" _sid(const char* _str, size_t _length) {
+		return StringId(_str, _length);
+	}
+
+	//---------------------- FlatMap ----------------------\\
+
+	//open addressing hash map with linear probing over a single array, power of two capacity.
+	//erase shifts the following entries back instead of leaving tombstones. any insert or erase
+	//invalidates iterators & pointers into the map
+	template<class K, class V, class H = std::hash<K>>
+	class FlatMap {
+	public:
+		typedef std::pair<K, V> value_type;
+
+	private:
+		std::vector<value_type> slots;
+		std::vector<unsigned char> used;
+		size_t entries = 0;
+
+		inline size_t home(const K& _key) const {
+			return static_cast<size_t>(H()(_key)) & (slots.size() - 1);
+		};
+
+		size_t slot(const K& _key) const {
+			if (entries == 0) return slots.size();
+			for (size_t i = home(_key);; i = (i + 1) & (slots.size() - 1)) {
+				if (!used[i]) return slots.size();
+				if (slots[i].first == _key) return i;
+			}
+		};
+
+		void rehash(size_t _capacity) {
+			std::vector<value_type> previous = std::move(slots);
+			std::vector<unsigned char> previousUsed = std::move(used);
+			slots.assign(_capacity, value_type());
+			used.assign(_capacity, 0);
+			for (size_t i = 0; i < previous.size(); ++i) {
+				if (!previousUsed[i]) continue;
+				size_t k = home(previous[i].first);
+				while (used[k]) k = (k + 1) & (slots.size() - 1);
+				slots[k] = std::move(previous[i]);
+				used[k] = 1;
+			}
+		};
+
+	public:
+		template<bool Const>
+		class Iterator {
+			friend FlatMap;
+			typedef typename std::conditional<Const, const FlatMap, FlatMap>::type Map;
+			typedef typename std::conditional<Const, const value_type, value_type>::type Value;
+			Map* map;
+			size_t index;
+
+			Iterator(Map* _map, size_t _index) : map(_map), index(_index) {
+				while (index < map->slots.size() && !map->used[index]) ++index;
+			};
+
+		public:
+			inline Value& operator*() const {
+				return map->slots[index];
+			};
+
+			inline Value* operator->() const {
+				return &map->slots[index];
+			};
+
+			inline Iterator& operator++() {
+				do ++index; while (index < map->slots.size() && !map->used[index]);
+				return *this;
+			};
+
+			inline bool operator==(const Iterator& _other) const {
+				return index == _other.index;
+			};
+
+			inline bool operator!=(const Iterator& _other) const {
+				return index != _other.index;
+			};
+		};
+
+		typedef Iterator<false> iterator;
+		typedef Iterator<true> const_iterator;
+
+		iterator begin() {
+			return iterator(this, 0);
+		};
+
+		iterator end() {
+			return iterator(this, slots.size());
+		};
+
+		const_iterator begin() const {
+			return const_iterator(this, 0);
+		};
+
+		const_iterator end() const {
+			return const_iterator(this, slots.size());
+		};
+
+		iterator find(const K& _key) {
+			return iterator(this, slot(_key));
+		};
+
+		const_iterator find(const K& _key) const {
+			return const_iterator(this, slot(_key));
+		};
+
+		size_t count(const K& _key) const {
+			return slot(_key) == slots.size() ? 0 : 1;
+		};
+
+		//the value or nullptr, for maps of pointers: get(key) instead of find & compare
+		V get(const K& _key) const {
+			size_t i = slot(_key);
+			return i == slots.size() ? V() : slots[i].second;
+		};
+
+		V& operator[](const K& _key) {
+			size_t i = slot(_key);
+			if (i != slots.size()) return slots[i].second;
+			//grows at 3/4 load
+			if ((entries + 1) * 4 > slots.size() * 3)
+				rehash(std::max<size_t>(16, slots.size() * 2));
+			i = home(_key);
+			while (used[i]) i = (i + 1) & (slots.size() - 1);
+			slots[i] = value_type(_key, V());
+			used[i] = 1;
+			++entries;
+			return slots[i].second;
+		};
+
+		size_t erase(const K& _key) {
+			size_t i = slot(_key);
+			if (i == slots.size()) return 0;
+			const size_t mask = slots.size() - 1;
+			//backward shift: pull every following entry whose home isn't in (i, j] into the hole
+			for (size_t j = (i + 1) & mask; used[j]; j = (j + 1) & mask) {
+				size_t h = home(slots[j].first);
+				bool stays = i <= j ? (i < h && h <= j) : (i < h || h <= j);
+				if (stays) continue;
+				slots[i] = std::move(slots[j]);
+				i = j;
+			}
+			slots[i] = value_type();
+			used[i] = 0;
+			--entries;
+			return 1;
+		};
+
+		void reserve(size_t _count) {
+			size_t capacity = 16;
+			while (capacity * 3 < _count * 4) capacity *= 2;
+			if (capacity > slots.size()) rehash(capacity);
+		};
+
+		void clear() {
+			slots.clear();
+			used.clear();
+			entries = 0;
+		};
+
+		size_t size() const {
+			return entries;
+		};
+
+		bool empty() const {
+			return entries == 0;
+		};
+	};
+
+}
+
+namespace std {
+
+	template<>
+	struct hash<Heerbann::StringId> {
+		//already a hash
+		inline size_t operator()(const Heerbann::StringId& _id) const {
+			return static_cast<size_t>(_id.hash());
+		};
+	};
+
+}
@@ -0,0 +1,330 @@
+#include "TextureCompression.hpp"
+#include "MipChain.hpp"
+
+#include <fstream>
+#include <climits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BLOCK_SSE2
+#endif
+
+using namespace Heerbann;
+
+//---------------------- BlockCompressor ----------------------\\
+
+uint BlockCompressor::blockBytes(BlockFormat _format) {
+	return _format == BlockFormat::bc1 || _format == BlockFormat::bc4 ? 8 : 16;
+}
+
+GLenum BlockCompressor::glFormat(BlockFormat _format) {
+	switch (_format) {
+		case BlockFormat::bc1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		case BlockFormat::bc3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case BlockFormat::bc4: return GL_COMPRESSED_RED_RGTC1;
+		case BlockFormat::bc5: return GL_COMPRESSED_RG_RGTC2;
+	}
+	return GL_NONE;
+}
+
+size_t BlockCompressor::levelSize(BlockFormat _format, uint _width, uint _height) {
+	return static_cast<size_t>((_width + 3) / 4) * ((_height + 3) / 4) * blockBytes(_format);
+}
+
+BlockFormat BlockCompressor::formatFor(const std::string& _path) {
+	auto has = [&](const char* _suffix)->bool {
+		return _path.find(_suffix) != std::string::npos;
+	};
+	if (has("_normal")) return BlockFormat::bc5;
+	if (has("_basecolor") || has("_albedo") || has("_diffuse")) return BlockFormat::bc1;
+	if (has("_ao") || has("_height") || has("_roughness") || has("_metallic")) return BlockFormat::bc4;
+	return BlockFormat::bc3;
+}
+
+//channel wise min & max of 16 rgba8 texels
+inline void blockBounds(const unsigned char* _texels, unsigned char* _min, unsigned char* _max) {
+#ifdef BLOCK_SSE2
+	__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_texels));
+	__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_texels + 16));
+	__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_texels + 32));
+	__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_texels + 48));
+	__m128i mn = _mm_min_epu8(_mm_min_epu8(a, b), _mm_min_epu8(c, d));
+	__m128i mx = _mm_max_epu8(_mm_max_epu8(a, b), _mm_max_epu8(c, d));
+	//fold the 4 texels per register down to one
+	mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 8));
+	mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 4));
+	mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 8));
+	mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 4));
+	int lo = _mm_cvtsi128_si32(mn);
+	int hi = _mm_cvtsi128_si32(mx);
+	std::memcpy(_min, &lo, 4);
+	std::memcpy(_max, &hi, 4);
+#else
+	for (uint c = 0; c < 4; ++c) {
+		_min[c] = 255;
+		_max[c] = 0;
+	}
+	for (uint i = 0; i < 16; ++i)
+		for (uint c = 0; c < 4; ++c) {
+			_min[c] = std::min(_min[c], _texels[i * 4 + c]);
+			_max[c] = std::max(_max[c], _texels[i * 4 + c]);
+		}
+#endif
+}
+
+inline unsigned short to565(int _r, int _g, int _b) {
+	return static_cast<unsigned short>(((_r >> 3) << 11) | ((_g >> 2) << 5) | (_b >> 3));
+}
+
+inline void from565(unsigned short _c, int* _out) {
+	int r = (_c >> 11) & 31, g = (_c >> 5) & 63, b = _c & 31;
+	_out[0] = (r << 3) | (r >> 2);
+	_out[1] = (g << 2) | (g >> 4);
+	_out[2] = (b << 3) | (b >> 2);
+}
+
+void BlockCompressor::encodeBC1(const unsigned char* _texels, unsigned char* _out) {
+	unsigned char mn[4], mx[4];
+	blockBounds(_texels, mn, mx);
+
+	//the bounding box diagonal only fits if the channels correlate, flip r & g against b where they don't
+	int lo[3] = { mn[0], mn[1], mn[2] };
+	int hi[3] = { mx[0], mx[1], mx[2] };
+	int center[3] = { (lo[0] + hi[0]) / 2, (lo[1] + hi[1]) / 2, (lo[2] + hi[2]) / 2 };
+	int covR = 0, covG = 0;
+	for (uint i = 0; i < 16; ++i) {
+		int b = _texels[i * 4 + 2] - center[2];
+		covR += (_texels[i * 4] - center[0]) * b;
+		covG += (_texels[i * 4 + 1] - center[1]) * b;
+	}
+	if (covR < 0) std::swap(lo[0], hi[0]);
+	if (covG < 0) std::swap(lo[1], hi[1]);
+
+	//inset by 1/16 of the range, the extremes are rarely hit exactly
+	for (uint c = 0; c < 3; ++c) {
+		int inset = (hi[c] - lo[c]) / 16;
+		lo[c] = std::clamp(lo[c] + inset, 0, 255);
+		hi[c] = std::clamp(hi[c] - inset, 0, 255);
+	}
+
+	unsigned short c0 = to565(hi[0], hi[1], hi[2]);
+	unsigned short c1 = to565(lo[0], lo[1], lo[2]);
+	//c0 > c1 selects the 4 color mode
+	if (c0 < c1) std::swap(c0, c1);
+
+	uint indices = 0;
+	if (c0 != c1) {
+		int palette[4][3];
+		from565(c0, palette[0]);
+		from565(c1, palette[1]);
+		for (uint c = 0; c < 3; ++c) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		for (uint i = 0; i < 16; ++i) {
+			const unsigned char* t = _texels + i * 4;
+			uint best = 0;
+			int bestDist = INT_MAX;
+			for (uint p = 0; p < 4; ++p) {
+				int dr = t[0] - palette[p][0], dg = t[1] - palette[p][1], db = t[2] - palette[p][2];
+				int dist = dr * dr + dg * dg + db * db;
+				if (dist < bestDist) {
+					bestDist = dist;
+					best = p;
+				}
+			}
+			indices |= best << (i * 2);
+		}
+	}
+
+	_out[0] = static_cast<unsigned char>(c0 & 0xFF);
+	_out[1] = static_cast<unsigned char>(c0 >> 8);
+	_out[2] = static_cast<unsigned char>(c1 & 0xFF);
+	_out[3] = static_cast<unsigned char>(c1 >> 8);
+	std::memcpy(_out + 4, &indices, 4);
+}
+
+void BlockCompressor::encodeBC4(const unsigned char* _texels, uint _channel, unsigned char* _out) {
+	unsigned char mn[4], mx[4];
+	blockBounds(_texels, mn, mx);
+	const int lo = mn[_channel];
+	const int hi = mx[_channel];
+	const int range = hi - lo;
+
+	//a0 > a1 selects the 8 value mode: code 0 = a0, 1 = a1, 2..7 step from a0 towards a1
+	unsigned long long indices = 0;
+	if (range > 0) {
+		for (uint i = 0; i < 16; ++i) {
+			int step = ((_texels[i * 4 + _channel] - lo) * 14 + range) / (2 * range);
+			unsigned long long code = step == 7 ? 0 : step == 0 ? 1 : 8 - step;
+			indices |= code << (i * 3);
+		}
+	}
+
+	_out[0] = static_cast<unsigned char>(hi);
+	_out[1] = static_cast<unsigned char>(lo);
+	for (uint i = 0; i < 6; ++i)
+		_out[2 + i] = static_cast<unsigned char>(indices >> (i * 8));
+}
+
+void BlockCompressor::compress(BlockFormat _format, const unsigned char* _rgba, uint _width, uint _height, unsigned char* _out) {
+	const uint blocksX = (_width + 3) / 4;
+	const int blocksY = static_cast<int>((_height + 3) / 4);
+	const uint bytes = blockBytes(_format);
+#pragma omp parallel for schedule(dynamic, 4)
+	for (int by = 0; by < blocksY; ++by) {
+		unsigned char block[64];
+		for (uint bx = 0; bx < blocksX; ++bx) {
+			for (uint y = 0; y < 4; ++y) {
+				uint sy = std::min(by * 4 + y, _height - 1);
+				for (uint x = 0; x < 4; ++x) {
+					uint sx = std::min(bx * 4 + x, _width - 1);
+					std::memcpy(block + (y * 4 + x) * 4, _rgba + (static_cast<size_t>(sy) * _width + sx) * 4, 4);
+				}
+			}
+			unsigned char* out = _out + (static_cast<size_t>(by) * blocksX + bx) * bytes;
+			switch (_format) {
+				case BlockFormat::bc1:
+					encodeBC1(block, out);
+					break;
+				case BlockFormat::bc3:
+					encodeBC4(block, 3, out);
+					encodeBC1(block, out + 8);
+					break;
+				case BlockFormat::bc4:
+					encodeBC4(block, 0, out);
+					break;
+				case BlockFormat::bc5:
+					encodeBC4(block, 0, out);
+					encodeBC4(block, 1, out + 8);
+					break;
+			}
+		}
+	}
+}
+
+//---------------------- CookedTexture ----------------------\\
+
+bool CookedTexture::open(const std::string& _path) {
+	if (!file.open(_path)) return false;
+	header = reinterpret_cast<const CookedTextureHeader*>(file.data());
+	table = reinterpret_cast<const CookedTextureLevel*>(file.data() + sizeof(CookedTextureHeader));
+	bool valid = file.size() >= sizeof(CookedTextureHeader) && std::memcmp(header->magic, "RTEX", 4) == 0
+		&& header->version == COOKED_TEXTURE_VERSION && header->format <= static_cast<uint>(BlockFormat::bc5)
+		&& header->levels > 0 && sizeof(CookedTextureHeader) + header->levels * sizeof(CookedTextureLevel) <= file.size();
+	for (uint i = 0; valid && i < header->levels; ++i)
+		valid = table[i].offset + table[i].size <= file.size();
+	if (!valid) {
+		close();
+		throw new std::exception((std::string("[") + _path + std::string("] is not a cooked texture")).data());
+	}
+	return true;
+}
+
+void CookedTexture::close() {
+	file.close();
+	header = nullptr;
+	table = nullptr;
+}
+
+bool CookedTexture::isOpen() {
+	return header != nullptr;
+}
+
+BlockFormat CookedTexture::getFormat() {
+	return static_cast<BlockFormat>(header->format);
+}
+
+uint CookedTexture::width() {
+	return header->width;
+}
+
+uint CookedTexture::height() {
+	return header->height;
+}
+
+uint CookedTexture::levels() {
+	return header->levels;
+}
+
+size_t CookedTexture::size() {
+	size_t out = 0;
+	for (uint i = 0; i < header->levels; ++i)
+		out += static_cast<size_t>(table[i].size);
+	return out;
+}
+
+const char* CookedTexture::level(uint _level) {
+	return file.data() + table[_level].offset;
+}
+
+size_t CookedTexture::levelSize(uint _level) {
+	return static_cast<size_t>(table[_level].size);
+}
+
+Vec2u CookedTexture::levelBounds(uint _level) {
+	return Vec2u(table[_level].width, table[_level].height);
+}
+
+bool CookedTexture::cook(const std::string& _source, const std::string& _out, BlockFormat _format) {
+	MappedFile source;
+	if (!source.open(_source)) return false;
+	sf::Image image;
+	if (!image.loadFromMemory(source.data(), source.size())) return false;
+	source.close();
+
+	const uint width = image.getSize().x;
+	const uint height = image.getSize().y;
+	const unsigned char* pixels = image.getPixelsPtr();
+
+	//bc1 has no usable alpha
+	if (_format == BlockFormat::bc1)
+		for (size_t i = 3; i < static_cast<size_t>(width) * height * 4; i += 4)
+			if (pixels[i] != 255) {
+				_format = BlockFormat::bc3;
+				break;
+			}
+
+	//offline, so the sharper kaiser filter is worth it
+	MipChain chain;
+	MipContent content = _format == BlockFormat::bc5 ? MipContent::normal : _format == BlockFormat::bc4 ? MipContent::linear : MipContent::color;
+	chain.build(pixels, width, height, content, MipFilter::kaiser);
+	const uint levelCount = chain.levels();
+
+	std::vector<CookedTextureLevel> levels(levelCount);
+	std::vector<std::vector<unsigned char>> blocks(levelCount);
+	unsigned long long offset = (sizeof(CookedTextureHeader) + levelCount * sizeof(CookedTextureLevel) + 15) & ~15ull;
+	for (uint i = 0; i < levelCount; ++i) {
+		Vec2u size = chain.levelBounds(i);
+		blocks[i].resize(BlockCompressor::levelSize(_format, size.x, size.y));
+		BlockCompressor::compress(_format, chain.level(i), size.x, size.y, blocks[i].data());
+		levels[i] = { offset, blocks[i].size(), size.x, size.y };
+		offset = (offset + blocks[i].size() + 15) & ~15ull;
+	}
+
+	CookedTextureHeader head = {};
+	std::memcpy(head.magic, "RTEX", 4);
+	head.version = COOKED_TEXTURE_VERSION;
+	head.format = static_cast<uint>(_format);
+	head.width = image.getSize().x;
+	head.height = image.getSize().y;
+	head.levels = levelCount;
+
+	std::string tmp = _out + ".tmp";
+	{
+		std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+		if (!ofs.good()) return false;
+		const char zeros[16] = {};
+		ofs.write(reinterpret_cast<const char*>(&head), sizeof(CookedTextureHeader));
+		ofs.write(reinterpret_cast<const char*>(levels.data()), levels.size() * sizeof(CookedTextureLevel));
+		unsigned long long written = sizeof(CookedTextureHeader) + levels.size() * sizeof(CookedTextureLevel);
+		for (uint i = 0; i < levelCount; ++i) {
+			ofs.write(zeros, levels[i].offset - written);
+			ofs.write(reinterpret_cast<const char*>(blocks[i].data()), blocks[i].size());
+			written = levels[i].offset + blocks[i].size();
+		}
+		if (!ofs.good()) return false;
+	}
+	std::remove(_out.c_str());
+	return std::rename(tmp.c_str(), _out.c_str()) == 0;
+}
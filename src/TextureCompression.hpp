@@ -0,0 +1,89 @@
+#pragma once
+
+#include "MainStruct.hpp"
+#include "FileSystem.hpp"
+
+namespace Heerbann {
+
+	//---------------------- BlockCompressor ----------------------\\
+
+	enum class BlockFormat : uint {
+		bc1, //rgb, 4bpp
+		bc3, //rgba, 8bpp
+		bc4, //r, 4bpp
+		bc5 //rg, 8bpp
+	};
+
+	//cpu block compression of rgba8 images into the s3tc/rgtc formats every gl 4.x driver samples natively
+	class BlockCompressor {
+	public:
+		//bytes per 4x4 block
+		static uint blockBytes(BlockFormat);
+		static GLenum glFormat(BlockFormat);
+		static size_t levelSize(BlockFormat, uint, uint);
+
+		//picks the format by the usual map suffix: _normal -> bc5, _basecolor -> bc1, _ao/_height/_roughness -> bc4
+		static BlockFormat formatFor(const std::string&);
+
+		//compresses a rgba8 image, rows of blocks are spread over the omp threads. partial edge blocks repeat the last texel
+		static void compress(BlockFormat, const unsigned char*, uint, uint, unsigned char*);
+
+		//16 rgba8 texels in, one block out
+		static void encodeBC1(const unsigned char*, unsigned char*);
+		//single channel (_channel 0..3) of 16 rgba8 texels
+		static void encodeBC4(const unsigned char*, uint, unsigned char*);
+	};
+
+	//---------------------- CookedTexture ----------------------\\
+
+	/*
+	[CookedTextureHeader][CookedTextureLevel * levels][level 0][level 1]...
+	every level is 16 byte aligned and uploaded as is with glCompressedTexSubImage
+	*/
+	#define COOKED_TEXTURE_VERSION 1
+
+	struct CookedTextureHeader {
+		char magic[4];
+		uint version;
+		uint format; //BlockFormat
+		uint width;
+		uint height;
+		uint levels;
+	};
+
+	struct CookedTextureLevel {
+		unsigned long long offset;
+		unsigned long long size;
+		uint width;
+		uint height;
+	};
+
+	//read only view of a .rtex file, packed or loose
+	class CookedTexture {
+		AssetFile file;
+		const CookedTextureHeader* header = nullptr;
+		const CookedTextureLevel* table = nullptr;
+
+	public:
+		//false if the file doesn't exist, throws if it isn't a valid cooked texture
+		bool open(const std::string&);
+		void close();
+		bool isOpen();
+
+		BlockFormat getFormat();
+		uint width();
+		uint height();
+		uint levels();
+		//all levels together
+		size_t size();
+
+		const char* level(uint);
+		size_t levelSize(uint);
+		Vec2u levelBounds(uint);
+
+		//decodes _source, builds the mip chain and writes it compressed to _out. reads loose files only,
+		//see cook in main.cpp
+		static bool cook(const std::string&, const std::string&, BlockFormat);
+	};
+
+}
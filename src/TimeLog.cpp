@@ -9,10 +9,7 @@ void Logger::log(std::string _id) {
 }
 
 TimeStamp Timer::timeStamp() {
-	auto start = std::chrono::system_clock::now();
-	std::time_t now_c = std::chrono::system_clock::to_time_t(start);
-	
-	return TimeStamp();
+	return TimeStamp{ std::chrono::steady_clock::now() };
 }
 
 void Timer::start() {
@@ -26,7 +23,70 @@ double Timer::end() {
 }
 
 std::string TimeStamp::toString() {
-	std::time_t t = std::chrono::system_clock::to_time_t(time);
-	//return std::ctime(&t);
-	return "";
+	auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+	//the fraction is padded to 3 digits, 5.007s isn't 5.7
+	std::string fraction = std::to_string(ms % 1000);
+	return std::to_string(ms / 1000) + "." + std::string(3 - fraction.size(), '0') + fraction;
+}
+
+FramePacer::FramePacer(FramePacing _pacing, float _cap, float _fixedStep, uint _maxSteps) :
+	pacing(_pacing), fixedStep(_fixedStep), maxSteps(_maxSteps) {
+	frameTime = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / _cap));
+	//never simulate more than maxSteps per frame, drop the rest instead of spiraling
+	maxFrameDelta = _fixedStep * _maxSteps;
+	//default windows timer resolution is ~15ms which is too coarse to sleep a frame
+	if (pacing == FramePacing::capped) timeBeginPeriod(1);
+	lastFrame = std::chrono::steady_clock::now();
+	deadline = lastFrame + frameTime;
+}
+
+FramePacer::~FramePacer() {
+	if (pacing == FramePacing::capped) timeEndPeriod(1);
+}
+
+void FramePacer::begin() {
+	auto now = std::chrono::steady_clock::now();
+	frameDelta = std::min(std::chrono::duration<float>(now - lastFrame).count(), maxFrameDelta);
+	lastFrame = now;
+	//freerun advances the sim by one step per frame no matter how long the frame took
+	if (pacing == FramePacing::freerun) accumulator = fixedStep;
+	else accumulator += frameDelta;
+	steps = 0;
+}
+
+bool FramePacer::step() {
+	if (accumulator < fixedStep || steps >= maxSteps) return false;
+	accumulator -= fixedStep;
+	++steps;
+	++tick;
+	return true;
+}
+
+void FramePacer::end() {
+	if (pacing != FramePacing::capped) return;
+	auto now = std::chrono::steady_clock::now();
+	//fell behind by more than a frame: restart the schedule instead of rushing to catch up
+	if (now > deadline + frameTime) deadline = now;
+	else if (now < deadline) std::this_thread::sleep_until(deadline);
+	deadline += frameTime;
+}
+
+float FramePacer::delta() {
+	return frameDelta;
+}
+
+float FramePacer::fixedDelta() {
+	return fixedStep;
+}
+
+float FramePacer::alpha() {
+	return std::min(accumulator / fixedStep, 1.f);
+}
+
+unsigned long long FramePacer::ticks() {
+	return tick;
+}
+
+FramePacing FramePacer::getPacing() {
+	return pacing;
 }
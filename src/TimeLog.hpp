@@ -4,8 +4,9 @@
 
 namespace Heerbann {
 
+	//monotonic, not related to the wall clock
 	struct TimeStamp {
-		std::chrono::system_clock::time_point time;
+		std::chrono::steady_clock::time_point time;
 		std::string toString();
 	};
 
@@ -43,4 +44,44 @@ namespace Heerbann {
 
 	};
 
+	//fixed timestep accumulator & frame limiter.
+	//per frame: begin(), while(step()) simulate, render with alpha(), end()
+	class FramePacer {
+
+		FramePacing pacing;
+		std::chrono::steady_clock::duration frameTime;
+		std::chrono::steady_clock::time_point lastFrame;
+		std::chrono::steady_clock::time_point deadline;
+
+		//seconds
+		float fixedStep;
+		float maxFrameDelta;
+		uint maxSteps;
+
+		float frameDelta = 0.f;
+		float accumulator = 0.f;
+		uint steps = 0;
+		unsigned long long tick = 0;
+
+	public:
+		//pacing, frame cap in hz (capped only), fixed step in seconds, max steps per frame
+		FramePacer(FramePacing, float, float, uint);
+		~FramePacer();
+
+		void begin();
+		//true while a fixed step is due, consumes it
+		bool step();
+		void end();
+
+		//real time of the last frame in seconds, clamped
+		float delta();
+		float fixedDelta();
+		//how far the render frame lies between the last two simulation steps [0, 1]
+		float alpha();
+		//fixed steps simulated since start
+		unsigned long long ticks();
+
+		FramePacing getPacing();
+	};
+
 }
@@ -0,0 +1,112 @@
+#include "UploadRing.hpp"
+
+using namespace Heerbann;
+
+//---------------------- UploadRing ----------------------\\
+
+//enough for any pixel row alignment & the largest bc block
+const unsigned long long SLOT_ALIGNMENT = 64;
+
+UploadRing::UploadRing(size_t _capacity) : capacity(_capacity) {
+	assert(_capacity > 0);
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &handle);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, handle);
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, capacity, nullptr, flags);
+	data = reinterpret_cast<char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, capacity, flags));
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	GLError("UploadRing::UploadRing");
+	assert(data != nullptr);
+}
+
+UploadRing::~UploadRing() {
+	for (auto& b : blocks)
+		if (b.second.fence != nullptr) glDeleteSync(b.second.fence);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, handle);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glDeleteBuffers(1, &handle);
+}
+
+bool UploadRing::allocate(size_t _size, UploadSlot& _slot) {
+	if (_size == 0 || _size > capacity) {
+		++fallbacks;
+		return false;
+	}
+	std::lock_guard<std::mutex> guard(lock);
+	unsigned long long begin = (head + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+	//a slot never straddles the end of the buffer
+	if (begin % capacity + _size > capacity)
+		begin = (begin + capacity - 1) / capacity * capacity;
+	const unsigned long long end = begin + _size;
+	if (end - tail > capacity) {
+		++fallbacks;
+		return false;
+	}
+	head = end;
+	blocks.emplace(begin, Block{ end });
+	peak = std::max<size_t>(peak, static_cast<size_t>(head - tail));
+	_slot.key = begin;
+	_slot.offset = static_cast<size_t>(begin % capacity);
+	_slot.pntr = data + _slot.offset;
+	_slot.size = _size;
+	return true;
+}
+
+void UploadRing::submit(UploadSlot& _slot) {
+	if (!_slot.valid()) return;
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	std::lock_guard<std::mutex> guard(lock);
+	auto it = blocks.find(_slot.key);
+	assert(it != blocks.end() && it->second.fence == nullptr);
+	it->second.fence = fence;
+	_slot = UploadSlot();
+}
+
+void UploadRing::cancel(UploadSlot& _slot) {
+	if (!_slot.valid()) return;
+	std::lock_guard<std::mutex> guard(lock);
+	auto it = blocks.find(_slot.key);
+	assert(it != blocks.end() && it->second.fence == nullptr);
+	it->second.cancelled = true;
+	_slot = UploadSlot();
+}
+
+void UploadRing::update() {
+	std::lock_guard<std::mutex> guard(lock);
+	while (!blocks.empty()) {
+		Block& b = blocks.begin()->second;
+		if (!b.cancelled) {
+			//still being written or copied
+			if (b.fence == nullptr) break;
+			GLenum status = glClientWaitSync(b.fence, 0, 0);
+			if (status == GL_TIMEOUT_EXPIRED) break;
+			if (status == GL_WAIT_FAILED) GLError("UploadRing::update");
+			glDeleteSync(b.fence);
+		}
+		tail = b.end;
+		blocks.erase(blocks.begin());
+	}
+	if (blocks.empty()) tail = head;
+}
+
+void UploadRing::bind() {
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, handle);
+}
+
+void UploadRing::unbind() {
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+size_t UploadRing::getCapacity() {
+	return capacity;
+}
+
+size_t UploadRing::peakUsage() {
+	std::lock_guard<std::mutex> guard(lock);
+	return peak;
+}
+
+uint UploadRing::fallbackCount() {
+	return fallbacks;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "MainStruct.hpp"
+
+#include <map>
+
+namespace Heerbann {
+
+	//---------------------- UploadRing ----------------------\\
+
+	//staging memory in the UploadRing. pntr is written by whoever allocated the slot, offset is passed
+	//to the tex(Sub)Image call in place of the client pointer while the ring is bound
+	struct UploadSlot {
+		void* pntr = nullptr;
+		size_t offset = 0;
+		size_t size = 0;
+		//monotonic position, identifies the slot in the ring
+		unsigned long long key = 0;
+
+		inline bool valid() const {
+			return pntr != nullptr;
+		};
+
+		//offset of _bytes into the slot as the pointer argument of a tex(Sub)Image call
+		inline const void* source(size_t _bytes = 0) const {
+			return reinterpret_cast<const void*>(offset + _bytes);
+		};
+	};
+
+	//one persistently mapped pixel unpack buffer sub allocated as a ring. workers allocate a slot and write
+	//the decoded texels into it, the main thread issues the copy into the texture from the buffer and submits
+	//the slot. the slot is reused once the fence behind that copy signaled, so the driver never copies from
+	//client memory and the main thread never waits on it. slots can finish out of order, the ring only
+	//advances past a slot once every slot before it is done
+	class UploadRing {
+
+		struct Block {
+			unsigned long long end;
+			GLsync fence = nullptr;
+			bool cancelled = false;
+		};
+
+		GLuint handle = 0;
+		char* data = nullptr;
+		const size_t capacity;
+
+		std::mutex lock;
+		unsigned long long head = 0;
+		unsigned long long tail = 0;
+		//live slots by key, in allocation order
+		std::map<unsigned long long, Block> blocks;
+
+		size_t peak = 0;
+		std::atomic<uint> fallbacks = 0;
+
+	public:
+		//needs a gl context
+		UploadRing(size_t);
+		~UploadRing();
+
+		//any thread. false if the ring is full or _size exceeds it, the caller uploads from client memory then
+		bool allocate(size_t, UploadSlot&);
+		//main thread, after the copies from the slot were issued
+		void submit(UploadSlot&);
+		//any thread, gives back a slot that was never submitted (cancelled or failed load)
+		void cancel(UploadSlot&);
+		//main thread, once per frame. recycles the slots whose copies finished
+		void update();
+
+		//main thread, binds the ring as GL_PIXEL_UNPACK_BUFFER
+		void bind();
+		void unbind();
+
+		size_t getCapacity();
+		//highest number of bytes in flight
+		size_t peakUsage();
+		//allocations that didn't fit
+		uint fallbackCount();
+	};
+
+}
@@ -8,52 +8,34 @@
 
 using namespace Heerbann;
 
-SpriteBatch::SpriteBatch(uint _maxSprites) {
-	
-	buffers.resize(3);
-
-	float* bp[3];
-	GLuint b[3];
-	glGenVertexArrays(3, b);
-
-	uint bufferSize = 4 * VERTEXSIZE * _maxSprites * sizeof(float);
-
-	for (uint i = 0; i < 3; ++i) {
-		glBindBuffer(GL_ARRAY_BUFFER, b[i]);
-		glBufferStorage(GL_SHADER_STORAGE_BUFFER, bufferSize, nullptr, GL_MAP_PERSISTENT_BIT | GL_MAP_WRITE_BIT | GL_CLIENT_STORAGE_BIT);
-		bp[i] = reinterpret_cast<float*>(glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, bufferSize,
-			GL_MAP_READ_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_PERSISTENT_BIT));
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-	}
+SpriteBatch::SpriteBatch(uint _maxSprites) : maxSpritesInBatch(_maxSprites) {
 
-	for (uint i = 0; i < 3; ++i)
-		buffers[i] = std::make_tuple(b[i], bp[i]);
+	//the vertices live in the shared vertex stream, see build
+	glGenVertexArrays(1, &vao);
 
 	shader = new ShaderProgram("/shader/spritebatch/sb_sprite");
 
 }
 
-Heerbann::SpriteBatch::~SpriteBatch() {}
+Heerbann::SpriteBatch::~SpriteBatch() {
+	glDeleteVertexArrays(1, &vao);
+}
 
-void SpriteBatch::addSprite(const sf::FloatRect& _bounds, const sf::IntRect& _uv, uint _index, const Vec2u& _texBounds, const sf::Color& _tint, const Vec4& _scissors) {
+void SpriteBatch::addSprite(const sf::FloatRect& _bounds, const Vec4& _uv, uint _index, const sf::Color& _tint, const Vec4& _scissors) {
 	if (spriteCount >= maxSpritesInBatch) return;
 
 	float color = M_FloatBits(_tint);
 
-	float fracW = 1.f / _texBounds.x;
-	float fracH = 1.f / _texBounds.y;
-
 	uint count = spriteCount.fetch_add(1);
-	int index = (currentIndex + 1) % 3;
-	float* data = std::get<1>(buffers[index]) + count * 4 * VERTEXSIZE;
+	float* data = range.as<float>() + count * 4 * VERTEXSIZE;
 
 	//bottom left
 	uint k = 0;
 	data[k++] = _bounds.left; //x
 	data[k++] = _bounds.top; //y
 
-	data[k++] = static_cast<float>(_uv.left) * fracW; //u
-	data[k++] = static_cast<float>(_uv.top) * fracH; //v
+	data[k++] = _uv.x; //u
+	data[k++] = _uv.y; //v
 	data[k++] = static_cast<float>(_index); //i
 
 	data[k++] = color; //col
@@ -67,8 +49,8 @@ void SpriteBatch::addSprite(const sf::FloatRect& _bounds, const sf::IntRect& _uv
 	data[k++] = _bounds.left + _bounds.width; //x
 	data[k++] = _bounds.top; //y
 
-	data[k++] = static_cast<float>(_uv.left + _uv.width) * fracW; //u
-	data[k++] = static_cast<float>(_uv.top) * fracH; //v
+	data[k++] = _uv.z; //u
+	data[k++] = _uv.y; //v
 	data[k++] = static_cast<float>(_index); //i
 
 	data[k++] = color; //col
@@ -82,8 +64,8 @@ void SpriteBatch::addSprite(const sf::FloatRect& _bounds, const sf::IntRect& _uv
 	data[k++] = _bounds.left; //x
 	data[k++] = _bounds.top + _bounds.height; //y
 
-	data[k++] = static_cast<float>(_uv.left) * fracW; //u
-	data[k++] = static_cast<float>(_uv.top + _uv.height) * fracH; //v
+	data[k++] = _uv.x; //u
+	data[k++] = _uv.w; //v
 	data[k++] = static_cast<float>(_index); //i
 
 	data[k++] = color; //col
@@ -97,8 +79,8 @@ void SpriteBatch::addSprite(const sf::FloatRect& _bounds, const sf::IntRect& _uv
 	data[k++] = _bounds.left + _bounds.width; //x
 	data[k++] = _bounds.top + _bounds.height; //y
 
-	data[k++] = static_cast<float>(_uv.left + _uv.width) * fracW; //u
-	data[k++] = static_cast<float>(_uv.top + _uv.height) * fracH; //v
+	data[k++] = _uv.z; //u
+	data[k++] = _uv.w; //v
 	data[k++] = static_cast<float>(_index); //i
 
 	data[k++] = color; //col
@@ -110,6 +92,9 @@ void SpriteBatch::addSprite(const sf::FloatRect& _bounds, const sf::IntRect& _uv
 }
 
 void SpriteBatch::build() {
+	StreamBuffer* stream = M_Stream(StreamUsage::vertex);
+	//reserve the worst case, the unused end goes back to the stream below
+	range = stream->allocate(4 * VERTEXSIZE * maxSpritesInBatch * sizeof(float), sizeof(float));
 	spriteCount = 0;
 	locked = true;
 	while(!drawJobs.empty()) {
@@ -120,14 +105,25 @@ void SpriteBatch::build() {
 			{
 				sf::Sprite* sprite = reinterpret_cast<sf::Sprite*>(job->data);
 				auto tex = sprite->getTexture();
-				addSprite(sprite->getGlobalBounds(), sprite->getTextureRect(), job->texIndex,
-					Vec2u(tex->getSize().x, tex->getSize().y), job->color, job->scissors);
+				sf::IntRect uv = sprite->getTextureRect();
+				float fracW = 1.f / tex->getSize().x;
+				float fracH = 1.f / tex->getSize().y;
+				addSprite(sprite->getGlobalBounds(), Vec4(uv.left * fracW, uv.top * fracH, (uv.left + uv.width) * fracW, (uv.top + uv.height) * fracH),
+					job->texIndex, job->color, job->scissors);
+			}
+			break;
+			case Type::region:
+			{
+				RegionDraw* r = reinterpret_cast<RegionDraw*>(job->data);
+				//not packed yet
+				if (r->region->texture == 0) break;
+				addSprite(r->bounds, Vec4(r->region->u.x, r->region->v.x, r->region->u.y, r->region->v.y),
+					getIndex(r->region->texture), job->color, job->scissors);
 			}
 			break;
 			case Type::font:
 			{
-				int index = (currentIndex + 1) % 3;
-				float* data = std::get<1>(buffers[index]) + spriteCount * 4 * VERTEXSIZE;
+				float* data = range.as<float>() + spriteCount * 4 * VERTEXSIZE;
 				Text::TextBlock* text = reinterpret_cast<Text::TextBlock*>(job->data);
 				int count = 0;
 				text->draw(count, data, job->scissors);
@@ -136,6 +132,8 @@ void SpriteBatch::build() {
 			break;
 		}
 	}
+	stream->shrink(range, spriteCount * 4 * VERTEXSIZE * sizeof(float));
+	locked = false;
 }
 
 void SpriteBatch::drawToScreen() {
@@ -144,35 +142,38 @@ void SpriteBatch::drawToScreen() {
 
 	shader->bind();
 
-	//bind textures
+	//bind textures, one unit per sampler of tex[]
+	for (uint i = 0; i < textures.size(); ++i) {
+		glActiveTexture(GL_TEXTURE0 + i);
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+	}
 	glActiveTexture(GL_TEXTURE0);
-	for(uint i = 0; i < textures.size(); ++i)
-		glBindTexture(GL_TEXTURE + i, textures[i]);
 
-	//bind current vbo
-	glBindBuffer(GL_ARRAY_BUFFER, std::get<0>(buffers[currentIndex]));
+	//the range of the last build
+	glBindVertexArray(vao);
+	M_Stream(StreamUsage::vertex)->bind();
+	const char* base = reinterpret_cast<const char*>(range.offset);
 
 	glEnableVertexAttribArray(0); //a_Pos
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, VERTEXSIZE * sizeof(float), (void*)0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, VERTEXSIZE * sizeof(float), base);
 
 	glEnableVertexAttribArray(1); //a_uv
-	glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, VERTEXSIZE * sizeof(float), (void*)(2 * sizeof(float)));
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, VERTEXSIZE * sizeof(float), base + 2 * sizeof(float));
 
 	glEnableVertexAttribArray(2); //a_Col
-	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, VERTEXSIZE * sizeof(float), (void*)(5 * sizeof(float)));
+	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, VERTEXSIZE * sizeof(float), base + 5 * sizeof(float));
 
 	glEnableVertexAttribArray(3); //a_sci
-	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, VERTEXSIZE * sizeof(float), (void*)(6 * sizeof(float)));
+	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, VERTEXSIZE * sizeof(float), base + 6 * sizeof(float));
 
 	//draw
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, spriteCount * 4);
 
+	glBindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindTexture(GL_TEXTURE, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
 
 	shader->unbind();
-
-	currentIndex++;
 }
 
 void SpriteBatch::draw(Item* _item) {
@@ -180,7 +181,7 @@ void SpriteBatch::draw(Item* _item) {
 }
 
 void SpriteBatch::draw(sf::Sprite* _sprite) {
-	draw(_sprite, textureMap[_sprite->getTexture()->getNativeHandle()], sf::Color::White, Vec4(0.f, 0.f, M_WIDTH, M_HEIGHT));
+	draw(_sprite, getIndex(_sprite->getTexture()->getNativeHandle()), sf::Color::White, Vec4(0.f, 0.f, M_WIDTH, M_HEIGHT));
 }
 
 void SpriteBatch::draw(void* _renderable, GLuint _texIndex, sf::Color _color, const Vec4& _scissors) {
@@ -189,15 +190,15 @@ void SpriteBatch::draw(void* _renderable, GLuint _texIndex, sf::Color _color, co
 }
 
 void SpriteBatch::draw(sf::Sprite* _sprite, const Vec4& _scissors) {
-	draw(_sprite, textureMap[_sprite->getTexture()->getNativeHandle()], sf::Color::White, _scissors);
+	draw(_sprite, getIndex(_sprite->getTexture()->getNativeHandle()), sf::Color::White, _scissors);
 }
 
 void SpriteBatch::draw(sf::Sprite* _sprite, sf::Color _color) {
-	draw(_sprite, textureMap[_sprite->getTexture()->getNativeHandle()], _color, Vec4(0.f, 0.f, M_WIDTH, M_HEIGHT));
+	draw(_sprite, getIndex(_sprite->getTexture()->getNativeHandle()), _color, Vec4(0.f, 0.f, M_WIDTH, M_HEIGHT));
 }
 
 void SpriteBatch::draw(sf::Sprite* _sprite, sf::Color _color, const Vec4& _scissors) {
-	draw(_sprite, textureMap[_sprite->getTexture()->getNativeHandle()], _color, _scissors);
+	draw(_sprite, getIndex(_sprite->getTexture()->getNativeHandle()), _color, _scissors);
 }
 
 void SpriteBatch::draw(Text::TextBlock* _text) {
@@ -209,16 +210,24 @@ void Heerbann::SpriteBatch::draw(Text::TextBlock* _text, Vec4 _scissors) {
 	draw(new Item{ Type::font, 0, sf::Color::White, _scissors, _text });
 }
 
+void SpriteBatch::draw(AtlasRegion* _region, const sf::FloatRect& _bounds) {
+	draw(_region, _bounds, sf::Color::White, Vec4(0.f, 0.f, M_WIDTH, M_HEIGHT));
+}
+
+void SpriteBatch::draw(AtlasRegion* _region, const sf::FloatRect& _bounds, sf::Color _color, const Vec4& _scissors) {
+	assert(!locked);
+	//the sampler is resolved in build, the region might not be packed yet
+	draw(new Item{ Type::region, 0, _color, _scissors, M_Arena->create<RegionDraw>(RegionDraw{ _region, _bounds }) });
+}
+
 uint SpriteBatch::addTexture(GLuint _tex) {
+	auto it = textureMap.find(_tex);
+	if (it != textureMap.end()) return it->second;
+	//sampler2D tex[32] in sb_sprite.frag
+	assert(textures.size() < 32 && "too many textures in one batch, pack them into a DynamicAtlas");
+	uint index = static_cast<uint>(textures.size());
 	textures.emplace_back(_tex);
-	uint index = 0;
-	for (uint i = 0; i < textures.size(); ++i) {
-		if (textures[i] == _tex) {
-			index = i;
-			break;
-		}
-	}
-	textureMap[index] = _tex;
+	textureMap[_tex] = index;
 	return index;
 }
 
@@ -1,13 +1,20 @@
 #pragma once
 
 #include "MainStruct.hpp"
+#include "StreamBuffer.hpp"
 
 namespace Heerbann {
 
 	class SpriteBatch {
 
 		enum Type {
-			sprite, font
+			sprite, font, region
+		};
+
+		//payload of a region item, lives in the FrameArena
+		struct RegionDraw {
+			AtlasRegion* region;
+			sf::FloatRect bounds;
 		};
 
 		struct Item {
@@ -18,17 +25,21 @@ namespace Heerbann {
 			void* data;
 		};
 
-		std::vector<std::tuple<GLuint, float*>> buffers;
-		uint currentIndex = 0;
+		GLuint vao = 0;
+		//vertices of the last build, in the vertex stream
+		StreamRange range;
 		std::atomic<uint> spriteCount = 0;
 		uint maxSpritesInBatch = 0;
 
+		//one sampler per texture, regions of a DynamicAtlas page share one
 		std::vector<GLuint> textures;
-		std::unordered_map<uint, GLuint> textureMap;
+		//gl handle -> sampler index
+		std::unordered_map<GLuint, uint> textureMap;
 
 		ShaderProgram* shader;
 
-		void addSprite(const sf::FloatRect&, const sf::IntRect&, uint, const Vec2u&, const sf::Color&, const Vec4&);
+		//bounds, normalized uv rect (u0, v0, u1, v1), sampler index, tint, scissors
+		void addSprite(const sf::FloatRect&, const Vec4&, uint, const sf::Color&, const Vec4&);
 
 		std::queue<Item*> drawJobs;
 		void draw(Item*);
@@ -42,7 +53,7 @@ namespace Heerbann {
 
 		const static uint VERTEXSIZE = 2 + 3 + 1 + 4; //pos, uv, col, scissor
 
-		//builds the buffer asynchronous
+		//writes the queued draws into the vertex stream, main thread
 		void build();
 
 		//draws the batch 
@@ -57,6 +68,10 @@ namespace Heerbann {
 		void draw(Text::TextBlock*);
 		void draw(Text::TextBlock*, Vec4);
 
+		//regions of any DynamicAtlas, skipped while the region isn't packed yet
+		void draw(AtlasRegion*, const sf::FloatRect&);
+		void draw(AtlasRegion*, const sf::FloatRect&, sf::Color, const Vec4&);
+
 		uint addTexture(GLuint);
 		uint getIndex(GLuint);
 		bool textureExists(GLuint);
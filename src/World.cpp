@@ -6,6 +6,7 @@
 #include "CameraUtils.hpp"
 #include "Math.hpp"
 #include "Renderer.hpp"
+#include "Entity.hpp"
 
 using namespace Heerbann;
 
@@ -17,6 +18,53 @@ void World::build(const WorldBuilderDefinition& _def) {
 
 }
 
+Entity World::create() {
+	return entities.create();
+}
+
+Entity World::create(const std::string& _name) {
+	if (names.count(_name) != 0) throw new std::exception((std::string("entity [") + _name + std::string("] exists already")).data());
+	Entity out = entities.create();
+	entities.add<Named>(out, Named{ _name });
+	names[_name] = out;
+	return out;
+}
+
+void World::destroy(Entity _entity) {
+	if (Named* n = entities.get<Named>(_entity))
+		names.erase(n->name);
+	entities.destroy(_entity);
+}
+
+Entity World::find(const std::string& _name) {
+	auto it = names.find(_name);
+	if (it == names.end()) return Entity();
+	return it->second;
+}
+
+EntityStore* World::getEntities() {
+	return &entities;
+}
+
+void World::update() {
+	entities.each<Transform>([](Entity, Transform& _t) {
+		_t.world = glm::translate(Mat4(1.f), _t.position) * glm::toMat4(_t.rotation) * glm::scale(Mat4(1.f), _t.scale);
+	});
+}
+
+void World::draw(View* _view) {
+	uint count = 0;
+	for (Archetype* a : entities.query(componentMask<RenderComponent>()))
+		count += a->size();
+	Renderable** list = M_Arena->alloc<Renderable*>(count);
+	uint i = 0;
+	entities.each<RenderComponent>([&](Entity, RenderComponent& _r) {
+		list[i++] = &_r.renderable;
+	});
+	renderer->add(list, count);
+	renderer->draw(_view);
+}
+
 
 
 
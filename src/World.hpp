@@ -1,22 +1,32 @@
 #pragma once
 
 #include "MainStruct.hpp"
+#include "Entity.hpp"
+#include "Renderer.hpp"
 
 namespace Heerbann {
 
 	using namespace Heerbann;
 
-	
-	struct WorldObject {
-		const std::string id;
-		void* object;
+	//---------------------- Components ----------------------\\
 
-		template<class T>
-		T get() {
-			return reinterpret_cast<T>(object);
-		};
+	struct Transform {
+		Vec3 position = Vec3(0.f);
+		Quat rotation = Quat(1.f, 0.f, 0.f, 0.f);
+		Vec3 scale = Vec3(1.f);
+		//rebuilt by World::update
+		Mat4 world = Mat4(1.f);
+	};
+
+	//set by World::create(name)
+	struct Named {
+		std::string name;
 	};
 
+	//submitted to the world renderer every frame
+	struct RenderComponent {
+		VSMRenderable renderable;
+	};
 
 
 	struct WorldBuilderDefinition {
@@ -26,7 +36,9 @@ namespace Heerbann {
 
 	class World {
 
-		std::unordered_map<std::string, WorldObject*> objects;
+		EntityStore entities;
+		//only for entities created with a name, lookups by name are for tools & scripting
+		std::unordered_map<std::string, Entity> names;
 
 		VSMRenderer* renderer;
 
@@ -34,10 +46,24 @@ namespace Heerbann {
 		World();
 		void build(const WorldBuilderDefinition&);
 
+		Entity create();
+		Entity create(const std::string&);
+		void destroy(Entity);
+		//invalid entity if the name is unknown
+		Entity find(const std::string&);
+
+		EntityStore* getEntities();
+
+		//rebuilds the world matrices
+		void update();
+		//submits every RenderComponent to the renderer
+		void draw(View*);
+
 		template<class T>
-		WorldObject* get(std::string _id) {
-			if (objects.count(_id) == 0) return nullptr;
-			return reinterpret_cast<T>(objects[_id]->object);
+		T* get(const std::string& _id) {
+			auto it = names.find(_id);
+			if (it == names.end()) return nullptr;
+			return entities.get<T>(it->second);
 		};
 	};
 
@@ -10,12 +10,108 @@
 #include "Utils.hpp"
 #include "TimeLog.hpp"
 #include "Gdx.hpp"
+#include "FileSystem.hpp"
+#include "TextureCompression.hpp"
+#include "Atlas.hpp"
+
+#include <filesystem>
 
 using namespace Heerbann;
 
 App::Main* App::Main::instance = new App::Main();
 
-int main() {
+//ticks the engine without presenting anything, 0 frames = until the process is killed
+int runHeadless(unsigned long long _frames) {
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned long long i = 0; _frames == 0 || i < _frames; ++i) {
+		M_Pacer->begin();
+		try {
+			M_Main->update();
+			while (M_Pacer->step())
+				M_Level->update();
+		} catch (std::exception* ex) {
+			std::cerr << "Error occurred: " << ex->what() << std::endl;
+			delete ex;
+		} catch (const std::runtime_error& re) {
+			std::cerr << "Runtime error: " << re.what() << std::endl;
+		} catch (const std::exception& ex) {
+			std::cerr << "Error occurred: " << ex.what() << std::endl;
+		} catch (...) {
+			std::cerr << "Unknown failure occurred. Possible memory corruption" << std::endl;
+		}
+		M_Pacer->end();
+	}
+	M_Asset->finish();
+	float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "headless: " << M_Pacer->ticks() << " ticks in " << seconds << "s (" << (M_Pacer->ticks() / seconds) << " ticks/s)" << std::endl;
+	delete M_Main;
+	return 0;
+}
+
+//packs every file below _dir into _out, ids stay relative to the working directory
+int pack(const std::string& _out, const std::string& _dir) {
+	std::vector<std::string> files;
+	for (auto& e : std::filesystem::recursive_directory_iterator(_dir))
+		if (e.is_regular_file())
+			files.emplace_back(e.path().generic_string());
+	std::sort(files.begin(), files.end());
+	if (!PackArchive::write(_out, files)) {
+		std::cerr << "packing [" << _dir << "] failed" << std::endl;
+		return 1;
+	}
+	std::cout << "packed " << files.size() << " files into [" << _out << "]" << std::endl;
+	return 0;
+}
+
+//block compresses every png below _dir next to its source as .rtex, the format follows the map suffix.
+//text .atlas files are converted to the binary .ratlas. this runs before Main is set up, there is no
+//AssetManager to mount archives with, so the cookers read loose files through MappedFile
+int cook(const std::string& _dir) {
+	uint count = 0;
+	uint atlases = 0;
+	for (auto& e : std::filesystem::recursive_directory_iterator(_dir)) {
+		if (!e.is_regular_file()) continue;
+		if (e.path().extension() == ".atlas") {
+			std::string source = e.path().generic_string();
+			std::string out = e.path().parent_path().generic_string() + "/" + e.path().stem().generic_string() + ".ratlas";
+			try {
+				if (!CookedAtlas::cook(source, out)) {
+					std::cerr << "writing [" << out << "] failed" << std::endl;
+					return 1;
+				}
+			} catch (std::exception* ex) {
+				std::cerr << "cooking [" << source << "] failed: " << ex->what() << std::endl;
+				delete ex;
+				return 1;
+			}
+			std::cout << "cooked [" << out << "]" << std::endl;
+			++atlases;
+			continue;
+		}
+		if (e.path().extension() != ".png") continue;
+		std::string source = e.path().generic_string();
+		std::string out = e.path().parent_path().generic_string() + "/" + e.path().stem().generic_string() + ".rtex";
+		auto start = std::chrono::steady_clock::now();
+		if (!CookedTexture::cook(source, out, BlockCompressor::formatFor(source))) {
+			std::cerr << "cooking [" << source << "] failed" << std::endl;
+			return 1;
+		}
+		float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "cooked [" << out << "] in " << ms << "ms" << std::endl;
+		++count;
+	}
+	std::cout << "cooked " << count << " textures & " << atlases << " atlases" << std::endl;
+	return 0;
+}
+
+//--headless runs without a window, --offscreen headless but with a hidden gl context, --frames N stops after N frames
+//--pack out.pak dir builds an archive and exits, --cook dir compresses the textures & converts the atlases below dir and exits
+int main(int argc, char** argv) {
+
+	if (argc >= 4 && std::string(argv[1]) == "--pack")
+		return pack(argv[2], argv[3]);
+	if (argc >= 3 && std::string(argv[1]) == "--cook")
+		return cook(argv[2]);
 	
 	MainConfig* config = new MainConfig();
 	config->name = "Rehmetzel a0.3";
@@ -26,8 +122,23 @@ int main() {
 	config->settings.stencilBits = 8;
 	config->settings.depthBits = 24;
 
+	unsigned long long frames = 0;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg(argv[i]);
+		if (arg == "--headless")
+			config->headless = true;
+		else if (arg == "--offscreen")
+			config->headless = config->offscreenContext = true;
+		else if (arg == "--frames" && i + 1 < argc)
+			frames = std::stoull(argv[++i]);
+	}
+	//intialize deletes the config
+	bool headless = config->headless;
+
 	M_Main->intialize(config);
 
+	if (headless) return runHeadless(frames);
+
 	bool close = false;
 	InputEntry* entry = new InputEntry();
 	entry->closeEvent = [&]()->bool {
@@ -45,7 +156,7 @@ int main() {
 
 	sf::Event event;
 	while (M_Context->isOpen()) {
-		auto start = TIMESTAMP;
+		M_Pacer->begin();
 		if (close) {
 			M_Context->close();
 			delete M_Main;
@@ -57,17 +168,20 @@ int main() {
 			while (M_Context->pollEvent(event))
 				M_Input->fire(event);
 
-			const float delta = 1.f / 60.f;
-
 			//update & apply
 			M_Env->update();
 
-			M_Level->update();
+			//the simulation runs in fixed steps, rendering interpolates with FrameAlpha
+			while (M_Pacer->step())
+				M_Level->update();
 			M_Level->draw();
 
 			//M_Stage->act();
 			//M_Stage->draw(M_Batch);
 	
+		} catch (std::exception* ex) {
+			std::cerr << "Error occurred: " << ex->what() << std::endl;
+			delete ex;
 		} catch (const std::runtime_error& re) {
 			std::cerr << "Runtime error: " << re.what() << std::endl;
 		} catch (const std::exception& ex) {
@@ -75,13 +189,8 @@ int main() {
 		} catch (...) {
 			std::cerr << "Unknown failure occurred. Possible memory corruption" << std::endl;
 		}
-		unsigned long long elapsedTime = std::chrono::duration_cast<std::chrono::microseconds>(TIMESTAMP.time - start.time).count();
-		const uint NsToMs = 1000000;
-		unsigned long long wait = (14 - elapsedTime) * NsToMs;
-		auto sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
-		glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, wait);
-		glDeleteSync(sync);
-		M_Context->display();	
+		M_Context->display();
+		M_Pacer->end();
 	}
 	return 0;
 }
\ No newline at end of file